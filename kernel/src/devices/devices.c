@@ -110,6 +110,12 @@ Error initDevices() {
     CHECKED(registerNullDevice());
     CHECKED(registerZeroDevice());
     CHECKED(registerRandomDevice());
+    CHECKED(registerMemstatDevice());
+    CHECKED(registerLockstatDevice());
+    CHECKED(registerSchedtraceDevice());
+    CHECKED(registerInterruptsDevice());
+    CHECKED(registerProfileDevice());
+    CHECKED(registerKsymsDevice());
     return initDriversForDeviceTreeNodes();
 }
 
@@ -41,14 +41,18 @@ struct CharDevice_s;
 
 typedef Error (*CharDeviceReadFunction)(struct CharDevice_s* dev, VirtPtr buff, size_t size, size_t* read, bool block);
 typedef Error (*CharDeviceWriteFunction)(struct CharDevice_s* dev, VirtPtr buff, size_t size, size_t* written);
+typedef Error (*CharDeviceReadAtFunction)(struct CharDevice_s* dev, VirtPtr buff, size_t offset, size_t size, size_t* read);
 typedef Error (*CharDeviceIoctlFunction)(struct CharDevice_s* dev, size_t request, VirtPtr argp, uintptr_t* res);
 typedef bool (*CharDeviceWillBlockFunction)(struct CharDevice_s* dev, bool write);
+typedef struct PollQueue_s* (*CharDevicePollQueueFunction)(struct CharDevice_s* dev);
 
 typedef struct {
     CharDeviceReadFunction read;
     CharDeviceWriteFunction write;
     CharDeviceIoctlFunction ioctl;
     CharDeviceWillBlockFunction is_ready;
+    CharDeviceReadAtFunction read_at; // Optional, used instead of read if the device is seekable
+    CharDevicePollQueueFunction poll_queue; // Optional, notified when is_ready might change
 } CharDeviceFunctions;
 
 typedef struct CharDevice_s {
@@ -7,6 +7,7 @@
 #include "devices/serial/tty.h"
 
 #include "memory/kalloc.h"
+#include "task/schedtrace.h"
 #include "task/schedule.h"
 #include "task/syscall.h"
 #include "util/random.h"
@@ -48,6 +49,7 @@ static bool canReturnRead(UartTtyDevice* dev) {
 
 static bool wakeupIfRequired(UartTtyDevice* dev) {
     if (canReturnRead(dev)) {
+        notifyPollQueue(&dev->poll);
         while (dev->blocked != NULL) {
             Task* wakeup = dev->blocked;
             dev->blocked = wakeup->sched.locks_next;
@@ -95,6 +97,8 @@ static void waitForReadOperation(void* _, Task* task, UartTtyDevice* dev) {
     task->sched.wakeup_udata = dev;
     task->sched.wakeup_function = task->sys_task->process != NULL ? handleTtyWakeup : NULL;
     moveTaskToState(task, WAITING);
+    traceSchedEvent(SCHED_TRACE_BLOCK, task, SCHED_TRACE_BLOCK_IO);
+    task->usage.voluntary_switches++;
     enqueueTask(task);
     task->sched.locks_next = dev->blocked;
     dev->blocked = task;
@@ -355,11 +359,16 @@ static bool uartTtyIsReadyFunction(UartTtyDevice* dev, bool write) {
     return write || (canReturnRead(dev) && dev->buffer_count > 0);
 }
 
+static PollQueue* uartTtyPollQueueFunction(UartTtyDevice* dev) {
+    return &dev->poll;
+}
+
 static const CharDeviceFunctions funcs = {
     .read = (CharDeviceReadFunction)uartTtyReadFunction,
     .write = (CharDeviceWriteFunction)uartTtyWriteFunction,
     .ioctl = (CharDeviceIoctlFunction)uartTtyIoctlFunction,
     .is_ready = (CharDeviceWillBlockFunction)uartTtyIsReadyFunction,
+    .poll_queue = (CharDevicePollQueueFunction)uartTtyPollQueueFunction,
 };
 
 UartTtyDevice* createUartTtyDevice(void* uart, UartWriteFunction write, UartReadFunction read) {
@@ -376,6 +385,7 @@ UartTtyDevice* createUartTtyDevice(void* uart, UartWriteFunction write, UartRead
     dev->buffer = NULL;
     dev->blocked = NULL;
     initSpinLock(&dev->lock);
+    initPollQueue(&dev->poll);
     memset(&dev->ctrl, 0, sizeof(Termios));
     dev->ctrl.iflag = ICRNL;
     dev->ctrl.oflag = ONLCR | OPOST;
@@ -398,7 +408,7 @@ UartTtyDevice* createUartTtyDevice(void* uart, UartWriteFunction write, UartRead
 void uartTtyDataReady(UartTtyDevice* dev) {
     Error error;
     lockSpinLock(&dev->lock);
-    addRandomEvent(NULL, 0);
+    addRandomSample((uintptr_t)dev);
     do {
         error = basicTtyRead(dev);
     } while (!isError(error));
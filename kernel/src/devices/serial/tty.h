@@ -9,6 +9,7 @@
 #include "error/error.h"
 #include "interrupt/plic.h"
 #include "process/types.h"
+#include "task/pollqueue.h"
 #include "task/spinlock.h"
 #include "task/task.h"
 
@@ -30,6 +31,7 @@ typedef struct {
     Pid process_group;
     SpinLock lock;
     Task* blocked;
+    PollQueue poll;
 } UartTtyDevice;
 
 UartTtyDevice* createUartTtyDevice(void* uart, UartWriteFunction write, UartReadFunction read);
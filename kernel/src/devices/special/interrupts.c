@@ -0,0 +1,116 @@
+
+#include "devices/devices.h"
+#include "interrupt/plic.h"
+#include "memory/kalloc.h"
+#include "task/harts.h"
+#include "util/text.h"
+#include "util/util.h"
+
+#include "devices/special/snapshot.h"
+#include "devices/special/special.h"
+
+// Reading this device gives the number of times each external interrupt was handled by each hart,
+// and the harts it is delivered to. Writing "<id> <mask>" with a decimal interrupt id and a
+// hexadecimal hart mask changes the affinity of the interrupt.
+
+#define MAX_REPORTED_INTERRUPTS 64
+#define MAX_COMMAND_LENGTH 64
+
+static void formatInterruptStats(TextBuffer* buffer, InterruptStats* stats, size_t count) {
+    appendText(buffer, "%4s %18s", "irq", "affinity");
+    for (int i = 0; i < hart_count; i++) {
+        FORMAT_STRINGX(name, "hart%i", hart_ids[i]);
+        appendText(buffer, " %10s", name);
+    }
+    appendText(buffer, "\n");
+    for (size_t i = 0; i < count; i++) {
+        appendText(buffer, "%4u %18p", stats[i].id, (void*)stats[i].affinity);
+        for (int j = 0; j < hart_count; j++) {
+            appendText(buffer, " %10lu", stats[i].counts[hart_ids[j]]);
+        }
+        appendText(buffer, "\n");
+    }
+    uint64_t spurious[MAX_HART_COUNT];
+    getSpuriousInterruptCounts(spurious);
+    appendText(buffer, "%4s %18s", "spur", "");
+    for (int j = 0; j < hart_count; j++) {
+        appendText(buffer, " %10lu", spurious[hart_ids[j]]);
+    }
+    appendText(buffer, "\n");
+}
+
+static TextSnapshot snapshot;
+
+static Error generateInterruptsText(TextBuffer* text) {
+    InterruptStats* stats = kalloc(MAX_REPORTED_INTERRUPTS * sizeof(InterruptStats));
+    if (stats == NULL) {
+        return simpleError(ENOMEM);
+    }
+    size_t count = getInterruptStats(stats, MAX_REPORTED_INTERRUPTS);
+    formatInterruptStats(text, stats, count);
+    dealloc(stats);
+    return simpleError(SUCCESS);
+}
+
+static Error interruptsReadAtFunction(CharDevice* dev, VirtPtr buffer, size_t offset, size_t size, size_t* read) {
+    return readTextSnapshot(&snapshot, generateInterruptsText, buffer, offset, size, read);
+}
+
+static Error interruptsReadFunction(CharDevice* dev, VirtPtr buffer, size_t size, size_t* read, bool block) {
+    return interruptsReadAtFunction(dev, buffer, 0, size, read);
+}
+
+static int hexDigitValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    } else {
+        return -1;
+    }
+}
+
+static Error interruptsWriteFunction(CharDevice* dev, VirtPtr buffer, size_t size, size_t* written) {
+    char command[MAX_COMMAND_LENGTH + 1];
+    size_t length = umin(size, MAX_COMMAND_LENGTH);
+    memcpyBetweenVirtPtr(virtPtrForKernel(command), buffer, length);
+    command[length] = 0;
+    const char* str = command;
+    ExternalInterrupt id = 0;
+    while (*str >= '0' && *str <= '9') {
+        id = id * 10 + (*str - '0');
+        str++;
+    }
+    while (*str == ' ') {
+        str++;
+    }
+    if (str[0] == '0' && str[1] == 'x') {
+        str += 2;
+    }
+    HartMask mask = 0;
+    while (hexDigitValue(*str) >= 0) {
+        mask = (mask << 4) | hexDigitValue(*str);
+        str++;
+    }
+    CHECKED(setInterruptAffinity(id, mask));
+    *written = size;
+    return simpleError(SUCCESS);
+}
+
+static const CharDeviceFunctions funcs = {
+    .read = interruptsReadFunction,
+    .write = interruptsWriteFunction,
+    .read_at = interruptsReadAtFunction,
+};
+
+Error registerInterruptsDevice() {
+    initTextSnapshot(&snapshot);
+    CharDevice* dev = kalloc(sizeof(CharDevice));
+    dev->base.type = DEVICE_CHAR;
+    dev->base.name = "interrupts";
+    dev->functions = &funcs;
+    registerDevice((Device*)dev);
+    return simpleError(SUCCESS);
+}
@@ -0,0 +1,50 @@
+#include "devices/devices.h"
+#include "error/debuginfo.h"
+#include "memory/kalloc.h"
+#include "util/text.h"
+#include "util/util.h"
+
+#include "devices/special/special.h"
+
+// Reading this device gives the address and name of every kernel symbol, one per line and sorted
+// by address. It is empty if the kernel was built without debug info.
+
+static Error ksymsReadAtFunction(CharDevice* dev, VirtPtr buffer, size_t offset, size_t size, size_t* read) {
+    size_t count;
+    const SymbolDebugInfo* symbols = getSymbolDebugInfos(&count);
+    TextBuffer text = { .text = NULL, .length = 0, .capacity = 0 };
+    for (size_t i = 0; i < count; i++) {
+        appendText(&text, "%016lx %s\n", symbols[i].addr, symbols[i].symbol);
+    }
+    if (offset < text.length) {
+        *read = umin(size, text.length - offset);
+        memcpyBetweenVirtPtr(buffer, virtPtrForKernel(text.text + offset), *read);
+    } else {
+        *read = 0;
+    }
+    dealloc(text.text);
+    return simpleError(SUCCESS);
+}
+
+static Error ksymsReadFunction(CharDevice* dev, VirtPtr buffer, size_t size, size_t* read, bool block) {
+    return ksymsReadAtFunction(dev, buffer, 0, size, read);
+}
+
+static Error ksymsWriteFunction(CharDevice* dev, VirtPtr buffer, size_t size, size_t* written) {
+    return simpleError(EPERM);
+}
+
+static const CharDeviceFunctions funcs = {
+    .read = ksymsReadFunction,
+    .write = ksymsWriteFunction,
+    .read_at = ksymsReadAtFunction,
+};
+
+Error registerKsymsDevice() {
+    CharDevice* dev = kalloc(sizeof(CharDevice));
+    dev->base.type = DEVICE_CHAR;
+    dev->base.name = "ksyms";
+    dev->functions = &funcs;
+    registerDevice((Device*)dev);
+    return simpleError(SUCCESS);
+}
@@ -0,0 +1,77 @@
+
+#include "devices/devices.h"
+#include "memory/kalloc.h"
+#include "task/lockstat.h"
+#include "util/text.h"
+#include "util/util.h"
+
+#include "devices/special/snapshot.h"
+#include "devices/special/special.h"
+
+// Reading this device gives a report of the lock statistics, sorted by total wait time. Writing
+// anything to it resets the statistics. Without LOCK_STATS, the report is always empty.
+
+static void formatLockStats(TextBuffer* buffer, LockStats* stats) {
+#ifndef LOCK_STATS
+    appendText(buffer, "lock statistics are disabled, build with LOCK_STATS\n");
+#endif
+    appendText(
+        buffer, "%-4s %18s %18s %10s %10s %10s %14s %12s %12s\n",
+        "kind", "lock", "callsite", "acquired", "contended", "spun", "wait total", "wait max", "hold max"
+    );
+    for (size_t i = 0; i < stats->count; i++) {
+        LockStatEntry* entry = &stats->entries[i];
+        appendText(
+            buffer, "%-4s %18p %18p %10lu %10lu %10lu %14lu %12lu %12lu\n",
+            entry->kind == LOCK_STAT_SPIN ? "spin" : "task", (void*)entry->lock, (void*)entry->caller,
+            entry->acquired, entry->contended, entry->spun, entry->wait_total, entry->wait_max,
+            entry->hold_max
+        );
+    }
+    if (stats->dropped != 0) {
+        appendText(buffer, "dropped %lu acquisitions\n", stats->dropped);
+    }
+}
+
+static TextSnapshot snapshot;
+
+static Error generateLockstatText(TextBuffer* text) {
+    LockStats* stats = kalloc(sizeof(LockStats));
+    if (stats == NULL) {
+        return simpleError(ENOMEM);
+    }
+    getLockStats(stats);
+    formatLockStats(text, stats);
+    dealloc(stats);
+    return simpleError(SUCCESS);
+}
+
+static Error lockstatReadAtFunction(CharDevice* dev, VirtPtr buffer, size_t offset, size_t size, size_t* read) {
+    return readTextSnapshot(&snapshot, generateLockstatText, buffer, offset, size, read);
+}
+
+static Error lockstatReadFunction(CharDevice* dev, VirtPtr buffer, size_t size, size_t* read, bool block) {
+    return lockstatReadAtFunction(dev, buffer, 0, size, read);
+}
+
+static Error lockstatWriteFunction(CharDevice* dev, VirtPtr buffer, size_t size, size_t* written) {
+    resetLockStats();
+    *written = size;
+    return simpleError(SUCCESS);
+}
+
+static const CharDeviceFunctions funcs = {
+    .read = lockstatReadFunction,
+    .write = lockstatWriteFunction,
+    .read_at = lockstatReadAtFunction,
+};
+
+Error registerLockstatDevice() {
+    initTextSnapshot(&snapshot);
+    CharDevice* dev = kalloc(sizeof(CharDevice));
+    dev->base.type = DEVICE_CHAR;
+    dev->base.name = "lockstat";
+    dev->functions = &funcs;
+    registerDevice((Device*)dev);
+    return simpleError(SUCCESS);
+}
@@ -0,0 +1,137 @@
+
+#include <string.h>
+
+#include "devices/devices.h"
+#include "memory/kalloc.h"
+#include "memory/pagealloc.h"
+#include "util/text.h"
+#include "util/util.h"
+
+#include "devices/special/snapshot.h"
+#include "devices/special/special.h"
+
+// Reading this device gives a snapshot of the allocator statistics. Writing a decimal number to it
+// sets the kalloc sample interval, with zero disabling the sampled allocation tracer.
+
+static void formatKallocStats(TextBuffer* buffer, KallocStats* stats) {
+    appendText(buffer, "kalloc:\n");
+    appendText(
+        buffer, "  free %lu bytes in %lu blocks, largest %lu bytes, failed %lu\n",
+        stats->free.total, stats->free.count, stats->free.largest, stats->failed
+    );
+    appendText(buffer, "  %-10s %10s %10s %12s\n", "class", "allocs", "frees", "live bytes");
+    for (size_t i = 0; i < KALLOC_SIZE_CLASSES; i++) {
+        KallocClassStats* class = &stats->classes[i];
+        const char* prefix = i == KALLOC_SIZE_CLASSES - 1 ? ">" : "<=";
+        size_t size = i == KALLOC_SIZE_CLASSES - 1 ? (16UL << (i - 1)) : (16UL << i);
+        appendText(
+            buffer, "  %2s%-8lu %10lu %10lu %12lu\n",
+            prefix, size, class->allocs, class->frees, class->live_bytes
+        );
+    }
+    appendText(buffer, "  %-18s %10s %12s\n", "callsite", "allocs", "bytes");
+    for (size_t i = 0; i < KALLOC_CALLSITES; i++) {
+        KallocCallsiteStats* site = &stats->callsites[i];
+        if (site->caller != 0) {
+            appendText(buffer, "  %18p %10lu %12lu\n", (void*)site->caller, site->allocs, site->bytes);
+        }
+    }
+    if (stats->untracked_callsites != 0) {
+        appendText(buffer, "  %18s %10lu\n", "other", stats->untracked_callsites);
+    }
+    appendText(buffer, "  sample interval %lu, dropped %lu\n", stats->sample_interval, stats->dropped_samples);
+    for (size_t i = 0; i < KALLOC_TRACE_SLOTS; i++) {
+        KallocTraceEntry* trace = &stats->traces[i];
+        if (trace->ptr != NULL) {
+            appendText(buffer, "  live %18p %8lu bytes from %p\n", trace->ptr, trace->size, (void*)trace->caller);
+        }
+    }
+}
+
+static void formatPageAllocStats(TextBuffer* buffer, PageAllocStats* stats) {
+    appendText(buffer, "pages:\n");
+    appendText(
+        buffer, "  free %lu pages in %lu blocks, largest %lu pages, failed %lu\n",
+        stats->free.total / PAGE_SIZE, stats->free.count, stats->free.largest / PAGE_SIZE, stats->failed
+    );
+    appendText(buffer, "  reclaim runs %lu, reclaimed %lu\n", stats->reclaim_runs, stats->reclaimed);
+    appendText(buffer, "  %-10s %10s %10s %12s\n", "class", "allocs", "frees", "live pages");
+    for (size_t i = 0; i < PAGE_SIZE_CLASSES; i++) {
+        PageClassStats* class = &stats->classes[i];
+        const char* prefix = i == PAGE_SIZE_CLASSES - 1 ? ">=" : "<";
+        size_t size = i == PAGE_SIZE_CLASSES - 1 ? (1UL << i) : (2UL << i);
+        appendText(
+            buffer, "  %2s%-8lu %10lu %10lu %12lu\n",
+            prefix, size, class->allocs, class->frees, class->live_pages
+        );
+    }
+    appendText(buffer, "  %-18s %10s %12s\n", "callsite", "allocs", "pages");
+    for (size_t i = 0; i < PAGE_CALLSITES; i++) {
+        PageCallsiteStats* site = &stats->callsites[i];
+        if (site->caller != 0) {
+            appendText(buffer, "  %18p %10lu %12lu\n", (void*)site->caller, site->allocs, site->pages);
+        }
+    }
+    if (stats->untracked_callsites != 0) {
+        appendText(buffer, "  %18s %10lu\n", "other", stats->untracked_callsites);
+    }
+}
+
+static TextSnapshot snapshot;
+
+static Error generateMemstatText(TextBuffer* text) {
+    KallocStats* kalloc_stats = kalloc(sizeof(KallocStats));
+    PageAllocStats* page_stats = kalloc(sizeof(PageAllocStats));
+    if (kalloc_stats == NULL || page_stats == NULL) {
+        dealloc(kalloc_stats);
+        dealloc(page_stats);
+        return simpleError(ENOMEM);
+    }
+    getKallocStats(kalloc_stats);
+    getPageAllocStats(page_stats);
+    formatKallocStats(text, kalloc_stats);
+    formatPageAllocStats(text, page_stats);
+    dealloc(kalloc_stats);
+    dealloc(page_stats);
+    return simpleError(SUCCESS);
+}
+
+static Error memstatReadAtFunction(CharDevice* dev, VirtPtr buffer, size_t offset, size_t size, size_t* read) {
+    return readTextSnapshot(&snapshot, generateMemstatText, buffer, offset, size, read);
+}
+
+static Error memstatReadFunction(CharDevice* dev, VirtPtr buffer, size_t size, size_t* read, bool block) {
+    return memstatReadAtFunction(dev, buffer, 0, size, read);
+}
+
+static Error memstatWriteFunction(CharDevice* dev, VirtPtr buffer, size_t size, size_t* written) {
+    char text[32];
+    size_t length = umin(size, sizeof(text) - 1);
+    memcpyBetweenVirtPtr(virtPtrForKernel(text), buffer, length);
+    size_t interval = 0;
+    for (size_t i = 0; i < length && text[i] != '\n'; i++) {
+        if (text[i] < '0' || text[i] > '9') {
+            return simpleError(EINVAL);
+        }
+        interval = interval * 10 + text[i] - '0';
+    }
+    setKallocSampleInterval(interval);
+    *written = size;
+    return simpleError(SUCCESS);
+}
+
+static const CharDeviceFunctions funcs = {
+    .read = memstatReadFunction,
+    .write = memstatWriteFunction,
+    .read_at = memstatReadAtFunction,
+};
+
+Error registerMemstatDevice() {
+    initTextSnapshot(&snapshot);
+    CharDevice* dev = kalloc(sizeof(CharDevice));
+    dev->base.type = DEVICE_CHAR;
+    dev->base.name = "memstat";
+    dev->functions = &funcs;
+    registerDevice((Device*)dev);
+    return simpleError(SUCCESS);
+}
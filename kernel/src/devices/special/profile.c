@@ -0,0 +1,69 @@
+#include "devices/devices.h"
+#include "memory/kalloc.h"
+#include "task/profile.h"
+#include "util/util.h"
+
+#include "devices/special/special.h"
+
+// Reading this device drains the profiler buffers, giving whole ProfileSample records. Writing "1"
+// starts sampling the pc, "2" also records backtraces and "0" stops the profiler again.
+
+#define MAX_SAMPLES_PER_READ 256
+
+static Error profileReadFunction(CharDevice* dev, VirtPtr buffer, size_t size, size_t* read) {
+    size_t max = umin(size / sizeof(ProfileSample), MAX_SAMPLES_PER_READ);
+    if (max == 0) {
+        *read = 0;
+        return simpleError(SUCCESS);
+    }
+    ProfileSample* samples = kalloc(max * sizeof(ProfileSample));
+    if (samples == NULL) {
+        return simpleError(ENOMEM);
+    }
+    size_t count = drainProfileSamples(samples, max);
+    *read = count * sizeof(ProfileSample);
+    memcpyBetweenVirtPtr(buffer, virtPtrForKernel(samples), *read);
+    dealloc(samples);
+    return simpleError(SUCCESS);
+}
+
+static Error profileBlockingReadFunction(CharDevice* dev, VirtPtr buffer, size_t size, size_t* read, bool block) {
+    return profileReadFunction(dev, buffer, size, read);
+}
+
+static Error profileReadAtFunction(CharDevice* dev, VirtPtr buffer, size_t offset, size_t size, size_t* read) {
+    // This is a stream, the offset has no meaning
+    return profileReadFunction(dev, buffer, size, read);
+}
+
+static Error profileWriteFunction(CharDevice* dev, VirtPtr buffer, size_t size, size_t* written) {
+    if (size > 0) {
+        char command = readInt(buffer, 8);
+        if (command == '0') {
+            CHECKED(setProfileMode(PROFILE_OFF));
+        } else if (command == '1') {
+            CHECKED(setProfileMode(PROFILE_PC));
+        } else if (command == '2') {
+            CHECKED(setProfileMode(PROFILE_BACKTRACE));
+        } else {
+            return simpleError(EINVAL);
+        }
+    }
+    *written = size;
+    return simpleError(SUCCESS);
+}
+
+static const CharDeviceFunctions funcs = {
+    .read = profileBlockingReadFunction,
+    .write = profileWriteFunction,
+    .read_at = profileReadAtFunction,
+};
+
+Error registerProfileDevice() {
+    CharDevice* dev = kalloc(sizeof(CharDevice));
+    dev->base.type = DEVICE_CHAR;
+    dev->base.name = "profile";
+    dev->functions = &funcs;
+    registerDevice((Device*)dev);
+    return simpleError(SUCCESS);
+}
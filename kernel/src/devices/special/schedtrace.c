@@ -0,0 +1,61 @@
+#include "devices/devices.h"
+#include "memory/kalloc.h"
+#include "task/schedtrace.h"
+#include "util/util.h"
+
+#include "devices/special/special.h"
+
+// Reading this device drains the scheduler trace buffers, giving whole SchedTraceEvent records.
+// Writing "1" enables tracing and writing "0" disables it again.
+
+#define MAX_EVENTS_PER_READ 1024
+
+static Error schedtraceReadFunction(CharDevice* dev, VirtPtr buffer, size_t size, size_t* read) {
+    size_t max = umin(size / sizeof(SchedTraceEvent), MAX_EVENTS_PER_READ);
+    if (max == 0) {
+        *read = 0;
+        return simpleError(SUCCESS);
+    }
+    SchedTraceEvent* events = kalloc(max * sizeof(SchedTraceEvent));
+    if (events == NULL) {
+        return simpleError(ENOMEM);
+    }
+    size_t count = drainSchedEvents(events, max);
+    *read = count * sizeof(SchedTraceEvent);
+    memcpyBetweenVirtPtr(buffer, virtPtrForKernel(events), *read);
+    dealloc(events);
+    return simpleError(SUCCESS);
+}
+
+static Error schedtraceBlockingReadFunction(CharDevice* dev, VirtPtr buffer, size_t size, size_t* read, bool block) {
+    return schedtraceReadFunction(dev, buffer, size, read);
+}
+
+static Error schedtraceReadAtFunction(CharDevice* dev, VirtPtr buffer, size_t offset, size_t size, size_t* read) {
+    // This is a stream, the offset has no meaning
+    return schedtraceReadFunction(dev, buffer, size, read);
+}
+
+static Error schedtraceWriteFunction(CharDevice* dev, VirtPtr buffer, size_t size, size_t* written) {
+    if (size > 0) {
+        char command = readInt(buffer, 8);
+        CHECKED(setSchedTraceEnabled(command != '0'));
+    }
+    *written = size;
+    return simpleError(SUCCESS);
+}
+
+static const CharDeviceFunctions funcs = {
+    .read = schedtraceBlockingReadFunction,
+    .write = schedtraceWriteFunction,
+    .read_at = schedtraceReadAtFunction,
+};
+
+Error registerSchedtraceDevice() {
+    CharDevice* dev = kalloc(sizeof(CharDevice));
+    dev->base.type = DEVICE_CHAR;
+    dev->base.name = "schedtrace";
+    dev->functions = &funcs;
+    registerDevice((Device*)dev);
+    return simpleError(SUCCESS);
+}
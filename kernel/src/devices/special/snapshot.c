@@ -0,0 +1,32 @@
+
+#include "devices/special/snapshot.h"
+
+#include "memory/kalloc.h"
+#include "util/util.h"
+
+void initTextSnapshot(TextSnapshot* snapshot) {
+    initTaskLock(&snapshot->lock);
+    snapshot->text.text = NULL;
+    snapshot->text.length = 0;
+    snapshot->text.capacity = 0;
+}
+
+Error readTextSnapshot(
+    TextSnapshot* snapshot, TextSnapshotFunction generate, VirtPtr buffer, size_t offset, size_t size, size_t* read
+) {
+    lockTaskLock(&snapshot->lock);
+    if (offset == 0) {
+        TextBuffer text = { .text = NULL, .length = 0, .capacity = 0 };
+        CHECKED(generate(&text), dealloc(text.text); unlockTaskLock(&snapshot->lock));
+        dealloc(snapshot->text.text);
+        snapshot->text = text;
+    }
+    if (offset < snapshot->text.length) {
+        *read = umin(size, snapshot->text.length - offset);
+        memcpyBetweenVirtPtr(buffer, virtPtrForKernel(snapshot->text.text + offset), *read);
+    } else {
+        *read = 0;
+    }
+    unlockTaskLock(&snapshot->lock);
+    return simpleError(SUCCESS);
+}
@@ -0,0 +1,24 @@
+#ifndef _DEVICES_SNAPSHOT_H_
+#define _DEVICES_SNAPSHOT_H_
+
+#include "error/error.h"
+#include "memory/virtptr.h"
+#include "task/tasklock.h"
+#include "util/text.h"
+
+// Text report of a device that is generated only on reads at offset zero. Later reads at other
+// offsets continue in the same snapshot, so reading it in chunks gives a consistent report.
+typedef struct {
+    TaskLock lock;
+    TextBuffer text;
+} TextSnapshot;
+
+typedef Error (*TextSnapshotFunction)(TextBuffer* text);
+
+void initTextSnapshot(TextSnapshot* snapshot);
+
+Error readTextSnapshot(
+    TextSnapshot* snapshot, TextSnapshotFunction generate, VirtPtr buffer, size_t offset, size_t size, size_t* read
+);
+
+#endif
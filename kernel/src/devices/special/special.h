@@ -9,4 +9,16 @@ Error registerZeroDevice();
 
 Error registerRandomDevice();
 
+Error registerMemstatDevice();
+
+Error registerLockstatDevice();
+
+Error registerSchedtraceDevice();
+
+Error registerInterruptsDevice();
+
+Error registerProfileDevice();
+
+Error registerKsymsDevice();
+
 #endif
@@ -4,14 +4,26 @@
 #include "devices/blockcache.h"
 #include "devices/devices.h"
 #include "error/error.h"
+#include "interrupt/deferred.h"
 #include "interrupt/plic.h"
 #include "memory/kalloc.h"
+#include "task/schedtrace.h"
 #include "task/schedule.h"
 #include "task/spinlock.h"
 #include "task/syscall.h"
 #include "util/random.h"
 
+// Maximum number of completed requests to handle in one run of the deferred work
+#define VIRTIO_COMPLETION_BATCH 16
+
 static void handleInterrupt(ExternalInterrupt id, void* udata) {
+    VirtIOBlockDevice* device = (VirtIOBlockDevice*)udata;
+    // Only acknowledge the interrupt here, the used ring is processed later
+    device->virtio.mmio->interrupt_ack = device->virtio.mmio->interrupt_status;
+    queueDeferredWork(&device->completion);
+}
+
+static void handleCompletions(void* udata) {
     virtIOBlockFreePendingRequests((VirtIOBlockDevice*)udata);
 }
 
@@ -42,6 +54,7 @@ Error initVirtIOBlockDevice(volatile VirtIODeviceLayout* base, ExternalInterrupt
     CHECKED(setupVirtIOQueue(&device->virtio), dealloc(device));
     status |= VIRTIO_DRIVER_OK;
     base->status = status;
+    initDeferredWork(&device->completion, handleCompletions, device);
     setInterruptFunction(itr_id, handleInterrupt, device);
     setInterruptPriority(itr_id, 1);
     registerVirtIOBlockDevice(device);
@@ -51,6 +64,8 @@ Error initVirtIOBlockDevice(volatile VirtIODeviceLayout* base, ExternalInterrupt
 static void waitForBlockOperation(void* _, VirtIOBlockDevice* device, VirtIOBlockRequest* request) {
     request->wakeup->sched.wakeup_function = NULL;
     moveTaskToState(request->wakeup, WAITING);
+    traceSchedEvent(SCHED_TRACE_BLOCK, request->wakeup, SCHED_TRACE_BLOCK_IO);
+    request->wakeup->usage.voluntary_switches++;
     enqueueTask(request->wakeup);
     sendRequestAt(&device->virtio, request->head);
     unlockSpinLock(&device->lock);
@@ -82,6 +97,11 @@ Error virtIOBlockDeviceOperation(VirtIOBlockDevice* device, VirtPtr buffer, size
     addDescriptorsFor(&device->virtio, virtPtrForKernel(&request.status), sizeof(VirtIOBlockRequestStatus), VIRTIO_DESC_WRITE, true);
     request.next = device->requests;
     device->requests = &request;
+    if (write) {
+        request.wakeup->usage.block_writes += size / BLOCK_SECTOR_SIZE;
+    } else {
+        request.wakeup->usage.block_reads += size / BLOCK_SECTOR_SIZE;
+    }
     if (saveToFrame(&request.wakeup->frame)) {
         callInHart((void*)waitForBlockOperation, device, &request);
     }
@@ -91,8 +111,15 @@ Error virtIOBlockDeviceOperation(VirtIOBlockDevice* device, VirtPtr buffer, size
 void virtIOBlockFreePendingRequests(VirtIOBlockDevice* device) {
     VirtIOBlockRequest* requests = NULL;
     lockSpinLock(&device->lock);
-    addRandomEvent(NULL, 0);
+    addRandomSample(device->virtio.ack_index);
+    size_t count = 0;
     for (; device->virtio.ack_index != device->virtio.queue->used.index; device->virtio.ack_index++) {
+        if (count == VIRTIO_COMPLETION_BATCH) {
+            // Continue later, so that other interrupts are not delayed for too long
+            queueDeferredWork(&device->completion);
+            break;
+        }
+        count++;
         VirtIOUsedElement elem = device->virtio.queue->used.ring[device->virtio.ack_index % VIRTIO_RING_SIZE];
         VirtIOBlockRequest** current = &device->requests;
         while (*current != NULL) {
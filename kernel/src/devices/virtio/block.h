@@ -5,6 +5,7 @@
 
 #include "devices/virtio/virtio.h"
 #include "task/spinlock.h"
+#include "interrupt/deferred.h"
 #include "interrupt/plic.h"
 
 #define BLOCK_SECTOR_SIZE 512
@@ -103,6 +104,7 @@ typedef struct {
     SpinLock lock;
     VirtIOBlockRequest* requests;
     bool read_only;
+    DeferredWork completion;
 } VirtIOBlockDevice;
 
 Error initVirtIOBlockDevice(volatile VirtIODeviceLayout* base, ExternalInterrupt itr_id);
@@ -111,6 +113,7 @@ Error registerVirtIOBlockDevice(VirtIOBlockDevice* dev);
 
 Error virtIOBlockDeviceOperation(VirtIOBlockDevice* device, VirtPtr buffer, size_t offset, size_t size, bool write);
 
+// Complete up to a batch of finished requests. Runs as deferred work after the interrupt.
 void virtIOBlockFreePendingRequests(VirtIOBlockDevice* device);
 
 #endif
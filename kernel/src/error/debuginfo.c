@@ -36,3 +36,7 @@ const LineDebugInfo* searchLineDebugInfo(uintptr_t addr) {
     }
 }
 
+const SymbolDebugInfo* getSymbolDebugInfos(size_t* count) {
+    *count = symbol_debug_count;
+    return symbol_debug;
+}
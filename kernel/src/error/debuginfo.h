@@ -19,4 +19,7 @@ const SymbolDebugInfo* searchSymbolDebugInfo(uintptr_t addr);
 
 const LineDebugInfo* searchLineDebugInfo(uintptr_t addr);
 
+// All symbols sorted by address, empty if the kernel was built without debug info
+const SymbolDebugInfo* getSymbolDebugInfos(size_t* count);
+
 #endif
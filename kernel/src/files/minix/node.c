@@ -149,8 +149,8 @@ static Error minixRWZoneWalkCallback(uint32_t* zone, bool* changed, size_t posit
     }
 }
 
-static Error minixReadWrite(MinixVfsNode* node, VirtPtr buffer, size_t offset, size_t length, bool write, size_t* ret) {
-    lockTaskLock(&node->lock);
+// Must be called with node->lock locked for reading or writing, depending on write.
+static Error minixLockedReadWrite(MinixVfsNode* node, VirtPtr buffer, size_t offset, size_t length, bool write, size_t* ret) {
     if (!write) {
         if (node->base.stat.size < offset) {
             length = 0;
@@ -159,7 +159,6 @@ static Error minixReadWrite(MinixVfsNode* node, VirtPtr buffer, size_t offset, s
         }
     }
     if (length == 0) {
-        unlockTaskLock(&node->lock);
         *ret = 0;
         return simpleError(SUCCESS);
     }
@@ -172,7 +171,6 @@ static Error minixReadWrite(MinixVfsNode* node, VirtPtr buffer, size_t offset, s
     };
     Error err = minixZoneWalk(node, offset, minixRWZoneWalkCallback, &request);
     if (err.kind != SUCCESS_EXIT && isError(err)) {
-        unlockTaskLock(&node->lock);
         return err;
     } else {
         length -= request.left;
@@ -182,12 +180,26 @@ static Error minixReadWrite(MinixVfsNode* node, VirtPtr buffer, size_t offset, s
             minixWriteNode(SUPER(node), node);
             unlockTaskLock(&node->base.lock);
         }
-        unlockTaskLock(&node->lock);
         *ret = length;
         return simpleError(SUCCESS);
     }
 }
 
+static Error minixReadWrite(MinixVfsNode* node, VirtPtr buffer, size_t offset, size_t length, bool write, size_t* ret) {
+    if (write) {
+        lockRwTaskLockWrite(&node->lock);
+        Error err = minixLockedReadWrite(node, buffer, offset, length, true, ret);
+        unlockRwTaskLockWrite(&node->lock);
+        return err;
+    } else {
+        // Reads only share the lock, so concurrent readers of the same file do not serialize.
+        lockRwTaskLockRead(&node->lock);
+        Error err = minixLockedReadWrite(node, buffer, offset, length, false, ret);
+        unlockRwTaskLockRead(&node->lock);
+        return err;
+    }
+}
+
 static Error minixReadAt(MinixVfsNode* node, VirtPtr buff, size_t offset, size_t length, size_t* read, bool block) {
     return minixReadWrite(node, buff, offset, length, false, read);
 }
@@ -254,32 +266,33 @@ static Error minixTruncZoneWalkCallback(uint32_t* zone, bool* changed, size_t po
 }
 
 static Error minixTrunc(MinixVfsNode* node, size_t length) {
-    lockTaskLock(&node->lock);
+    lockRwTaskLockWrite(&node->lock);
     MinixTruncRequest request = {
         .file = node,
         .length = length,
     };
     Error err = minixZoneWalk(node, length, minixTruncZoneWalkCallback, &request);
     if (err.kind != SUCCESS_EXIT && isError(err)) {
-        unlockTaskLock(&node->lock);
+        unlockRwTaskLockWrite(&node->lock);
         return err;
     } else {
         lockTaskLock(&node->base.lock);
         node->base.stat.size = length;
         minixWriteNode(SUPER(node), node);
         unlockTaskLock(&node->base.lock);
-        unlockTaskLock(&node->lock);
+        unlockRwTaskLockWrite(&node->lock);
         return simpleError(SUCCESS);
     }
 }
 
+// Must be called with node->lock locked.
 static Error minixInternalLookup(MinixVfsNode* node, const char* name, uint32_t* inodenum, size_t* off) {
     size_t offset = 0;
     size_t left = node->base.stat.size;
     MinixDirEntry* tmp_buffer = kalloc(umin(MAX_LOOKUP_READ_SIZE, left));
     while (left > 0) {
         size_t tmp_size = umin(MAX_LOOKUP_READ_SIZE, left);
-        CHECKED(minixReadAt(node, virtPtrForKernel(tmp_buffer), offset, tmp_size, &tmp_size, true), {
+        CHECKED(minixLockedReadWrite(node, virtPtrForKernel(tmp_buffer), offset, tmp_size, false, &tmp_size), {
             dealloc(tmp_buffer);
         });
         if (tmp_size == 0) {
@@ -304,9 +317,9 @@ static Error minixInternalLookup(MinixVfsNode* node, const char* name, uint32_t*
 static Error minixLookup(MinixVfsNode* node, const char* name, size_t* node_id) {
     uint32_t inodenum;
     size_t offset;
-    lockTaskLock(&node->lock);
+    lockRwTaskLockRead(&node->lock);
     Error err = minixInternalLookup(node, name, &inodenum, &offset);
-    unlockTaskLock(&node->lock);
+    unlockRwTaskLockRead(&node->lock);
     *node_id = inodenum;
     return err;
 }
@@ -314,21 +327,21 @@ static Error minixLookup(MinixVfsNode* node, const char* name, size_t* node_id)
 static Error minixUnlink(MinixVfsNode* node, const char* name) {
     uint32_t inodenum;
     size_t offset;
-    lockTaskLock(&node->lock);
-    CHECKED(minixInternalLookup(node, name, &inodenum, &offset), unlockTaskLock(&node->lock));
+    lockRwTaskLockWrite(&node->lock);
+    CHECKED(minixInternalLookup(node, name, &inodenum, &offset), unlockRwTaskLockWrite(&node->lock));
     MinixDirEntry entry;
     size_t tmp_size;
     CHECKED(
         minixReadAt(node, virtPtrForKernel(&entry), node->base.stat.size - sizeof(MinixDirEntry), sizeof(MinixDirEntry), &tmp_size, true),
-        unlockTaskLock(&node->lock)
+        unlockRwTaskLockWrite(&node->lock)
     );
     if (tmp_size != sizeof(MinixDirEntry)) {
-        unlockTaskLock(&node->lock);
+        unlockRwTaskLockWrite(&node->lock);
         return simpleError(EIO);
     }
-    CHECKED(minixWriteAt(node, virtPtrForKernel(&entry), offset, sizeof(MinixDirEntry), &tmp_size, true), unlockTaskLock(&node->lock));
+    CHECKED(minixWriteAt(node, virtPtrForKernel(&entry), offset, sizeof(MinixDirEntry), &tmp_size, true), unlockRwTaskLockWrite(&node->lock));
     Error err = minixTrunc(node, node->base.stat.size - sizeof(MinixDirEntry));
-    unlockTaskLock(&node->lock);
+    unlockRwTaskLockWrite(&node->lock);
     return err;
 }
 
@@ -341,21 +354,21 @@ static Error minixLink(MinixVfsNode* node, const char* name, MinixVfsNode* entry
     memcpy(entry.name, name, name_len);
     entry.name[name_len] = 0;
     size_t tmp_size;
-    lockTaskLock(&node->lock);
+    lockRwTaskLockWrite(&node->lock);
     uint32_t inodenum;
     size_t offset;
     Error err = minixInternalLookup(node, name, &inodenum, &offset);
     if (err.kind == ENOENT) {
         offset = node->base.stat.size;
     } else if (isError(err)) {
-        unlockTaskLock(&node->lock);
+        unlockRwTaskLockWrite(&node->lock);
         return err;
     }
     CHECKED(
         minixWriteAt(node, virtPtrForKernel(&entry), offset, sizeof(MinixDirEntry), &tmp_size, true),
-        unlockTaskLock(&node->lock)
+        unlockRwTaskLockWrite(&node->lock)
     );
-    unlockTaskLock(&node->lock);
+    unlockRwTaskLockWrite(&node->lock);
     return simpleError(tmp_size != sizeof(MinixDirEntry) ? EIO : SUCCESS);
 }
 
@@ -384,7 +397,7 @@ MinixVfsNode* createMinixVfsNode(MinixVfsSuperblock* fs, uint32_t inode) {
     initTaskLock(&node->base.lock);
     initTaskLock(&node->base.ref_lock);
     node->base.dirty = false;
-    initTaskLock(&node->lock);
+    initRwTaskLock(&node->lock);
     return node;
 }
 
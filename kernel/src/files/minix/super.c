@@ -64,14 +64,14 @@ Error minixWriteNode(MinixVfsSuperblock* sb, MinixVfsNode* write) {
         .ctime = write->base.stat.ctime / 1000000000UL,
     };
     unlockTaskLock(&write->base.lock);
-    lockTaskLock(&write->lock);
+    lockRwTaskLockRead(&write->lock);
     memcpy(inode.zones, write->zones, sizeof(inode.zones));
     size_t tmp_size;
     CHECKED(
         vfsFileWriteAt(sb->block_device, NULL, virtPtrForKernel(&inode), offsetForINode(sb, write->base.stat.id), sizeof(MinixInode), &tmp_size), 
-        unlockTaskLock(&write->lock);
+        unlockRwTaskLockRead(&write->lock);
     );
-    unlockTaskLock(&write->lock);
+    unlockRwTaskLockRead(&write->lock);
     return simpleError(tmp_size != sizeof(MinixInode) ? EIO : SUCCESS);
 }
 
@@ -4,6 +4,7 @@
 #include <stdint.h>
 
 #include "files/vfs/types.h"
+#include "task/rwtasklock.h"
 #include "task/spinlock.h"
 #include "task/tasklock.h"
 
@@ -54,7 +55,7 @@ typedef struct {
 
 typedef struct {
     VfsNode base;
-    TaskLock lock;
+    RwTaskLock lock; // Protects the zones, and the file content against concurrent writes
     uint32_t zones[10];
 } MinixVfsNode;
 
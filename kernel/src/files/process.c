@@ -3,6 +3,7 @@
 
 #include "files/process.h"
 
+#include "files/special/epoll.h"
 #include "files/vfs/file.h"
 #include "memory/kalloc.h"
 #include "task/spinlock.h"
@@ -54,6 +55,26 @@ VfsFileDescriptor* getFileDescriptor(Process* process, int fd) {
     }
 }
 
+// Must be called with the resources lock held, after the descriptor has been removed. Epoll
+// instances of the process forget the file once the process has no other descriptor for it.
+static void removeClosedFromEpoll(Process* process, int fd, VfsFile* file) {
+    VfsFileDescriptor* current = process->resources.files;
+    while (current != NULL) {
+        if (current->file == file) {
+            return;
+        }
+        current = current->next;
+    }
+    current = process->resources.files;
+    while (current != NULL) {
+        EpollInstance* instance = getEpollInstance(current->file);
+        if (instance != NULL) {
+            epollDescriptorClosed(instance, fd, file);
+        }
+        current = current->next;
+    }
+}
+
 int putNewFileDescriptor(Process* process, int fd, int flags, VfsFile* file, bool replace) {
     lockTaskLock(&process->resources.lock);
     vfsFileCopy(file);
@@ -73,6 +94,7 @@ int putNewFileDescriptor(Process* process, int fd, int flags, VfsFile* file, boo
             if (replace) {
                 VfsFileDescriptor* to_remove = *current;
                 *current = to_remove->next;
+                removeClosedFromEpoll(process, to_remove->id, to_remove->file);
                 vfsFileDescriptorClose(process, to_remove);
             } else {
                 while (*current != NULL && (*current)->id == fd) {
@@ -103,6 +125,7 @@ void closeFileDescriptor(Process* process, int fd) {
     if (*current != NULL && (*current)->id == fd) {
         VfsFileDescriptor* to_remove = *current;
         *current = to_remove->next;
+        removeClosedFromEpoll(process, to_remove->id, to_remove->file);
         vfsFileDescriptorClose(process, to_remove);
     }
     unlockTaskLock(&process->resources.lock);
@@ -127,6 +150,7 @@ void closeExecProcessFiles(Process* process) {
         if (((*current)->flags & VFS_DESC_CLOEXEC) != 0) {
             VfsFileDescriptor* to_remove = *current;
             *current = to_remove->next;
+            removeClosedFromEpoll(process, to_remove->id, to_remove->file);
             vfsFileDescriptorClose(process, to_remove);
         } else {
             current = &(*current)->next;
@@ -0,0 +1,342 @@
+
+#include <assert.h>
+
+#include "files/ring.h"
+
+#include "files/process.h"
+#include "files/syscall.h"
+#include "files/vfs/file.h"
+#include "files/vfs/fs.h"
+#include "interrupt/syscall.h"
+#include "interrupt/timer.h"
+#include "memory/kalloc.h"
+#include "memory/usercopy.h"
+#include "memory/virtmem.h"
+#include "task/harts.h"
+#include "task/schedule.h"
+#include "task/syscall.h"
+#include "task/task.h"
+#include "task/tasklock.h"
+
+// Time without new submissions after which the polling task stops
+#define RING_POLL_IDLE (CLOCKS_PER_SEC / 100)
+
+struct IoRing_s {
+    TaskLock lock;    // Held while running submissions
+    Process* process; // NULL after the ring was released
+    uintptr_t addr;
+    uint32_t entries;
+    uint32_t sq_head; // The copies in user memory are only written, never trusted
+    uint32_t cq_tail;
+    RingSetupFlags flags;
+    bool polling;     // The polling task is running
+    size_t refs;
+};
+
+static void releaseRingReference(IoRing* ring) {
+    if (__atomic_sub_fetch(&ring->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        dealloc(ring);
+    }
+}
+
+static uintptr_t headerField(IoRing* ring, size_t offset) {
+    return ring->addr + offset;
+}
+
+static uintptr_t submissionAddress(IoRing* ring, uint32_t index) {
+    return ring->addr + sizeof(RingHeader) + (index % ring->entries) * sizeof(RingSubmission);
+}
+
+static uintptr_t completionAddress(IoRing* ring, uint32_t index) {
+    return ring->addr + sizeof(RingHeader) + ring->entries * sizeof(RingSubmission)
+           + (index % ring->entries) * sizeof(RingCompletion);
+}
+
+static Error readHeaderField(IoRing* ring, size_t offset, uint32_t* value) {
+    return copyFromUser(ring->process->memory.mem, value, headerField(ring, offset), sizeof(uint32_t));
+}
+
+static Error writeHeaderField(IoRing* ring, size_t offset, uint32_t value) {
+    return copyToUser(ring->process->memory.mem, headerField(ring, offset), &value, sizeof(uint32_t));
+}
+
+static VfsFileDescriptor* getRingFile(Process* process, int fd, VfsFileFlags required) {
+    VfsFileDescriptor* desc = getFileDescriptor(process, fd);
+    if (desc != NULL && (desc->file->flags & required) != required) {
+        vfsFileDescriptorClose(process, desc);
+        return NULL;
+    }
+    return desc;
+}
+
+static int64_t runReadWrite(Process* process, RingSubmission* sub, bool write) {
+    VfsFileDescriptor* desc = getRingFile(process, sub->fd, write ? VFS_FILE_WRITE : VFS_FILE_READ);
+    if (desc == NULL) {
+        return -EBADF;
+    }
+    VirtPtr buffer = virtPtrFor(sub->addr, process->memory.mem);
+    size_t size;
+    Error err;
+    if (sub->offset == RING_NO_OFFSET) {
+        if (write) {
+            err = vfsFileWrite(desc->file, process, buffer, sub->length, &size);
+        } else {
+            err = vfsFileRead(desc->file, process, buffer, sub->length, &size);
+        }
+    } else {
+        if (write) {
+            err = vfsFileWriteAt(desc->file, process, buffer, sub->offset, sub->length, &size);
+        } else {
+            err = vfsFileReadAt(desc->file, process, buffer, sub->offset, sub->length, &size);
+        }
+    }
+    vfsFileDescriptorClose(process, desc);
+    return isError(err) ? -err.kind : (int64_t)size;
+}
+
+static int64_t runOpenAt(Process* process, RingSubmission* sub) {
+    VfsFileDescriptor* dir = NULL;
+    if (sub->fd != RING_AT_FDCWD) {
+        dir = getFileDescriptor(process, sub->fd);
+        if (dir == NULL) {
+            return -EBADF;
+        }
+    }
+    char* path = copyStringFromProcess(process, sub->addr);
+    if (path == NULL) {
+        if (dir != NULL) {
+            vfsFileDescriptorClose(process, dir);
+        }
+        return -EINVAL;
+    }
+    VfsFile* file;
+    VfsOpenFlags flags = convertOpenMode(sub->flags);
+    Error err = vfsOpenAt(&global_file_system, process, dir != NULL ? dir->file : NULL, path, flags, sub->mode, &file);
+    dealloc(path);
+    if (dir != NULL) {
+        vfsFileDescriptorClose(process, dir);
+    }
+    if (isError(err)) {
+        return -err.kind;
+    }
+    file->flags = flags & (VFS_OPEN_ACCESS_MODE | VFS_FILE_NONBLOCK);
+    int fd = putNewFileDescriptor(process, -1, (flags & VFS_OPEN_CLOEXEC) != 0 ? VFS_DESC_CLOEXEC : 0, file, false);
+    vfsFileClose(file);
+    return fd;
+}
+
+static int64_t runFileOperation(Process* process, RingSubmission* sub) {
+    VfsFileDescriptor* desc = getRingFile(process, sub->fd, 0);
+    if (desc == NULL) {
+        return -EBADF;
+    }
+    Error err = simpleError(SUCCESS);
+    if (sub->opcode == RING_OP_CLOSE) {
+        closeFileDescriptor(process, sub->fd);
+    } else if (sub->opcode == RING_OP_FSTAT) {
+        err = vfsFileStat(desc->file, process, virtPtrFor(sub->addr, process->memory.mem));
+    }
+    // File writes are not buffered, so there is nothing to do for RING_OP_FSYNC
+    vfsFileDescriptorClose(process, desc);
+    return -err.kind;
+}
+
+static int64_t runSubmission(Process* process, RingSubmission* sub) {
+    switch (sub->opcode) {
+        case RING_OP_NOP:
+            return 0;
+        case RING_OP_READ:
+            return runReadWrite(process, sub, false);
+        case RING_OP_WRITE:
+            return runReadWrite(process, sub, true);
+        case RING_OP_OPENAT:
+            return runOpenAt(process, sub);
+        case RING_OP_CLOSE:
+        case RING_OP_FSTAT:
+        case RING_OP_FSYNC:
+            return runFileOperation(process, sub);
+        default:
+            return -EINVAL;
+    }
+}
+
+// Must be called with the ring lock held and the process still attached
+static Error runSubmissions(IoRing* ring, size_t max, size_t* submitted) {
+    MemorySpace* mem = ring->process->memory.mem;
+    uint32_t sq_tail;
+    CHECKED(readHeaderField(ring, offsetof(RingHeader, sq_tail), &sq_tail));
+    // The process must write the submissions before the tail
+    memoryFence();
+    *submitted = 0;
+    while (ring->sq_head != sq_tail && *submitted < max) {
+        uint32_t cq_head;
+        CHECKED(readHeaderField(ring, offsetof(RingHeader, cq_head), &cq_head));
+        if (ring->cq_tail - cq_head >= ring->entries) {
+            // Wait until the process has consumed some of the completions
+            break;
+        }
+        RingSubmission sub;
+        CHECKED(copyFromUser(mem, &sub, submissionAddress(ring, ring->sq_head), sizeof(RingSubmission)));
+        ring->sq_head++;
+        RingCompletion completion = {
+            .user_data = sub.user_data,
+            .result = runSubmission(ring->process, &sub),
+        };
+        CHECKED(copyToUser(mem, completionAddress(ring, ring->cq_tail), &completion, sizeof(RingCompletion)));
+        ring->cq_tail++;
+        // The completion must be visible before the tail
+        memoryFence();
+        CHECKED(writeHeaderField(ring, offsetof(RingHeader, cq_tail), ring->cq_tail));
+        CHECKED(writeHeaderField(ring, offsetof(RingHeader, sq_head), ring->sq_head));
+        (*submitted)++;
+    }
+    return simpleError(SUCCESS);
+}
+
+static void yieldRingPoller(void* _, Task* task) {
+    moveTaskToState(task, ENQUABLE);
+    enqueueTask(task);
+    runNextTask();
+}
+
+static void ringPollerTask(IoRing* ring) {
+    Time last_work = getTime();
+    bool running = true;
+    while (running) {
+        lockTaskLock(&ring->lock);
+        size_t submitted = 0;
+        Error err = simpleError(SUCCESS);
+        if (ring->process != NULL) {
+            err = runSubmissions(ring, ring->entries, &submitted);
+        }
+        Time now = getTime();
+        if (submitted != 0) {
+            last_work = now;
+        } else if (ring->process == NULL || isError(err) || now > last_work + RING_POLL_IDLE) {
+            if (ring->process != NULL) {
+                writeHeaderField(ring, offsetof(RingHeader, flags), RING_NEED_WAKEUP);
+                memoryFence();
+                // Submissions added before the flag was visible would otherwise be missed
+                err = runSubmissions(ring, ring->entries, &submitted);
+            }
+            if (submitted != 0 && !isError(err)) {
+                writeHeaderField(ring, offsetof(RingHeader, flags), 0);
+                last_work = now;
+            } else {
+                ring->polling = false;
+                running = false;
+            }
+        }
+        unlockTaskLock(&ring->lock);
+        if (running) {
+            Task* self = criticalEnter();
+            if (saveToFrame(&self->frame)) {
+                callInHart((void*)yieldRingPoller, self);
+            }
+        }
+    }
+    releaseRingReference(ring);
+    leave();
+}
+
+// Must be called with the ring lock held
+static void startRingPoller(IoRing* ring) {
+    if (!ring->polling) {
+        Task* task = createKernelTask(ringPollerTask, HART_STACK_SIZE, DEFAULT_PRIORITY, "ring poller");
+        if (task != NULL) {
+            writeHeaderField(ring, offsetof(RingHeader, flags), 0);
+            ring->polling = true;
+            __atomic_add_fetch(&ring->refs, 1, __ATOMIC_ACQ_REL);
+            task->frame.regs[REG_ARGUMENT_0] = (uintptr_t)ring;
+            enqueueTask(task);
+        }
+    }
+}
+
+static IoRing* getProcessRing(Process* process) {
+    lockTaskLock(&process->resources.lock);
+    IoRing* ring = process->resources.ring;
+    if (ring != NULL) {
+        __atomic_add_fetch(&ring->refs, 1, __ATOMIC_ACQ_REL);
+    }
+    unlockTaskLock(&process->resources.lock);
+    return ring;
+}
+
+Error setupProcessRing(Process* process, uintptr_t addr, size_t entries, RingSetupFlags flags) {
+    if (addr == 0 && entries == 0) {
+        releaseProcessRing(process);
+        return simpleError(SUCCESS);
+    } else if (
+        addr == 0 || addr % sizeof(uint64_t) != 0 || entries == 0 || entries > RING_MAX_ENTRIES
+        || (entries & (entries - 1)) != 0 || (flags & ~RING_SETUP_POLL) != 0
+    ) {
+        return simpleError(EINVAL);
+    }
+    RingHeader header = {
+        .sq_head = 0,
+        .sq_tail = 0,
+        .cq_head = 0,
+        .cq_tail = 0,
+        .entries = entries,
+        .flags = (flags & RING_SETUP_POLL) != 0 ? RING_NEED_WAKEUP : 0,
+    };
+    CHECKED(copyToUser(process->memory.mem, addr, &header, sizeof(RingHeader)));
+    IoRing* ring = zalloc(sizeof(IoRing));
+    if (ring == NULL) {
+        return simpleError(ENOMEM);
+    }
+    initTaskLock(&ring->lock);
+    ring->process = process;
+    ring->addr = addr;
+    ring->entries = entries;
+    ring->flags = flags;
+    ring->refs = 1;
+    lockTaskLock(&process->resources.lock);
+    if (process->resources.ring != NULL) {
+        unlockTaskLock(&process->resources.lock);
+        dealloc(ring);
+        return simpleError(EBUSY);
+    }
+    process->resources.ring = ring;
+    unlockTaskLock(&process->resources.lock);
+    return simpleError(SUCCESS);
+}
+
+Error enterProcessRing(Process* process, size_t max, size_t* submitted) {
+    IoRing* ring = getProcessRing(process);
+    if (ring == NULL) {
+        return simpleError(ENXIO);
+    }
+    Error err = simpleError(SUCCESS);
+    *submitted = 0;
+    lockTaskLock(&ring->lock);
+    if (ring->process == NULL) {
+        err = simpleError(ENXIO);
+    } else if ((ring->flags & RING_SETUP_POLL) != 0) {
+        startRingPoller(ring);
+    } else {
+        err = runSubmissions(ring, max, submitted);
+        if (isError(err) && *submitted != 0) {
+            // Report the error with the next call, the completions are already posted
+            err = simpleError(SUCCESS);
+        }
+    }
+    unlockTaskLock(&ring->lock);
+    releaseRingReference(ring);
+    return err;
+}
+
+void releaseProcessRing(Process* process) {
+    lockTaskLock(&process->resources.lock);
+    IoRing* ring = process->resources.ring;
+    process->resources.ring = NULL;
+    unlockTaskLock(&process->resources.lock);
+    if (ring != NULL) {
+        // Waits for submissions that are currently running
+        lockTaskLock(&ring->lock);
+        ring->process = NULL;
+        unlockTaskLock(&ring->lock);
+        releaseRingReference(ring);
+    }
+}
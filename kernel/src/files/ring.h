@@ -0,0 +1,79 @@
+#ifndef _FILES_RING_H_
+#define _FILES_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "error/error.h"
+#include "process/types.h"
+
+// A process can submit many file operations at once through a submission ring in its own memory.
+// The kernel runs them either when the process enters the ring with a single syscall, or in a
+// kernel task that polls the ring. Results are posted to the completion ring in the same memory.
+// The layout must match userspace/src/ring.h.
+
+typedef enum {
+    RING_OP_NOP = 0,
+    RING_OP_READ = 1,
+    RING_OP_WRITE = 2,
+    RING_OP_OPENAT = 3,
+    RING_OP_CLOSE = 4,
+    RING_OP_FSTAT = 5,
+    RING_OP_FSYNC = 6,
+} RingOpcode;
+
+// Use the working directory as the base of openat
+#define RING_AT_FDCWD -100
+// Use and advance the position of the file instead of a given offset
+#define RING_NO_OFFSET UINT64_MAX
+
+typedef struct {
+    uint8_t opcode;
+    uint8_t reserved[3];
+    int32_t fd;
+    uint32_t flags;     // Open flags for openat
+    uint32_t mode;      // Mode of created files for openat
+    uint64_t addr;      // Buffer for read and write, path for openat, stat buffer for fstat
+    uint64_t length;
+    uint64_t offset;
+    uint64_t user_data; // Copied into the completion
+} RingSubmission;
+
+typedef struct {
+    uint64_t user_data;
+    int64_t result; // Result the equivalent syscall would return
+} RingCompletion;
+
+typedef enum {
+    RING_SETUP_POLL = (1 << 0),
+} RingSetupFlags;
+
+typedef enum {
+    RING_NEED_WAKEUP = (1 << 0), // The polling task stopped, the ring must be entered again
+} RingFlags;
+
+// The header is followed by the submission ring and then the completion ring, both with the
+// given number of entries.
+typedef struct {
+    uint32_t sq_head; // Written by the kernel
+    uint32_t sq_tail; // Written by the process
+    uint32_t cq_head; // Written by the process
+    uint32_t cq_tail; // Written by the kernel
+    uint32_t entries;
+    uint32_t flags;   // Written by the kernel
+} RingHeader;
+
+#define RING_MAX_ENTRIES 4096
+
+typedef struct IoRing_s IoRing;
+
+// Use the memory at addr as the ring of the process. With addr and entries 0, the ring is removed.
+Error setupProcessRing(Process* process, uintptr_t addr, size_t entries, RingSetupFlags flags);
+
+// Run at most max submissions, or wake the polling task if the ring is polled
+Error enterProcessRing(Process* process, size_t max, size_t* submitted);
+
+// Remove the ring from the process, e.g. on exit and exec
+void releaseProcessRing(Process* process);
+
+#endif
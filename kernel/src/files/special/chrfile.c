@@ -22,7 +22,11 @@ static Error ttyNodeWriteAt(VfsTtyNode* node, VirtPtr buff, size_t offset, size_
 }
 
 static Error ttyNodeReadAt(VfsTtyNode* node, VirtPtr buff, size_t offset, size_t length, size_t* read, bool block) {
-    return node->device->functions->read(node->device, buff, length, read, block);
+    if (node->device->functions->read_at != NULL) {
+        return node->device->functions->read_at(node->device, buff, offset, length, read);
+    } else {
+        return node->device->functions->read(node->device, buff, length, read, block);
+    }
 }
 
 static Error ttyNodeIoctl(VfsTtyNode* node, size_t request, VirtPtr argp, uintptr_t* res) {
@@ -41,12 +45,21 @@ static bool ttyNodeIsReady(VfsTtyNode* node, bool write) {
     }
 }
 
+static struct PollQueue_s* ttyNodePollQueue(VfsTtyNode* node) {
+    if (node->device->functions->poll_queue == NULL) {
+        return NULL;
+    } else {
+        return node->device->functions->poll_queue(node->device);
+    }
+}
+
 static const VfsNodeFunctions funcs = {
     .free = (VfsNodeFreeFunction)ttyNodeFree,
     .read_at = (VfsNodeReadAtFunction)ttyNodeReadAt,
     .write_at = (VfsNodeWriteAtFunction)ttyNodeWriteAt,
     .ioctl = (VfsNodeIoctlFunction)ttyNodeIoctl,
     .is_ready = (VfsNodeWillBlockFunction)ttyNodeIsReady,
+    .poll_queue = (VfsNodePollQueueFunction)ttyNodePollQueue,
 };
 
 VfsTtyNode* createTtyNode(CharDevice* device, VfsNode* real_node) {
@@ -0,0 +1,389 @@
+
+#include <assert.h>
+#include <string.h>
+
+#include "files/special/epoll.h"
+
+#include "files/vfs/file.h"
+#include "interrupt/timer.h"
+#include "memory/kalloc.h"
+#include "task/harts.h"
+#include "task/pollqueue.h"
+#include "task/schedtrace.h"
+#include "task/schedule.h"
+#include "task/syscall.h"
+
+typedef struct EpollItem_s {
+    struct EpollItem_s* next;       // Next item in the interest list
+    struct EpollItem_s* ready_next; // Next item in the ready list
+    EpollInstance* instance;
+    int fd;
+    VfsFile* file;
+    uint32_t events;
+    uint64_t data;
+    bool ready;                     // The item is in the ready list
+    PollWaiter waiter;
+} EpollItem;
+
+// Lock order is poll queue, then instance lock. The readiness of files is never checked while
+// holding the instance lock, because the files notify their queue with their own lock held.
+struct EpollInstance_s {
+    TaskLock ctl_lock; // Protects the interest list and serializes collecting events
+    SpinLock lock;     // Protects the ready list and the waiting tasks
+    EpollItem* items;
+    EpollItem* ready;  // Items that might be ready, in the order they were notified
+    EpollItem* ready_tail;
+    Task* waiting;     // Tasks waiting in epollWait, linked through sched.locks_next
+};
+
+typedef struct {
+    EpollInstance* instance;
+    Process* process;
+    Time deadline;
+} EpollWaitState;
+
+// Instance should be locked before calling this
+static void markItemReady(EpollInstance* instance, EpollItem* item) {
+    if (!item->ready) {
+        item->ready = true;
+        item->ready_next = NULL;
+        if (instance->ready_tail == NULL) {
+            instance->ready = item;
+        } else {
+            instance->ready_tail->ready_next = item;
+        }
+        instance->ready_tail = item;
+    }
+}
+
+// Instance should be locked before calling this
+static void unmarkItemReady(EpollInstance* instance, EpollItem* item) {
+    if (item->ready) {
+        EpollItem* prev = NULL;
+        EpollItem** current = &instance->ready;
+        while (*current != item) {
+            prev = *current;
+            current = &(*current)->ready_next;
+        }
+        *current = item->ready_next;
+        if (instance->ready_tail == item) {
+            instance->ready_tail = prev;
+        }
+        item->ready = false;
+    }
+}
+
+// Instance should be locked before calling this
+static void wakeWaitingTasks(EpollInstance* instance) {
+    while (instance->waiting != NULL) {
+        Task* task = instance->waiting;
+        instance->waiting = task->sched.locks_next;
+        if (tryAwakeningTask(task)) {
+            enqueueTask(task);
+        }
+    }
+}
+
+static void epollItemNotify(PollWaiter* waiter) {
+    EpollItem* item = (EpollItem*)waiter->udata;
+    EpollInstance* instance = item->instance;
+    lockSpinLock(&instance->lock);
+    markItemReady(instance, item);
+    wakeWaitingTasks(instance);
+    unlockSpinLock(&instance->lock);
+}
+
+static void recheckItem(EpollInstance* instance, EpollItem* item) {
+    lockSpinLock(&instance->lock);
+    markItemReady(instance, item);
+    wakeWaitingTasks(instance);
+    unlockSpinLock(&instance->lock);
+}
+
+static void freeEpollItem(EpollInstance* instance, EpollItem* item) {
+    removePollWaiter(&item->waiter);
+    lockSpinLock(&instance->lock);
+    unmarkItemReady(instance, item);
+    unlockSpinLock(&instance->lock);
+    vfsFileClose(item->file);
+    dealloc(item);
+}
+
+EpollInstance* createEpollInstance() {
+    EpollInstance* instance = zalloc(sizeof(EpollInstance));
+    if (instance != NULL) {
+        initTaskLock(&instance->ctl_lock);
+        initSpinLock(&instance->lock);
+    }
+    return instance;
+}
+
+void freeEpollInstance(EpollInstance* instance) {
+    while (instance->items != NULL) {
+        EpollItem* item = instance->items;
+        instance->items = item->next;
+        freeEpollItem(instance, item);
+    }
+    dealloc(instance);
+}
+
+Error epollControl(EpollInstance* instance, EpollCtlOperation op, int fd, VfsFile* file, EpollEvent* event, bool always_ready) {
+    lockTaskLock(&instance->ctl_lock);
+    // Like in Linux, items are identified by the descriptor and the file it referred to
+    EpollItem** current = &instance->items;
+    while (*current != NULL && ((*current)->fd != fd || (*current)->file != file)) {
+        current = &(*current)->next;
+    }
+    EpollItem* item = *current;
+    Error err = simpleError(SUCCESS);
+    if (op == EPOLL_CTL_ADD) {
+        PollQueue* queue = vfsFilePollQueue(file);
+        if (item != NULL) {
+            err = simpleError(EEXIST);
+        } else if (queue == NULL && !always_ready) {
+            err = simpleError(EPERM);
+        } else {
+            item = kalloc(sizeof(EpollItem));
+            if (item == NULL) {
+                err = simpleError(ENOMEM);
+            } else {
+                vfsFileCopy(file);
+                item->instance = instance;
+                item->fd = fd;
+                item->file = file;
+                item->events = event->events;
+                item->data = event->data;
+                item->ready = false;
+                item->waiter.queue = NULL;
+                item->next = instance->items;
+                instance->items = item;
+                if (queue != NULL) {
+                    addPollWaiter(queue, &item->waiter, epollItemNotify, item);
+                }
+                // The file might already be ready
+                recheckItem(instance, item);
+            }
+        }
+    } else if (op == EPOLL_CTL_MOD) {
+        if (item == NULL) {
+            err = simpleError(ENOENT);
+        } else {
+            item->events = event->events;
+            item->data = event->data;
+            recheckItem(instance, item);
+        }
+    } else if (op == EPOLL_CTL_DEL) {
+        if (item == NULL) {
+            err = simpleError(ENOENT);
+        } else {
+            *current = item->next;
+            freeEpollItem(instance, item);
+        }
+    } else {
+        err = simpleError(EINVAL);
+    }
+    unlockTaskLock(&instance->ctl_lock);
+    return err;
+}
+
+void epollDescriptorClosed(EpollInstance* instance, int fd, VfsFile* file) {
+    lockTaskLock(&instance->ctl_lock);
+    EpollItem** current = &instance->items;
+    while (*current != NULL) {
+        EpollItem* item = *current;
+        if (item->fd == fd && item->file == file) {
+            *current = item->next;
+            freeEpollItem(instance, item);
+        } else {
+            current = &item->next;
+        }
+    }
+    unlockTaskLock(&instance->ctl_lock);
+}
+
+static uint32_t currentItemEvents(EpollItem* item, Process* process) {
+    uint32_t events = 0;
+    if ((item->events & EPOLL_IN) != 0 && vfsFileIsReady(item->file, process, false)) {
+        events |= EPOLL_IN;
+    }
+    if ((item->events & EPOLL_OUT) != 0 && vfsFileIsReady(item->file, process, true)) {
+        events |= EPOLL_OUT;
+    }
+    return events;
+}
+
+// ctl_lock should be held when calling this
+static size_t collectEvents(EpollInstance* instance, Process* process, EpollEvent* events, size_t max) {
+    lockSpinLock(&instance->lock);
+    EpollItem* ready = instance->ready;
+    instance->ready = NULL;
+    instance->ready_tail = NULL;
+    for (EpollItem* item = ready; item != NULL; item = item->ready_next) {
+        // Notifications from now on will put the item back into the list
+        item->ready = false;
+    }
+    unlockSpinLock(&instance->lock);
+    size_t count = 0;
+    EpollItem* requeue = NULL;
+    while (ready != NULL) {
+        EpollItem* item = ready;
+        ready = item->ready_next;
+        uint32_t current = currentItemEvents(item, process);
+        if (current != 0) {
+            if (count < max) {
+                events[count].events = current;
+                events[count].data = item->data;
+                count++;
+                if ((item->events & EPOLL_ONESHOT) != 0) {
+                    // Disabled until changed with EPOLL_CTL_MOD
+                    item->events = 0;
+                } else if ((item->events & EPOLL_ET) == 0) {
+                    // Level triggered items are reported until they are no longer ready
+                    item->ready_next = requeue;
+                    requeue = item;
+                }
+            } else {
+                item->ready_next = requeue;
+                requeue = item;
+            }
+        }
+    }
+    if (requeue != NULL) {
+        lockSpinLock(&instance->lock);
+        while (requeue != NULL) {
+            EpollItem* item = requeue;
+            requeue = item->ready_next;
+            markItemReady(instance, item);
+        }
+        unlockSpinLock(&instance->lock);
+    }
+    return count;
+}
+
+static bool hasPendingSignals(Process* process) {
+    if (process == NULL) {
+        return false;
+    }
+    lockSpinLock(&process->lock);
+    bool pending = process->signals.signals != NULL;
+    unlockSpinLock(&process->lock);
+    return pending;
+}
+
+static bool handleEpollWakeup(Task* task, void* udata) {
+    EpollWaitState* state = (EpollWaitState*)udata;
+    if (getTime() >= state->deadline || hasPendingSignals(state->process)) {
+        // Notifications lock the instance before the waiting list, so we can not wait for it here
+        if (tryLockingSpinLock(&state->instance->lock)) {
+            Task** current = &state->instance->waiting;
+            while (*current != NULL && *current != task) {
+                current = &(*current)->sched.locks_next;
+            }
+            if (*current != NULL) {
+                *current = task->sched.locks_next;
+            }
+            unlockSpinLock(&state->instance->lock);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void waitForEpollEvents(void* _, Task* task, EpollWaitState* state) {
+    task->sched.wakeup_udata = state;
+    task->sched.wakeup_function = handleEpollWakeup;
+    moveTaskToState(task, WAITING);
+    traceSchedEvent(SCHED_TRACE_BLOCK, task, SCHED_TRACE_BLOCK_IO);
+    task->usage.voluntary_switches++;
+    enqueueTask(task);
+    task->sched.locks_next = state->instance->waiting;
+    state->instance->waiting = task;
+    unlockSpinLock(&state->instance->lock);
+    runNextTask();
+}
+
+Error epollWait(EpollInstance* instance, Process* process, EpollEvent* events, size_t max, Time timeout, size_t* count) {
+    EpollWaitState state = {
+        .instance = instance,
+        .process = process,
+        .deadline = timeout == EPOLL_NO_TIMEOUT ? EPOLL_NO_TIMEOUT : getTime() + timeout,
+    };
+    if (timeout != 0 && timeout != EPOLL_NO_TIMEOUT) {
+        // Make sure we wake up in time
+        setTimeoutTime(state.deadline, NULL, NULL);
+    }
+    for (;;) {
+        lockTaskLock(&instance->ctl_lock);
+        *count = collectEvents(instance, process, events, max);
+        unlockTaskLock(&instance->ctl_lock);
+        if (*count != 0 || getTime() >= state.deadline) {
+            return simpleError(SUCCESS);
+        } else if (hasPendingSignals(process)) {
+            return simpleError(EINTR);
+        }
+        Task* task = criticalEnter();
+        assert(task != NULL);
+        lockSpinLock(&instance->lock);
+        if (instance->ready != NULL) {
+            // Some file was notified since we collected the events
+            unlockSpinLock(&instance->lock);
+            criticalReturn(task);
+        } else if (saveToFrame(&task->frame)) {
+            callInHart((void*)waitForEpollEvents, task, &state);
+        }
+    }
+}
+
+typedef struct {
+    VfsNode base;
+    EpollInstance* instance;
+} VfsEpollNode;
+
+static void epollNodeFree(VfsEpollNode* node) {
+    freeEpollInstance(node->instance);
+    dealloc(node);
+}
+
+static const VfsNodeFunctions funcs = {
+    .free = (VfsNodeFreeFunction)epollNodeFree,
+};
+
+static VfsEpollNode* createEpollNode(EpollInstance* instance) {
+    VfsEpollNode* node = kalloc(sizeof(VfsEpollNode));
+    node->base.functions = &funcs;
+    node->base.superblock = NULL;
+    memset(&node->base.stat, 0, sizeof(VfsStat));
+    node->base.stat.mode = TYPE_MODE(VFS_TYPE_UNKNOWN) | 0600;
+    Time time = getNanosecondsWithFallback();
+    node->base.stat.atime = time;
+    node->base.stat.mtime = time;
+    node->base.stat.ctime = time;
+    node->base.real_node = (VfsNode*)node;
+    node->base.ref_count = 1;
+    initTaskLock(&node->base.lock);
+    initTaskLock(&node->base.ref_lock);
+    node->base.mounted = NULL;
+    node->base.dirty = false;
+    node->instance = instance;
+    return node;
+}
+
+VfsFile* createEpollFile(EpollInstance* instance) {
+    VfsFile* file = kalloc(sizeof(VfsFile));
+    file->node = (VfsNode*)createEpollNode(instance);
+    file->path = NULL;
+    file->ref_count = 1;
+    file->offset = 0;
+    file->flags = 0;
+    initTaskLock(&file->lock);
+    initTaskLock(&file->ref_lock);
+    return file;
+}
+
+EpollInstance* getEpollInstance(VfsFile* file) {
+    if (file->node->functions == &funcs) {
+        return ((VfsEpollNode*)file->node)->instance;
+    } else {
+        return NULL;
+    }
+}
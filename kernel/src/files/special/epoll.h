@@ -0,0 +1,60 @@
+#ifndef _EPOLL_H_
+#define _EPOLL_H_
+
+#include <stdint.h>
+
+#include "files/vfs/types.h"
+#include "kernel/time.h"
+#include "process/types.h"
+
+// An epoll instance holds a list of files the process is interested in. The files notify the
+// instance through their poll queue, so that waiting only has to look at the files that changed.
+// The values match the ones used by Linux.
+
+typedef enum {
+    EPOLL_IN = 0x001,
+    EPOLL_OUT = 0x004,
+    EPOLL_ERR = 0x008,
+    EPOLL_HUP = 0x010,
+    EPOLL_ONESHOT = (1U << 30), // Disable the file after reporting it once
+    EPOLL_ET = (1U << 31),      // Report only changes instead of the current readiness
+} EpollEvents;
+
+typedef enum {
+    EPOLL_CTL_ADD = 1,
+    EPOLL_CTL_DEL = 2,
+    EPOLL_CTL_MOD = 3,
+} EpollCtlOperation;
+
+typedef struct {
+    uint32_t events;
+    uint64_t data;
+} EpollEvent;
+
+// Wait forever in epollWait
+#define EPOLL_NO_TIMEOUT UINT64_MAX
+
+typedef struct EpollInstance_s EpollInstance;
+
+EpollInstance* createEpollInstance();
+
+void freeEpollInstance(EpollInstance* instance);
+
+// Add, modify or remove the interest in file, identified by fd. Files that can not be waited for
+// are only accepted if always_ready is set, and are then considered to never block.
+Error epollControl(EpollInstance* instance, EpollCtlOperation op, int fd, VfsFile* file, EpollEvent* event, bool always_ready);
+
+// Remove the items added for fd referring to file. Called when a process closes its last descriptor
+// for the file. Linux only removes them once the file is closed in all processes.
+void epollDescriptorClosed(EpollInstance* instance, int fd, VfsFile* file);
+
+// Wait until at least one of the files is ready, or until timeout clock ticks have passed. Must be
+// called from a kernel task, e.g. a syscall.
+Error epollWait(EpollInstance* instance, Process* process, EpollEvent* events, size_t max, Time timeout, size_t* count);
+
+VfsFile* createEpollFile(EpollInstance* instance);
+
+// Returns NULL if the file is not an epoll instance
+EpollInstance* getEpollInstance(VfsFile* file);
+
+#endif
@@ -64,11 +64,16 @@ static bool fifoNodeIsReady(VfsFifoNode* node, bool write) {
     return pipeIsReady(node->data, write);
 }
 
+static PollQueue* fifoNodePollQueue(VfsFifoNode* node) {
+    return pipePollQueue(node->data);
+}
+
 static const VfsNodeFunctions funcs = {
     .free = (VfsNodeFreeFunction)fifoNodeFree,
     .read_at = (VfsNodeReadAtFunction)fifoNodeReadAt,
     .write_at = (VfsNodeWriteAtFunction)fifoNodeWriteAt,
     .is_ready = (VfsNodeWillBlockFunction)fifoNodeIsReady,
+    .poll_queue = (VfsNodePollQueueFunction)fifoNodePollQueue,
 };
 
 VfsFifoNode* createFifoNode(char* path, VfsNode* real_node, bool for_write) {
@@ -8,6 +8,7 @@
 #include "files/vfs/node.h"
 #include "kernel/time.h"
 #include "memory/kalloc.h"
+#include "task/schedtrace.h"
 #include "task/schedule.h"
 #include "task/syscall.h"
 #include "util/util.h"
@@ -80,6 +81,7 @@ static void doOperationOnPipe(PipeSharedData* pipe) {
             break;
         }
     }
+    notifyPollQueue(&pipe->poll);
 }
 
 static bool handlePipeWakeup(Task* task, void* udata) {
@@ -111,6 +113,8 @@ static void waitForPipeOperation(void* _, Task* task, PipeSharedData* data) {
     task->sched.wakeup_udata = data;
     task->sched.wakeup_function = task->sys_task->process != NULL ? handlePipeWakeup : NULL;
     moveTaskToState(task, WAITING);
+    traceSchedEvent(SCHED_TRACE_BLOCK, task, SCHED_TRACE_BLOCK_IO);
+    task->usage.voluntary_switches++;
     enqueueTask(task);
     doOperationOnPipe(data);
     unlockSpinLock(&data->lock);
@@ -186,6 +190,7 @@ PipeSharedData* createPipeSharedData(bool for_write) {
     data->ref_count = 1;
     data->write_count = for_write ? 1 : 0;
     data->buffer = kalloc(PIPE_BUFFER_CAPACITY);
+    initPollQueue(&data->poll);
     return data;
 }
 
@@ -257,11 +262,20 @@ static bool pipeNodeIsReady(VfsPipeNode* node, bool write) {
     return pipeIsReady(node->data, write);
 }
 
+PollQueue* pipePollQueue(PipeSharedData* data) {
+    return &data->poll;
+}
+
+static PollQueue* pipeNodePollQueue(VfsPipeNode* node) {
+    return pipePollQueue(node->data);
+}
+
 static const VfsNodeFunctions funcs = {
     .free = (VfsNodeFreeFunction)pipeNodeFree,
     .read_at = (VfsNodeReadAtFunction)pipeNodeReadAt,
     .write_at = (VfsNodeWriteAtFunction)pipeNodeWriteAt,
     .is_ready = (VfsNodeWillBlockFunction)pipeNodeIsReady,
+    .poll_queue = (VfsNodePollQueueFunction)pipeNodePollQueue,
 };
 
 VfsPipeNode* createPipeNode(PipeSharedData* data, bool for_write) {
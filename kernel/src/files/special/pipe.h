@@ -3,6 +3,7 @@
 
 #include <stddef.h>
 
+#include "task/pollqueue.h"
 #include "task/spinlock.h"
 #include "process/types.h"
 
@@ -27,6 +28,7 @@ typedef struct PipeSharedData_s {
     WaitingPipeOperation* waiting_reads_tail;
     WaitingPipeOperation* waiting_writes;
     WaitingPipeOperation* waiting_writes_tail;
+    PollQueue poll; // Notified after every change to the pipe
 } PipeSharedData;
 
 PipeSharedData* createPipeSharedData(bool for_write);
@@ -39,6 +41,8 @@ Error executePipeOperation(PipeSharedData* data, VirtPtr buffer, size_t size, bo
 
 bool pipeIsReady(PipeSharedData* data, bool write);
 
+PollQueue* pipePollQueue(PipeSharedData* data);
+
 VfsFile* createPipeFile(bool for_write);
 
 VfsFile* createPipeFileClone(VfsFile* file, bool for_write);
@@ -0,0 +1,225 @@
+
+#include <assert.h>
+#include <string.h>
+
+#include "files/special/shm.h"
+
+#include "files/vfs/fs.h"
+#include "files/vfs/node.h"
+#include "kernel/time.h"
+#include "memory/kalloc.h"
+#include "memory/memspace.h"
+#include "memory/pagealloc.h"
+#include "util/stringmap.h"
+#include "util/util.h"
+
+// Shared memory objects are special nodes holding a list of pages. Every page is referenced by the
+// object itself and by all the memory spaces it is mapped into.
+
+typedef struct {
+    VfsNode base;
+    void** pages;
+    size_t page_count;
+} VfsShmNode;
+
+static TaskLock shm_name_lock;
+static StringMap named_objects = STRING_MAP_INITIALIZER;
+
+static void shmNodeFree(VfsShmNode* node) {
+    for (size_t i = 0; i < node->page_count; i++) {
+        removePageReference(node->pages[i]);
+    }
+    dealloc(node->pages);
+    dealloc(node);
+}
+
+static Error shmNodeResize(VfsShmNode* node, size_t size) {
+    size_t page_count = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (page_count > node->page_count) {
+        void** pages = krealloc(node->pages, page_count * sizeof(void*));
+        if (pages == NULL) {
+            return simpleError(ENOMEM);
+        }
+        node->pages = pages;
+        for (size_t i = node->page_count; i < page_count; i++) {
+            node->pages[i] = zallocPage();
+            if (node->pages[i] == NULL) {
+                node->page_count = i;
+                return simpleError(ENOMEM);
+            }
+        }
+    } else {
+        for (size_t i = page_count; i < node->page_count; i++) {
+            removePageReference(node->pages[i]);
+        }
+        if (page_count < node->page_count && size % PAGE_SIZE != 0) {
+            // Bytes after the end must read as zero if the object grows again
+            memset(node->pages[page_count - 1] + size % PAGE_SIZE, 0, PAGE_SIZE - size % PAGE_SIZE);
+        }
+    }
+    node->page_count = page_count;
+    node->base.stat.size = size;
+    node->base.stat.blocks = page_count;
+    return simpleError(SUCCESS);
+}
+
+static Error shmNodeCopy(VfsShmNode* node, VirtPtr buff, size_t offset, size_t length, size_t* copied, bool write) {
+    *copied = 0;
+    while (*copied < length) {
+        size_t position = offset + *copied;
+        void* page = node->pages[position / PAGE_SIZE] + position % PAGE_SIZE;
+        size_t part = umin(length - *copied, PAGE_SIZE - position % PAGE_SIZE);
+        if (write) {
+            memcpyBetweenVirtPtr(virtPtrForKernel(page), buff, part);
+        } else {
+            memcpyBetweenVirtPtr(buff, virtPtrForKernel(page), part);
+        }
+        buff.address += part;
+        *copied += part;
+    }
+    return simpleError(SUCCESS);
+}
+
+static Error shmNodeReadAt(VfsShmNode* node, VirtPtr buff, size_t offset, size_t length, size_t* read, bool block) {
+    lockTaskLock(&node->base.lock);
+    if (offset >= node->base.stat.size) {
+        *read = 0;
+        unlockTaskLock(&node->base.lock);
+        return simpleError(SUCCESS);
+    }
+    Error err = shmNodeCopy(node, buff, offset, umin(length, node->base.stat.size - offset), read, false);
+    unlockTaskLock(&node->base.lock);
+    return err;
+}
+
+static Error shmNodeWriteAt(VfsShmNode* node, VirtPtr buff, size_t offset, size_t length, size_t* written, bool block) {
+    lockTaskLock(&node->base.lock);
+    if (offset + length > node->base.stat.size) {
+        CHECKED(shmNodeResize(node, offset + length), unlockTaskLock(&node->base.lock));
+    }
+    Error err = shmNodeCopy(node, buff, offset, length, written, true);
+    unlockTaskLock(&node->base.lock);
+    return err;
+}
+
+static Error shmNodeTrunc(VfsShmNode* node, size_t length) {
+    lockTaskLock(&node->base.lock);
+    Error err = shmNodeResize(node, length);
+    unlockTaskLock(&node->base.lock);
+    return err;
+}
+
+static const VfsNodeFunctions funcs = {
+    .free = (VfsNodeFreeFunction)shmNodeFree,
+    .read_at = (VfsNodeReadAtFunction)shmNodeReadAt,
+    .write_at = (VfsNodeWriteAtFunction)shmNodeWriteAt,
+    .trunc = (VfsNodeTruncFunction)shmNodeTrunc,
+};
+
+static VfsShmNode* createShmNode(Process* process, VfsMode mode) {
+    VfsShmNode* node = kalloc(sizeof(VfsShmNode));
+    if (node == NULL) {
+        return NULL;
+    }
+    node->base.functions = &funcs;
+    node->base.superblock = NULL;
+    memset(&node->base.stat, 0, sizeof(VfsStat));
+    lockTaskLock(&process->resources.lock);
+    node->base.stat.mode = TYPE_MODE(VFS_TYPE_REG) | (mode & ~process->resources.umask & 0777);
+    unlockTaskLock(&process->resources.lock);
+    lockSpinLock(&process->user.lock);
+    node->base.stat.uid = process->user.euid;
+    node->base.stat.gid = process->user.egid;
+    unlockSpinLock(&process->user.lock);
+    node->base.stat.nlinks = 1;
+    node->base.stat.block_size = PAGE_SIZE;
+    Time time = getNanosecondsWithFallback();
+    node->base.stat.atime = time;
+    node->base.stat.mtime = time;
+    node->base.stat.ctime = time;
+    node->base.real_node = (VfsNode*)node;
+    node->base.ref_count = 1; // This is the reference of the name
+    initTaskLock(&node->base.lock);
+    initTaskLock(&node->base.ref_lock);
+    node->base.mounted = NULL;
+    node->base.dirty = false;
+    node->pages = NULL;
+    node->page_count = 0;
+    return node;
+}
+
+Error shmOpen(Process* process, const char* name, VfsOpenFlags flags, VfsMode mode, VfsFile** ret) {
+    lockTaskLock(&shm_name_lock);
+    VfsShmNode* node = getFromStringMap(&named_objects, name);
+    if (node == NULL) {
+        if ((flags & VFS_OPEN_CREAT) == 0) {
+            unlockTaskLock(&shm_name_lock);
+            return simpleError(ENOENT);
+        }
+        node = createShmNode(process, mode);
+        if (node == NULL) {
+            unlockTaskLock(&shm_name_lock);
+            return simpleError(ENOMEM);
+        }
+        putToStringMap(&named_objects, name, node);
+    } else if ((flags & VFS_OPEN_CREAT) != 0 && (flags & VFS_OPEN_EXCL) != 0) {
+        unlockTaskLock(&shm_name_lock);
+        return simpleError(EEXIST);
+    } else {
+        CHECKED(canAccess((VfsNode*)node, process, OPEN_ACCESS(flags)), unlockTaskLock(&shm_name_lock));
+    }
+    vfsNodeCopy((VfsNode*)node);
+    unlockTaskLock(&shm_name_lock);
+    if ((flags & VFS_OPEN_TRUNC) != 0 && (flags & VFS_OPEN_WRITE) != 0) {
+        CHECKED(shmNodeTrunc(node, 0), vfsNodeClose((VfsNode*)node));
+    }
+    VfsFile* file = kalloc(sizeof(VfsFile));
+    if (file == NULL) {
+        vfsNodeClose((VfsNode*)node);
+        return simpleError(ENOMEM);
+    }
+    file->node = (VfsNode*)node;
+    file->path = NULL;
+    file->ref_count = 1;
+    file->offset = 0;
+    file->flags = 0;
+    initTaskLock(&file->lock);
+    initTaskLock(&file->ref_lock);
+    *ret = file;
+    return simpleError(SUCCESS);
+}
+
+Error shmUnlink(Process* process, const char* name) {
+    lockTaskLock(&shm_name_lock);
+    VfsShmNode* node = getFromStringMap(&named_objects, name);
+    if (node == NULL) {
+        unlockTaskLock(&shm_name_lock);
+        return simpleError(ENOENT);
+    }
+    CHECKED(canAccess((VfsNode*)node, process, VFS_ACCESS_W), unlockTaskLock(&shm_name_lock));
+    deleteFromStringMap(&named_objects, name);
+    unlockTaskLock(&shm_name_lock);
+    lockTaskLock(&node->base.lock);
+    node->base.stat.nlinks = 0;
+    unlockTaskLock(&node->base.lock);
+    vfsNodeClose((VfsNode*)node);
+    return simpleError(SUCCESS);
+}
+
+bool isShmNode(VfsNode* node) {
+    return node->functions == &funcs;
+}
+
+Error getShmPage(VfsNode* node, size_t index, void** page) {
+    VfsShmNode* shm = (VfsShmNode*)node;
+    lockTaskLock(&shm->base.lock);
+    if (index >= shm->page_count) {
+        unlockTaskLock(&shm->base.lock);
+        return simpleError(ENXIO);
+    }
+    *page = shm->pages[index];
+    // Take the reference before a concurrent truncate can free the page
+    addPageReference(*page);
+    unlockTaskLock(&shm->base.lock);
+    return simpleError(SUCCESS);
+}
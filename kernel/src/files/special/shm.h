@@ -0,0 +1,19 @@
+#ifndef _SHM_H_
+#define _SHM_H_
+
+#include "files/vfs/types.h"
+#include "process/types.h"
+
+// Open the shared memory object with the given name. flags are the same as for opening a file.
+Error shmOpen(Process* process, const char* name, VfsOpenFlags flags, VfsMode mode, VfsFile** ret);
+
+// Remove the name of the shared memory object. The object is freed once it is no longer used.
+Error shmUnlink(Process* process, const char* name);
+
+bool isShmNode(VfsNode* node);
+
+// Get the page at the given index. A reference is added to the page for the caller, which must be
+// removed if the page is not mapped.
+Error getShmPage(VfsNode* node, size_t index, void** page);
+
+#endif
@@ -6,11 +6,15 @@
 
 #include "files/path.h"
 #include "files/process.h"
+#include "files/ring.h"
+#include "files/special/epoll.h"
 #include "files/special/pipe.h"
+#include "files/special/shm.h"
 #include "files/vfs/file.h"
 #include "files/vfs/fs.h"
 #include "files/vfs/super.h"
 #include "memory/kalloc.h"
+#include "memory/usercopy.h"
 #include "memory/virtptr.h"
 #include "task/schedule.h"
 #include "task/types.h"
@@ -438,85 +442,339 @@ SyscallReturn isattySyscall(TrapFrame* frame) {
     }
 }
 
-static bool handleSelectWakeup(Task* task, void* _) {
-    TrapFrame* frame = (TrapFrame*)task;
-    if (task->process != NULL) {
-        lockSpinLock(&task->process->lock); 
-        if (task->process->signals.signals != NULL) {
-            unlockSpinLock(&task->process->lock); 
-            task->frame.regs[REG_ARGUMENT_0] = -EINTR;
-            return true;
-        } else {
-            unlockSpinLock(&task->process->lock); 
-        }
+// Upper limit for the number of files in a single select or poll
+#define MAX_WAIT_FDS (1 << 16)
+
+// Returned in revents of poll for invalid file descriptors
+#define POLL_NVAL 0x020
+
+typedef struct {
+    int fd;
+    short events;
+    short revents;
+} PollFd;
+
+static Time timeoutFromMillis(int timeout) {
+    if (timeout < 0) {
+        return EPOLL_NO_TIMEOUT;
+    } else {
+        return (Time)timeout * CLOCKS_PER_SEC / 1000;
     }
-    size_t num_ready = 0;
+}
+
+SyscallReturn selectSyscall(TrapFrame* frame) {
+    assert(frame->hart != NULL);
+    Task* task = (Task*)frame;
+    assert(task->process != NULL);
     size_t num_fds = SYSCALL_ARG(0);
-    VirtPtr reads_ptr = virtPtrForTask(SYSCALL_ARG(1), task);
-    VirtPtr writes_ptr = virtPtrForTask(SYSCALL_ARG(2), task);
-    VirtPtr excepts_ptr = virtPtrForTask(SYSCALL_ARG(3), task);
-    uint64_t reads = readInt(reads_ptr, 64);
-    uint64_t writes = readInt(writes_ptr, 64);
-    for (size_t i = 0; i < num_fds; i++) {
-        if ((reads & (1UL << i)) != 0) {
-            // TODO: This is safe only as long as we have only one task per process
-            VfsFileDescriptor* desc = getFileDescriptorUnsafe(task->process, i);
-            if (desc == NULL || (desc->file->flags & VFS_FILE_READ) == 0) {
-                task->frame.regs[REG_ARGUMENT_0] = -EBADF;
-                return true;
+    if (num_fds > MAX_WAIT_FDS) {
+        SYSCALL_RETURN(-EINVAL);
+    }
+    // The sets are arrays of 64 bit words, with at least num_fds bits
+    size_t words = (num_fds + 63) / 64;
+    MemorySpace* mem = task->process->memory.mem;
+    uint64_t* reads = zalloc(umax(2 * words, 1) * sizeof(uint64_t));
+    EpollEvent* events = kalloc(umax(num_fds, 1) * sizeof(EpollEvent));
+    // Waiting for the readiness is done by a temporary epoll instance
+    EpollInstance* instance = createEpollInstance();
+    if (reads == NULL || events == NULL || instance == NULL) {
+        dealloc(reads);
+        dealloc(events);
+        if (instance != NULL) {
+            freeEpollInstance(instance);
+        }
+        SYSCALL_RETURN(-ENOMEM);
+    }
+    uint64_t* writes = reads + words;
+    Error err = simpleError(SUCCESS);
+    if (SYSCALL_ARG(1) != 0) {
+        err = copyFromUser(mem, reads, SYSCALL_ARG(1), words * sizeof(uint64_t));
+    }
+    if (!isError(err) && SYSCALL_ARG(2) != 0) {
+        err = copyFromUser(mem, writes, SYSCALL_ARG(2), words * sizeof(uint64_t));
+    }
+    for (size_t i = 0; i < num_fds && !isError(err); i++) {
+        EpollEvent event = { .events = 0, .data = i };
+        if ((reads[i / 64] & (1UL << (i % 64))) != 0) {
+            event.events |= EPOLL_IN;
+        }
+        if ((writes[i / 64] & (1UL << (i % 64))) != 0) {
+            event.events |= EPOLL_OUT;
+        }
+        if (event.events != 0) {
+            VfsFileDescriptor* desc = getFileDescriptor(task->process, i);
+            if (desc == NULL) {
+                err = simpleError(EBADF);
             } else {
-                if (vfsFileIsReady(desc->file, task->process, false)) {
-                    num_ready++;
+                if (
+                    ((event.events & EPOLL_IN) != 0 && (desc->file->flags & VFS_FILE_READ) == 0)
+                    || ((event.events & EPOLL_OUT) != 0 && (desc->file->flags & VFS_FILE_WRITE) == 0)
+                ) {
+                    err = simpleError(EBADF);
                 } else {
-                    reads &= ~(1UL << i);
+                    // Files that can not block (e.g. regular files) are always ready
+                    err = epollControl(instance, EPOLL_CTL_ADD, i, desc->file, &event, true);
                 }
+                vfsFileDescriptorClose(task->process, desc);
             }
         }
-        if ((writes & (1 << i)) != 0) {
-            VfsFileDescriptor* desc = getFileDescriptorUnsafe(task->process, i);
-            if (desc == NULL || (desc->file->flags & VFS_FILE_WRITE) == 0) {
-                task->frame.regs[REG_ARGUMENT_0] = -EBADF;
-                return true;
+    }
+    size_t count = 0;
+    if (!isError(err)) {
+        Time timeout = SYSCALL_ARG(4);
+        if (timeout != (Time)-1) {
+            timeout /= 1000000000UL / CLOCKS_PER_SEC;
+        } else {
+            timeout = EPOLL_NO_TIMEOUT;
+        }
+        err = epollWait(instance, task->process, events, num_fds, timeout, &count);
+    }
+    freeEpollInstance(instance);
+    if (isError(err)) {
+        dealloc(reads);
+        dealloc(events);
+        SYSCALL_RETURN(-err.kind);
+    }
+    size_t num_ready = 0;
+    memset(reads, 0, 2 * words * sizeof(uint64_t));
+    for (size_t i = 0; i < count; i++) {
+        size_t fd = events[i].data;
+        if ((events[i].events & EPOLL_IN) != 0) {
+            reads[fd / 64] |= 1UL << (fd % 64);
+            num_ready++;
+        }
+        if ((events[i].events & EPOLL_OUT) != 0) {
+            writes[fd / 64] |= 1UL << (fd % 64);
+            num_ready++;
+        }
+    }
+    dealloc(events);
+    if (SYSCALL_ARG(1) != 0) {
+        err = copyToUser(mem, SYSCALL_ARG(1), reads, words * sizeof(uint64_t));
+    }
+    if (!isError(err) && SYSCALL_ARG(2) != 0) {
+        err = copyToUser(mem, SYSCALL_ARG(2), writes, words * sizeof(uint64_t));
+    }
+    if (!isError(err) && SYSCALL_ARG(3) != 0) {
+        // We never report exceptional conditions
+        memset(reads, 0, words * sizeof(uint64_t));
+        err = copyToUser(mem, SYSCALL_ARG(3), reads, words * sizeof(uint64_t));
+    }
+    dealloc(reads);
+    if (isError(err)) {
+        SYSCALL_RETURN(-err.kind);
+    } else {
+        SYSCALL_RETURN(num_ready);
+    }
+}
+
+SyscallReturn pollSyscall(TrapFrame* frame) {
+    assert(frame->hart != NULL);
+    Task* task = (Task*)frame;
+    assert(task->process != NULL);
+    size_t num_fds = SYSCALL_ARG(1);
+    if (num_fds > MAX_WAIT_FDS) {
+        SYSCALL_RETURN(-EINVAL);
+    }
+    PollFd* fds = kalloc(umax(num_fds, 1) * sizeof(PollFd));
+    EpollEvent* events = kalloc(umax(num_fds, 1) * sizeof(EpollEvent));
+    EpollInstance* instance = createEpollInstance();
+    if (fds == NULL || events == NULL || instance == NULL) {
+        dealloc(fds);
+        dealloc(events);
+        if (instance != NULL) {
+            freeEpollInstance(instance);
+        }
+        SYSCALL_RETURN(-ENOMEM);
+    }
+    size_t num_invalid = 0;
+    Error err = copyFromUser(task->process->memory.mem, fds, SYSCALL_ARG(0), num_fds * sizeof(PollFd));
+    for (size_t i = 0; i < num_fds && !isError(err); i++) {
+        fds[i].revents = 0;
+        if (fds[i].fd >= 0) {
+            VfsFileDescriptor* desc = getFileDescriptor(task->process, fds[i].fd);
+            if (desc == NULL) {
+                fds[i].revents = POLL_NVAL;
+                num_invalid++;
             } else {
-                if (vfsFileIsReady(desc->file, task->process, true)) {
-                    num_ready++;
-                } else {
-                    writes &= ~(1UL << i);
-                }
+                // The same fd may appear more than once, so the items are identified by index
+                EpollEvent event = { .events = fds[i].events & (EPOLL_IN | EPOLL_OUT), .data = i };
+                err = epollControl(instance, EPOLL_CTL_ADD, i, desc->file, &event, true);
+                vfsFileDescriptorClose(task->process, desc);
             }
         }
     }
-    if (num_ready != 0) {
-        writeInt(reads_ptr, 64, reads);
-        writeInt(writes_ptr, 64, writes);
-        writeInt(excepts_ptr, 64, 0);
-        task->frame.regs[REG_ARGUMENT_0] = num_ready;
-        return true;
+    size_t count = 0;
+    if (!isError(err)) {
+        // Invalid file descriptors are reported immediately
+        Time timeout = num_invalid != 0 ? 0 : timeoutFromMillis(SYSCALL_ARG(2));
+        err = epollWait(instance, task->process, events, num_fds, timeout, &count);
     }
-    Time timeout = SYSCALL_ARG(4);
-    if (timeout != (Time)-1 && getTime() >= task->times.entered + (timeout / (1000000000UL / CLOCKS_PER_SEC))) {
-        writeInt(reads_ptr, 64, 0);
-        writeInt(writes_ptr, 64, 0);
-        writeInt(excepts_ptr, 64, 0);
-        task->frame.regs[REG_ARGUMENT_0] = 0;
-        return true;
+    freeEpollInstance(instance);
+    if (!isError(err)) {
+        for (size_t i = 0; i < count; i++) {
+            fds[events[i].data].revents = events[i].events;
+        }
+        err = copyToUser(task->process->memory.mem, SYSCALL_ARG(0), fds, num_fds * sizeof(PollFd));
+    }
+    dealloc(fds);
+    dealloc(events);
+    if (isError(err)) {
+        SYSCALL_RETURN(-err.kind);
+    } else {
+        SYSCALL_RETURN(count + num_invalid);
     }
-    return false;
 }
 
-SyscallReturn selectSyscall(TrapFrame* frame) {
+SyscallReturn shmOpenSyscall(TrapFrame* frame) {
+    assert(frame->hart != NULL);
+    Task* task = (Task*)frame;
+    assert(task->process != NULL);
+    char* string = copyStringFromSyscallArgs(task, SYSCALL_ARG(0));
+    if (string != NULL) {
+        VfsFile* file;
+        VfsOpenFlags flags = convertOpenMode(SYSCALL_ARG(1));
+        Error err = shmOpen(task->process, string, flags, SYSCALL_ARG(2), &file);
+        dealloc(string);
+        if (isError(err)) {
+            SYSCALL_RETURN(-err.kind);
+        } else {
+            file->flags = flags & (VFS_OPEN_ACCESS_MODE | VFS_FILE_NONBLOCK);
+            int fd = putNewFileDescriptor(
+                task->process, -1, (flags & VFS_OPEN_CLOEXEC) != 0 ? VFS_DESC_CLOEXEC : 0, file, false
+            );
+            vfsFileClose(file);
+            SYSCALL_RETURN(fd);
+        }
+    } else {
+        SYSCALL_RETURN(-EINVAL);
+    }
+}
+
+SyscallReturn shmUnlinkSyscall(TrapFrame* frame) {
+    assert(frame->hart != NULL);
+    Task* task = (Task*)frame;
+    assert(task->process != NULL);
+    char* string = copyStringFromSyscallArgs(task, SYSCALL_ARG(0));
+    if (string != NULL) {
+        Error err = shmUnlink(task->process, string);
+        dealloc(string);
+        SYSCALL_RETURN(-err.kind);
+    } else {
+        SYSCALL_RETURN(-EINVAL);
+    }
+}
+
+SyscallReturn ringSetupSyscall(TrapFrame* frame) {
+    assert(frame->hart != NULL);
+    Task* task = (Task*)frame;
+    assert(task->process != NULL);
+    Error err = setupProcessRing(task->process, SYSCALL_ARG(0), SYSCALL_ARG(1), SYSCALL_ARG(2));
+    SYSCALL_RETURN(-err.kind);
+}
+
+SyscallReturn ringEnterSyscall(TrapFrame* frame) {
+    assert(frame->hart != NULL);
+    Task* task = (Task*)frame;
+    assert(task->process != NULL);
+    size_t submitted;
+    Error err = enterProcessRing(task->process, SYSCALL_ARG(0), &submitted);
+    if (isError(err)) {
+        SYSCALL_RETURN(-err.kind);
+    } else {
+        SYSCALL_RETURN(submitted);
+    }
+}
+
+SyscallReturn epollCreateSyscall(TrapFrame* frame) {
+    assert(frame->hart != NULL);
+    Task* task = (Task*)frame;
+    assert(task->process != NULL);
+    EpollInstance* instance = createEpollInstance();
+    if (instance == NULL) {
+        SYSCALL_RETURN(-ENOMEM);
+    }
+    VfsFile* file = createEpollFile(instance);
+    int fd = putNewFileDescriptor(
+        task->process, -1, (SYSCALL_ARG(0) & VFS_OPEN_CLOEXEC) != 0 ? VFS_DESC_CLOEXEC : 0, file, false
+    );
+    vfsFileClose(file);
+    SYSCALL_RETURN(fd);
+}
+
+SyscallReturn epollCtlSyscall(TrapFrame* frame) {
     assert(frame->hart != NULL);
     Task* task = (Task*)frame;
     assert(task->process != NULL);
-    Time timeout = SYSCALL_ARG(4);
-    lockSpinLock(&task->sched.lock); 
-    task->times.entered = getTime();
-    task->sched.wakeup_function = handleSelectWakeup;
-    unlockSpinLock(&task->sched.lock); 
-    if (timeout != (Time)-1) {
-        // Make sure we wake up in time
-        setTimeoutTime(getTime() + timeout / (1000000000UL / CLOCKS_PER_SEC), NULL, NULL);
+    int epfd = SYSCALL_ARG(0);
+    int op = SYSCALL_ARG(1);
+    int fd = SYSCALL_ARG(2);
+    EpollEvent event = { .events = 0, .data = 0 };
+    if (
+        op != EPOLL_CTL_DEL
+        && isError(copyFromUser(task->process->memory.mem, &event, SYSCALL_ARG(3), sizeof(EpollEvent)))
+    ) {
+        SYSCALL_RETURN(-EFAULT);
     }
-    return WAIT;
+    if (epfd == fd) {
+        SYSCALL_RETURN(-EINVAL);
+    }
+    VfsFileDescriptor* epoll_desc = getFileDescriptor(task->process, epfd);
+    if (epoll_desc == NULL) {
+        SYSCALL_RETURN(-EBADF);
+    }
+    EpollInstance* instance = getEpollInstance(epoll_desc->file);
+    VfsFileDescriptor* desc = getFileDescriptor(task->process, fd);
+    Error err;
+    if (instance == NULL) {
+        err = simpleError(EINVAL);
+    } else if (desc == NULL) {
+        err = simpleError(EBADF);
+    } else {
+        err = epollControl(instance, op, fd, desc->file, &event, false);
+    }
+    if (desc != NULL) {
+        vfsFileDescriptorClose(task->process, desc);
+    }
+    vfsFileDescriptorClose(task->process, epoll_desc);
+    SYSCALL_RETURN(-err.kind);
 }
 
+SyscallReturn epollWaitSyscall(TrapFrame* frame) {
+    assert(frame->hart != NULL);
+    Task* task = (Task*)frame;
+    assert(task->process != NULL);
+    int max = SYSCALL_ARG(2);
+    int timeout = SYSCALL_ARG(3);
+    if (max <= 0) {
+        SYSCALL_RETURN(-EINVAL);
+    }
+    // Returning fewer events than requested is fine, so do not allocate more than for select
+    max = umin(max, MAX_WAIT_FDS);
+    VfsFileDescriptor* desc = getFileDescriptor(task->process, SYSCALL_ARG(0));
+    if (desc == NULL) {
+        SYSCALL_RETURN(-EBADF);
+    }
+    EpollInstance* instance = getEpollInstance(desc->file);
+    if (instance == NULL) {
+        vfsFileDescriptorClose(task->process, desc);
+        SYSCALL_RETURN(-EINVAL);
+    }
+    EpollEvent* events = kalloc(max * sizeof(EpollEvent));
+    if (events == NULL) {
+        vfsFileDescriptorClose(task->process, desc);
+        SYSCALL_RETURN(-ENOMEM);
+    }
+    size_t count;
+    Error err = epollWait(instance, task->process, events, max, timeoutFromMillis(timeout), &count);
+    vfsFileDescriptorClose(task->process, desc);
+    if (!isError(err)) {
+        err = copyToUser(task->process->memory.mem, SYSCALL_ARG(1), events, count * sizeof(EpollEvent));
+    }
+    dealloc(events);
+    if (isError(err)) {
+        SYSCALL_RETURN(-err.kind);
+    } else {
+        SYSCALL_RETURN(count);
+    }
+}
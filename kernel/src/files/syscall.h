@@ -1,8 +1,12 @@
 #ifndef _FILES_SYSCALL_H_
 #define _FILES_SYSCALL_H_
 
+#include "files/vfs/types.h"
 #include "interrupt/syscall.h"
 
+// Convert the flags given to open into the VFS representation
+VfsOpenFlags convertOpenMode(VfsOpenFlags arg);
+
 SyscallReturn openSyscall(TrapFrame* frame);
 
 SyscallReturn linkSyscall(TrapFrame* frame);
@@ -53,4 +57,20 @@ SyscallReturn isattySyscall(TrapFrame* frame);
 
 SyscallReturn selectSyscall(TrapFrame* frame);
 
+SyscallReturn pollSyscall(TrapFrame* frame);
+
+SyscallReturn shmOpenSyscall(TrapFrame* frame);
+
+SyscallReturn shmUnlinkSyscall(TrapFrame* frame);
+
+SyscallReturn ringSetupSyscall(TrapFrame* frame);
+
+SyscallReturn ringEnterSyscall(TrapFrame* frame);
+
+SyscallReturn epollCreateSyscall(TrapFrame* frame);
+
+SyscallReturn epollCtlSyscall(TrapFrame* frame);
+
+SyscallReturn epollWaitSyscall(TrapFrame* frame);
+
 #endif
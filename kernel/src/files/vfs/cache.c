@@ -67,7 +67,8 @@ static bool continueSearch(VfsNodeCache* table, size_t idx, size_t sb_id, size_t
            || (isIndexValid(table, idx) && !vfsNodeCompareKey(table->nodes[idx], sb_id, node_id));
 }
 
-static size_t findIndexHashTable(VfsNodeCache* table, size_t sb_id, size_t node_id) {
+// If move is true, move the found entry into the first deleted slot. Only allowed for writers.
+static size_t findIndexHashTable(VfsNodeCache* table, size_t sb_id, size_t node_id, bool move) {
     if (table->count == 0) {
         return SIZE_MAX;
     }
@@ -86,7 +87,7 @@ static size_t findIndexHashTable(VfsNodeCache* table, size_t sb_id, size_t node_
     VfsNode* found = table->nodes[idx];
     if (found == DELETED || found == EMPTY) {
         return SIZE_MAX;
-    } else if (first_free != SIZE_MAX) {
+    } else if (move && first_free != SIZE_MAX) {
         table->nodes[first_free] = found;
         table->nodes[idx] = DELETED;
         return first_free;
@@ -96,12 +97,24 @@ static size_t findIndexHashTable(VfsNodeCache* table, size_t sb_id, size_t node_
 }
 
 VfsNode* vfsCacheGetNodeOrLock(VfsNodeCache* cache, size_t sb_id, size_t node_id) {
-    lockTaskLock(&cache->lock);
-    size_t idx = findIndexHashTable(cache, sb_id, node_id);
+    // Most lookups hit the cache, so we first search with only the read lock.
+    lockRwTaskLockRead(&cache->lock);
+    size_t idx = findIndexHashTable(cache, sb_id, node_id, false);
+    if (idx != SIZE_MAX) {
+        VfsNode* found = cache->nodes[idx];
+        // The node is in the cache, so the reference count can not go from zero to one here.
+        // Other readers might increment concurrently, but the count only decrements under the write lock.
+        __atomic_fetch_add(&found->ref_count, 1, __ATOMIC_RELAXED);
+        unlockRwTaskLockRead(&cache->lock);
+        return found;
+    }
+    unlockRwTaskLockRead(&cache->lock);
+    lockRwTaskLockWrite(&cache->lock);
+    idx = findIndexHashTable(cache, sb_id, node_id, true);
     if (idx != SIZE_MAX) {
         VfsNode* found = cache->nodes[idx];
         vfsNodeCopy(found);
-        unlockTaskLock(&cache->lock);
+        unlockRwTaskLockWrite(&cache->lock);
         return found;
     } else {
         return NULL;
@@ -117,33 +130,33 @@ static void vfsCacheInsertNewNode(VfsNodeCache* cache, VfsNode* node) {
 }
 
 void vfsCacheUnlock(VfsNodeCache* cache) {
-    unlockTaskLock(&cache->lock);
+    unlockRwTaskLockWrite(&cache->lock);
 }
 
 size_t vfsCacheCopyNode(VfsNodeCache* cache, VfsNode* node) {
-    lockTaskLock(&cache->lock);
+    lockRwTaskLockWrite(&cache->lock);
     if (node->ref_count == 0) {
         // This is a new node, add it to the cache.
         vfsCacheInsertNewNode(cache, node);
     }
     node->ref_count++;
     size_t refs = node->ref_count;
-    unlockTaskLock(&cache->lock);
+    unlockRwTaskLockWrite(&cache->lock);
     return refs;
 }
 
 size_t vfsCacheCloseNode(VfsNodeCache* cache, VfsNode* node) {
-    lockTaskLock(&cache->lock);
+    lockRwTaskLockWrite(&cache->lock);
     assert(node->ref_count > 0);
     node->ref_count--;
     if (node->ref_count == 0) {
-        size_t idx = findIndexHashTable(cache, node->superblock->id, node->stat.id);
+        size_t idx = findIndexHashTable(cache, node->superblock->id, node->stat.id, true);
         assert(idx != SIZE_MAX && cache->nodes[idx] == node);
         cache->nodes[idx] = DELETED;
         cache->count--;
     }
     size_t refs = node->ref_count;
-    unlockTaskLock(&cache->lock);
+    unlockRwTaskLockWrite(&cache->lock);
     return refs;
 }
 
@@ -151,7 +164,7 @@ void vfsCacheInit(VfsNodeCache* cache) {
     cache->count = 0;
     cache->capacity = 0;
     cache->nodes = NULL;
-    initTaskLock(&cache->lock);
+    initRwTaskLock(&cache->lock);
 }
 
 void vfsCacheDeinit(VfsNodeCache* cache) {
@@ -117,6 +117,10 @@ bool vfsFileIsReady(VfsFile* file, Process* process, bool write) {
     return vfsNodeIsReady(file->node, process, write);
 }
 
+struct PollQueue_s* vfsFilePollQueue(VfsFile* file) {
+    return vfsNodePollQueue(file->node);
+}
+
 void vfsFileCopy(VfsFile* file) {
     lockTaskLock(&file->ref_lock);
     file->ref_count++;
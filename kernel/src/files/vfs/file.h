@@ -28,6 +28,8 @@ Error vfsFileIoctl(VfsFile* file, Process* process, size_t request, VirtPtr argp
 
 bool vfsFileIsReady(VfsFile* file, Process* process, bool write);
 
+struct PollQueue_s* vfsFilePollQueue(VfsFile* file);
+
 void vfsFileCopy(VfsFile* file);
 
 void vfsFileClose(VfsFile* file);
@@ -121,6 +121,14 @@ bool vfsNodeIsReady(VfsNode* node, Process* process, bool write) {
     }
 }
 
+struct PollQueue_s* vfsNodePollQueue(VfsNode* node) {
+    if (node->functions->poll_queue == NULL) {
+        return NULL;
+    } else {
+        return node->functions->poll_queue(node);
+    }
+}
+
 void vfsNodeCopy(VfsNode* node) {
     vfsSuperCopyNode(node);
 }
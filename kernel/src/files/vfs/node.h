@@ -22,6 +22,9 @@ Error vfsNodeIoctl(VfsNode* node, Process* process, size_t request, VirtPtr argp
 
 bool vfsNodeIsReady(VfsNode* node, Process* process, bool write);
 
+// Returns NULL if the node does not support waiting for readiness
+struct PollQueue_s* vfsNodePollQueue(VfsNode* node);
+
 void vfsNodeCopy(VfsNode* node);
 
 void vfsNodeClose(VfsNode* node);
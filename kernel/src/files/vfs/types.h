@@ -8,6 +8,7 @@
 #include "error/error.h"
 #include "interrupt/timer.h"
 #include "memory/virtptr.h"
+#include "task/rwtasklock.h"
 #include "task/tasklock.h"
 
 typedef enum {
@@ -152,7 +153,7 @@ typedef struct {
     struct VfsNode_s** nodes;
     size_t count;
     size_t capacity;
-    TaskLock lock;
+    RwTaskLock lock;
 } VfsNodeCache;
 
 typedef struct VfsSuperblock_s {
@@ -175,6 +176,7 @@ typedef Error (*VfsNodeUnlinkFunction)(struct VfsNode_s* node, const char* name)
 typedef Error (*VfsNodeLinkFunction)(struct VfsNode_s* node, const char* name, struct VfsNode_s* entry);
 typedef Error (*VfsNodeIoctlFunction)(struct VfsNode_s* node, size_t request, VirtPtr argp, uintptr_t* out);
 typedef bool (*VfsNodeWillBlockFunction)(struct VfsNode_s* node, bool write);
+typedef struct PollQueue_s* (*VfsNodePollQueueFunction)(struct VfsNode_s* node);
 
 typedef struct {
     VfsNodeFreeFunction free;               // Free all information for the vfs node.
@@ -187,6 +189,7 @@ typedef struct {
     VfsNodeLinkFunction link;               // If this is a directory, add entry at name (overwrite if same entry exists already).
     VfsNodeIoctlFunction ioctl;
     VfsNodeWillBlockFunction is_ready;
+    VfsNodePollQueueFunction poll_queue;    // If the node can block, the queue notified when is_ready might change.
 } VfsNodeFunctions;
 
 typedef struct VfsNode_s {
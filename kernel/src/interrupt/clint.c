@@ -8,6 +8,11 @@
 #include "task/harts.h"
 
 static uintptr_t clint_base_addr;
+static bool has_sstc = false;
+
+void enableSupervisorTimer();
+
+void writeStimecmp(Time time);
 
 void sendMachineSoftwareInterrupt(int hart) {
     *(volatile uint32_t*)(clint_base_addr + hart * 0x4) = ~0;
@@ -18,13 +23,71 @@ void clearMachineSoftwareInterrupt(int hart) {
 }
 
 void setTimeCmp(Time time) {
-    *(volatile Time*)(clint_base_addr + 0x4000 + 8 * getCurrentHartId()) = time;
+    if (has_sstc) {
+        writeStimecmp(time);
+    } else {
+        *(volatile Time*)(clint_base_addr + 0x4000 + 8 * getCurrentHartId()) = time;
+    }
+}
+
+void initHartTimer() {
+    if (has_sstc) {
+        // The machine timer is no longer used, make sure it does not fire
+        *(volatile Time*)(clint_base_addr + 0x4000 + 8 * getCurrentHartId()) = UINT64_MAX;
+        writeStimecmp(UINT64_MAX);
+        enableSupervisorTimer();
+    }
 }
 
 Time getTime() {
     return *(volatile Time*)(clint_base_addr + 0xbff8);
 }
 
+static bool hasIsaExtension(DeviceTreeNode* cpu, const char* ext) {
+    DeviceTreeProperty* exts = findNodeProperty(cpu, "riscv,isa-extensions");
+    if (exts != NULL) {
+        for (size_t i = 0;; i++) {
+            const char* name = readPropertyString(exts, i);
+            if (name == NULL) {
+                return false;
+            } else if (strcmp(name, ext) == 0) {
+                return true;
+            }
+        }
+    }
+    // Multi-letter extensions are separated by underscores, e.g. rv64imafdc_zicsr_sstc
+    const char* isa = readPropertyStringOrDefault(findNodeProperty(cpu, "riscv,isa"), 0, "");
+    size_t len = strlen(ext);
+    const char* pos = strstr(isa, "_");
+    while (pos != NULL) {
+        pos++;
+        if (strncmp(pos, ext, len) == 0 && (pos[len] == '_' || pos[len] == 0)) {
+            return true;
+        }
+        pos = strstr(pos, "_");
+    }
+    return false;
+}
+
+// Sstc can only be used if all harts support it
+static bool checkSstcSupport() {
+    DeviceTreeNode* cpus = findNodeAtPath("/cpus");
+    if (cpus == NULL) {
+        return false;
+    }
+    bool found = false;
+    for (size_t i = 0; i < cpus->node_count; i++) {
+        DeviceTreeNode* cpu = &cpus->nodes[i];
+        if (strncmp(cpu->name, "cpu@", 4) == 0) {
+            if (!hasIsaExtension(cpu, "sstc")) {
+                return false;
+            }
+            found = true;
+        }
+    }
+    return found;
+}
+
 static bool checkDeviceCompatibility(const char* name) {
     return strstr(name, "clint") != NULL;
 }
@@ -35,6 +98,7 @@ static Error initDeviceFor(DeviceTreeNode* node) {
         return simpleError(ENXIO);
     }
     clint_base_addr = readPropertyU64(reg, 0);
+    has_sstc = checkSstcSupport();
     return simpleError(SUCCESS);
 }
 
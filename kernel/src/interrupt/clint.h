@@ -10,8 +10,12 @@ void clearMachineSoftwareInterrupt(int hart);
 
 Time getTime();
 
+// Uses the stimecmp CSR of the Sstc extension if all harts support it, otherwise the CLINT
 void setTimeCmp(Time time);
 
+// Enable the supervisor timer for the executing hart, if it is used
+void initHartTimer();
+
 Error registerDriverClint();
 
 #endif
@@ -16,6 +16,8 @@ static UnsafeLock message_write_lock;
 static UnsafeLock message_read_lock;
 static MessageType message_type;
 static void* message_data;
+// Hart the message is meant for. Software interrupts are also raised without a message.
+static int message_target = -1;
 
 void sendMessageTo(int hartid, MessageType type, void* data) {
     Task* task = criticalEnter();
@@ -23,6 +25,7 @@ void sendMessageTo(int hartid, MessageType type, void* data) {
     message_type = type;
     message_data = data;
     lockUnsafeLock(&message_read_lock);
+    __atomic_store_n(&message_target, hartid, __ATOMIC_SEQ_CST);
     sendMachineSoftwareInterrupt(hartid);
     // Wait for the receiver to unlock the read lock
     lockUnsafeLock(&message_read_lock);
@@ -32,6 +35,13 @@ void sendMessageTo(int hartid, MessageType type, void* data) {
     criticalReturn(task);
 }
 
+void requestReschedule(HartFrame* hart) {
+    // Only raise the interrupt if the hart has not been asked already
+    if (!__atomic_exchange_n(&hart->need_resched, true, __ATOMIC_SEQ_CST)) {
+        sendMachineSoftwareInterrupt(hart->hartid);
+    }
+}
+
 void sendMessageToAll(MessageType type, void* data) {
     int hartid = getCurrentHartId();
     for (int i = 0; i < hart_count; i++) {
@@ -50,9 +60,10 @@ void handleMessage(MessageType type, void* data) {
         unlockUnsafeLock(&message_read_lock);
         initHart(getCurrentHartId());
         runNextTask();
-    } else if (type == NONE || type == YIELD_TASK) {
+    } else if (type == NONE || type == YIELD_TASK || type == FLUSH_TLB) {
         unlockUnsafeLock(&message_read_lock);
-        // Do nothing, the point was to preempt the running process
+        // Do nothing, the point was to preempt the running process. Returning from the trap will
+        // also flush the TLB.
     } else if (type == KERNEL_PANIC) {
         unlockUnsafeLock(&message_read_lock);
         silentPanic();
@@ -64,6 +75,14 @@ void handleMessage(MessageType type, void* data) {
 void handleMachineSoftwareInterrupt() {
     int hartid = getCurrentHartId();
     clearMachineSoftwareInterrupt(hartid);
-    handleMessage(message_type, message_data);
+    HartFrame* hart = getCurrentHartFrame();
+    if (hart != NULL) {
+        // Returning from the trap will select the next task
+        __atomic_store_n(&hart->need_resched, false, __ATOMIC_SEQ_CST);
+    }
+    if (__atomic_load_n(&message_target, __ATOMIC_SEQ_CST) == hartid) {
+        __atomic_store_n(&message_target, -1, __ATOMIC_SEQ_CST);
+        handleMessage(message_type, message_data);
+    }
 }
 
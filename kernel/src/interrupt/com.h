@@ -2,16 +2,21 @@
 #define _INT_COM_H_
 
 #include "interrupt/clint.h"
+#include "task/types.h"
 
 typedef enum {
     NONE,
     INITIALIZE_HARTS,
     KERNEL_PANIC,
     YIELD_TASK,
+    FLUSH_TLB,
 } MessageType;
 
 void sendMessageTo(int hartid, MessageType type, void* data);
 
+// Preempt the task running on the hart. Unlike the messages, this does not wait for the hart.
+void requestReschedule(HartFrame* hart);
+
 void sendMessageToAll(MessageType type, void* data);
 
 void sendMessageToSelf(MessageType type, void* data);
@@ -0,0 +1,52 @@
+
+#include "interrupt/deferred.h"
+
+#include "interrupt/plic.h"
+#include "task/harts.h"
+
+// Number of work items to run before checking for other interrupts
+#define DEFERRED_WORK_BATCH 4
+
+void initDeferredWork(DeferredWork* work, DeferredFunction function, void* udata) {
+    work->next = NULL;
+    work->function = function;
+    work->udata = udata;
+    work->queued = false;
+}
+
+void queueDeferredWork(DeferredWork* work) {
+    // Another hart might be queuing the same work at the same time
+    if (!__atomic_exchange_n(&work->queued, true, __ATOMIC_ACQ_REL)) {
+        HartFrame* hart = getCurrentHartFrame();
+        // Interrupts are disabled, so only this hart can change its list
+        work->next = NULL;
+        if (hart->deferred_tail == NULL) {
+            hart->deferred = work;
+        } else {
+            hart->deferred_tail->next = work;
+        }
+        hart->deferred_tail = work;
+    }
+}
+
+void runDeferredWork() {
+    HartFrame* hart = getCurrentHartFrame();
+    // Only run the work queued so far. Work queued while running, including work that requeues
+    // itself, is left for the next call, so that the hart returns to a task in between.
+    DeferredWork* work = hart->deferred;
+    hart->deferred = NULL;
+    hart->deferred_tail = NULL;
+    size_t count = 0;
+    while (work != NULL) {
+        if (count != 0 && count % DEFERRED_WORK_BATCH == 0) {
+            // This may queue more work for the next call
+            handleExternalInterrupt();
+        }
+        DeferredWork* next = work->next;
+        // Work queued again from now on must run again
+        __atomic_store_n(&work->queued, false, __ATOMIC_RELEASE);
+        work->function(work->udata);
+        work = next;
+        count++;
+    }
+}
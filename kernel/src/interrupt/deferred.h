@@ -0,0 +1,29 @@
+#ifndef _DEFERRED_H_
+#define _DEFERRED_H_
+
+#include <stdbool.h>
+
+// Interrupt handlers should only acknowledge the device and queue deferred work for the rest. The
+// deferred work of a hart runs in the hart context right before returning to a task, between
+// batches other pending interrupts are handled.
+
+typedef void (*DeferredFunction)(void* udata);
+
+typedef struct DeferredWork_s {
+    struct DeferredWork_s* next;
+    DeferredFunction function;
+    void* udata;
+    bool queued;
+} DeferredWork;
+
+void initDeferredWork(DeferredWork* work, DeferredFunction function, void* udata);
+
+// Queue the work on the executing hart, unless it is already queued. Must be called in a trap or
+// hart context. The function may run on multiple harts at the same time.
+void queueDeferredWork(DeferredWork* work);
+
+// Run the deferred work queued on the executing hart. Work queued in the meantime runs on the
+// next call, the preemption timer makes sure it comes soon.
+void runDeferredWork();
+
+#endif
@@ -9,9 +9,14 @@
 #include "interrupt/com.h"
 #include "interrupt/plic.h"
 #include "interrupt/trap.h"
+#include "memory/kstack.h"
+#include "memory/usercopy.h"
 #include "memory/virtmem.h"
 #include "process/signals.h"
+#include "task/profile.h"
+#include "task/schedtrace.h"
 #include "task/schedule.h"
+#include "task/task.h"
 #include "task/types.h"
 #include "util/random.h"
 
@@ -55,6 +60,7 @@ void machineTrap(uintptr_t cause, uintptr_t pc, uintptr_t val, uintptr_t scratch
     int code = (uintptr_t)cause & 0xff;
     if (interrupt && (code == 0 || code == 1 || code == 3)) {
         handleMachineSoftwareInterrupt();
+        return;
     }
     KERNEL_REMOTE_ERROR(pc, "Unhandled machine trap: %p %p %p %s", pc, val, scratch, getCauseString(interrupt, code));
     panic();
@@ -71,11 +77,15 @@ void kernelTrap(uintptr_t cause, uintptr_t pc, uintptr_t val, TrapFrame* frame)
     } else {
         Task* task = (Task*)frame;
         if (frame->hart != NULL) {
-            addRandomEvent(NULL, 0);
+            addRandomSample(cause);
             Time elapsed = getTime() - task->times.entered;
             task->times.user_time += elapsed;
             task->times.entered = getTime();
-            task->sched.run_for += elapsed;
+            chargeTaskRuntime(task, elapsed);
+            frame->hart->running = NULL;
+            traceSchedEvent(SCHED_TRACE_SWITCH_OUT, task, 0);
+            // Counted as an involuntary switch only if another task runs before it is entered again
+            task->sched.interrupted = interrupt;
             moveTaskToState(task, ENQUABLE);
 #ifdef DEBUG_LOG_EXECUTION_TIMES
             if (task != frame->hart->idle_task) {
@@ -103,6 +113,7 @@ void kernelTrap(uintptr_t cause, uintptr_t pc, uintptr_t val, TrapFrame* frame)
                 case 4: // Timer interrupt U-mode
                 case 5: // Timer interrupt S-mode
                 case 7: // Timer interrupt M-mode
+                    profileTimerInterrupt(frame, pc);
                     handleTimerInterrupt();
                     break;
                 case 8: // External interrupt U-mode
@@ -114,6 +125,8 @@ void kernelTrap(uintptr_t cause, uintptr_t pc, uintptr_t val, TrapFrame* frame)
                     KERNEL_WARNING("Unhandled interrupt: %p %p %p %s", pc, val, frame, getCauseString(interrupt, code));
                     break;
             }
+        } else if (frame->hart == NULL && applyExceptionFixup(frame, val)) {
+            // Fault during an access to user memory. Continue at the fixup.
         } else {
             switch (code) {
                 case 8: // Environment call from U-mode
@@ -127,12 +140,24 @@ void kernelTrap(uintptr_t cause, uintptr_t pc, uintptr_t val, TrapFrame* frame)
                 case 13: // Load page fault
                 case 15: // Store/AMO page fault
                     if (frame->hart == NULL || task->process == NULL) {
-                        if (!handlePageFault(kernel_page_table, val)) {
+                        if (frame->hart != NULL && hasGuardedKernelStack(task) && isInKernelStackGuard(task->stack, val)) {
+                            KERNEL_REMOTE_ERROR(
+                                pc, "Kernel stack overflow in task %s (%p): %p %p",
+                                task->name != NULL ? task->name : "unnamed", task, pc, val
+                            );
+                            panic();
+                        } else if (!handlePageFault(kernel_page_table, val)) {
                             KERNEL_REMOTE_ERROR(pc, "Unhandled exception: %p %p %p %s", pc, val, frame, getCauseString(interrupt, code));
                             panic();
                         }
                     } else {
-                        if (!handlePageFault(task->process->memory.mem, val)) {
+                        int bits = code == 12 ? PAGE_ENTRY_EXEC : (code == 13 ? PAGE_ENTRY_READ : PAGE_ENTRY_WRITE);
+                        if (
+                            handlePageFault(task->process->memory.mem, val)
+                            || isSpuriousPageFault(task->process->memory.mem, val, bits)
+                        ) {
+                            task->usage.minor_faults++;
+                        } else {
                             KERNEL_WARNING("Segmentation fault: %i %p %p %p %s", task->process->pid, pc, val, frame, getCauseString(interrupt, code));
                             addSignalToProcess(task->process, SIGSEGV, 0);
                         }
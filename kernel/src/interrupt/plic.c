@@ -1,4 +1,3 @@
-
 #include <assert.h>
 #include <stddef.h>
 #include <stdbool.h>
@@ -9,119 +8,291 @@
 #include "devices/driver.h"
 #include "error/log.h"
 #include "memory/kalloc.h"
+#include "task/harts.h"
+#include "task/schedule.h"
 #include "task/syscall.h"
 
-typedef struct InterruptEntry_s {
-    struct InterruptEntry_s* next;
-    ExternalInterrupt id;
+typedef struct InterruptHandler_s {
+    struct InterruptHandler_s* next;
+    struct InterruptHandler_s* removed_next; // Handlers might still follow next after removal
     ExternalInterruptFunction function;
     void* udata;
+} InterruptHandler;
+
+typedef struct {
+    InterruptHandler* handlers; // Read without the lock by the trap handler
+    size_t active;              // Number of harts currently running the handlers
+    HartMask affinity;
+    uint64_t counts[MAX_HART_COUNT];
 } InterruptEntry;
 
 static uintptr_t plic_base_addr;
 static SpinLock plic_lock;
-static InterruptEntry* interrupts = NULL;
+static InterruptEntry* interrupts[MAX_INTERRUPTS];
+static uint64_t spurious_counts[MAX_HART_COUNT];
+// Context of the M-mode external interrupt for each hart, or -1 if it has none
+static int hart_contexts[MAX_HART_COUNT];
+
+static int contextForHart(int hartid) {
+    return hartid >= 0 && hartid < MAX_HART_COUNT ? hart_contexts[hartid] : -1;
+}
+
+static volatile uint32_t* enableRegister(int context, ExternalInterrupt id) {
+    return (volatile uint32_t*)(plic_base_addr + 0x2000 + 0x80 * context + 4 * (id / 32));
+}
+
+static volatile uint32_t* thresholdRegister(int context) {
+    return (volatile uint32_t*)(plic_base_addr + 0x200000 + 0x1000 * context);
+}
+
+static volatile ExternalInterrupt* claimRegister(int context) {
+    return (volatile ExternalInterrupt*)(plic_base_addr + 0x200004 + 0x1000 * context);
+}
 
 void handleExternalInterrupt() {
+    int hartid = getCurrentHartId();
+    if (contextForHart(hartid) < 0) {
+        return;
+    }
     ExternalInterrupt interrupt = nextInterrupt();
     while (interrupt != 0) {
-        lockSpinLock(&plic_lock);
-        size_t interrupt_count = 0;
-        InterruptEntry* current = interrupts;
-        while (current != NULL) {
-            if (current->id == interrupt) {
-                interrupt_count++;
+        InterruptEntry* entry = interrupt < MAX_INTERRUPTS ? __atomic_load_n(&interrupts[interrupt], __ATOMIC_ACQUIRE) : NULL;
+        if (entry != NULL) {
+            // The counter and handler list form a store-load handshake with clearInterruptFunction,
+            // which needs sequential consistency on both sides.
+            __atomic_fetch_add(&entry->active, 1, __ATOMIC_SEQ_CST);
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            InterruptHandler* current = __atomic_load_n(&entry->handlers, __ATOMIC_ACQUIRE);
+            while (current != NULL) {
+                current->function(interrupt, current->udata);
+                current = current->next;
             }
-            current = current->next;
-        }
-        InterruptEntry* interrupts_to_run[interrupt_count];
-        interrupt_count = 0;
-        current = interrupts;
-        while (current != NULL) {
-            if (current->id == interrupt) {
-                interrupts_to_run[interrupt_count] = current;
-                interrupt_count++;
-            }
-            current = current->next;
-        }
-        unlockSpinLock(&plic_lock);
-        for (size_t i = 0; i < interrupt_count; i++) {
-            interrupts_to_run[i]->function(interrupt, interrupts_to_run[i]->udata);
+            __atomic_fetch_sub(&entry->active, 1, __ATOMIC_RELEASE);
+            entry->counts[hartid]++;
+        } else {
+            spurious_counts[hartid]++;
         }
         completeInterrupt(interrupt);
         interrupt = nextInterrupt();
     }
 }
 
+// Spread interrupts over the harts that are not isolated
+static HartMask defaultAffinityFor(ExternalInterrupt id) {
+    HartMask harts = getOnlineHarts() & getDefaultAffinity();
+    if (harts == 0) {
+        return (HartMask)1 << getCurrentHartId();
+    }
+    size_t skip = id % __builtin_popcountll(harts);
+    for (size_t i = 0; i < skip; i++) {
+        harts &= harts - 1;
+    }
+    return harts & -harts;
+}
+
+// Must be called with the plic_lock held
+static void writeInterruptAffinity(ExternalInterrupt id, HartMask mask) {
+    uint32_t bit_value = 1 << (id % 32);
+    for (int i = 0; i < MAX_HART_COUNT; i++) {
+        int context = hart_contexts[i];
+        if (context >= 0) {
+            volatile uint32_t* address = enableRegister(context, id);
+            if ((mask & ((HartMask)1 << i)) != 0) {
+                *address = *address | bit_value;
+            } else {
+                *address = *address & ~bit_value;
+            }
+        }
+    }
+}
+
 void setInterruptFunction(ExternalInterrupt id, ExternalInterruptFunction function, void* udata) {
-    InterruptEntry* entry = kalloc(sizeof(InterruptEntry));
-    assert(entry != NULL);
-    entry->id = id;
-    entry->function = function;
-    entry->udata = udata;
+    assert(id != 0 && id < MAX_INTERRUPTS);
+    InterruptHandler* handler = kalloc(sizeof(InterruptHandler));
+    assert(handler != NULL);
+    handler->function = function;
+    handler->udata = udata;
     lockSpinLock(&plic_lock);
-    entry->next = interrupts;
-    interrupts = entry; 
+    InterruptEntry* entry = interrupts[id];
+    if (entry == NULL) {
+        entry = zalloc(sizeof(InterruptEntry));
+        assert(entry != NULL);
+        entry->affinity = defaultAffinityFor(id);
+        __atomic_store_n(&interrupts[id], entry, __ATOMIC_RELEASE);
+    }
+    handler->next = entry->handlers;
+    __atomic_store_n(&entry->handlers, handler, __ATOMIC_RELEASE);
+    writeInterruptAffinity(id, entry->affinity);
     unlockSpinLock(&plic_lock);
-    enableInterrupt(id);
 }
 
 void clearInterruptFunction(ExternalInterrupt id, ExternalInterruptFunction function, void* udata) {
-    bool interrupt_used = false;
+    assert(id != 0 && id < MAX_INTERRUPTS);
+    InterruptHandler* removed = NULL;
     lockSpinLock(&plic_lock);
-    InterruptEntry** current = &interrupts;
-    while (*current != NULL) {
-        if ((*current)->id == id && (*current)->function == function && (*current)->udata == udata) {
-            InterruptEntry* to_remove = *current;
-            *current = to_remove->next;
-            dealloc(to_remove);
-        } else {
-            if ((*current)->id == id) {
-                interrupt_used = true;
+    InterruptEntry* entry = interrupts[id];
+    if (entry != NULL) {
+        InterruptHandler** current = &entry->handlers;
+        while (*current != NULL) {
+            if ((*current)->function == function && (*current)->udata == udata) {
+                InterruptHandler* to_remove = *current;
+                __atomic_store_n(current, to_remove->next, __ATOMIC_RELEASE);
+                to_remove->removed_next = removed;
+                removed = to_remove;
+            } else {
+                current = &(*current)->next;
             }
-            current = &(*current)->next;
         }
+        if (entry->handlers == NULL) {
+            writeInterruptAffinity(id, 0);
+        }
+    }
+    unlockSpinLock(&plic_lock);
+    if (removed != NULL) {
+        // Another hart might still be running the removed handlers. The entry itself is never freed.
+        // Note that this must therefore not be called from inside of the interrupt handler.
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&entry->active, __ATOMIC_ACQUIRE) != 0) {
+            // Wait for the other harts
+        }
+        while (removed != NULL) {
+            InterruptHandler* next = removed->removed_next;
+            dealloc(removed);
+            removed = next;
+        }
+    }
+}
+
+Error setInterruptAffinity(ExternalInterrupt id, HartMask mask) {
+    HartMask available = 0;
+    for (int i = 0; i < MAX_HART_COUNT; i++) {
+        if (hart_contexts[i] >= 0) {
+            available |= (HartMask)1 << i;
+        }
+    }
+    mask &= available & getOnlineHarts();
+    if (id == 0 || id >= MAX_INTERRUPTS || mask == 0) {
+        return simpleError(EINVAL);
+    }
+    lockSpinLock(&plic_lock);
+    InterruptEntry* entry = interrupts[id];
+    if (entry == NULL) {
+        unlockSpinLock(&plic_lock);
+        return simpleError(ENOENT);
+    }
+    entry->affinity = mask;
+    if (entry->handlers != NULL) {
+        writeInterruptAffinity(id, mask);
     }
     unlockSpinLock(&plic_lock);
-    if (!interrupt_used) {
-        disableInterrupt(id);
+    return simpleError(SUCCESS);
+}
+
+size_t getInterruptStats(InterruptStats* stats, size_t max) {
+    size_t count = 0;
+    for (ExternalInterrupt i = 1; i < MAX_INTERRUPTS && count < max; i++) {
+        InterruptEntry* entry = __atomic_load_n(&interrupts[i], __ATOMIC_ACQUIRE);
+        if (entry != NULL) {
+            stats[count].id = i;
+            stats[count].affinity = entry->affinity;
+            memcpy(stats[count].counts, entry->counts, sizeof(entry->counts));
+            count++;
+        }
     }
+    return count;
+}
+
+void getSpuriousInterruptCounts(uint64_t counts[MAX_HART_COUNT]) {
+    memcpy(counts, spurious_counts, sizeof(spurious_counts));
 }
 
 void enableInterrupt(ExternalInterrupt id) {
-    uint32_t offset = id / 32;
-    uint32_t bit_value = 1 << (id % 32);
-    volatile uint32_t* address = (volatile uint32_t*)(plic_base_addr + 0x2000 + offset);
-    *address = *address | bit_value;
+    lockSpinLock(&plic_lock);
+    InterruptEntry* entry = id < MAX_INTERRUPTS ? interrupts[id] : NULL;
+    writeInterruptAffinity(id, entry != NULL ? entry->affinity : defaultAffinityFor(id));
+    unlockSpinLock(&plic_lock);
 }
 
 void disableInterrupt(ExternalInterrupt id) {
-    uint32_t offset = id / 32;
-    uint32_t bit_value = 1 << (id % 32);
-    volatile uint32_t* address = (volatile uint32_t*)(plic_base_addr + 0x2000 + offset);
-    *address = *address & ~bit_value;
+    lockSpinLock(&plic_lock);
+    writeInterruptAffinity(id, 0);
+    unlockSpinLock(&plic_lock);
 }
 
 void setInterruptPriority(ExternalInterrupt id, InterruptPriority priority) {
-    priority &= 0x111; // Maximum priority is 7
+    priority &= 0b111; // Maximum priority is 7
     *((volatile uint32_t*)plic_base_addr + id) = priority;
 }
 
 void setPlicPriorityThreshold(InterruptPriority priority) {
-    priority &= 0x111; // Maximum priority is 7
-    *(volatile uint32_t*)(plic_base_addr + 0x200000) = priority;
+    priority &= 0b111; // Maximum priority is 7
+    int context = contextForHart(getCurrentHartId());
+    if (context >= 0) {
+        *thresholdRegister(context) = priority;
+    }
 }
 
 ExternalInterrupt nextInterrupt() {
-    return *(volatile ExternalInterrupt*)(plic_base_addr + 0x200004);
+    int context = contextForHart(getCurrentHartId());
+    if (context < 0) {
+        return 0;
+    }
+    return *claimRegister(context);
 }
 
 void completeInterrupt(ExternalInterrupt id) {
-    *(volatile ExternalInterrupt*)(plic_base_addr + 0x200004) = id;
+    int context = contextForHart(getCurrentHartId());
+    if (context >= 0) {
+        *claimRegister(context) = id;
+    }
+}
+
+static int hartForInterruptController(uint32_t phandle) {
+    DeviceTreeNode* cpus = findNodeAtPath("/cpus");
+    if (cpus != NULL) {
+        for (size_t i = 0; i < cpus->node_count; i++) {
+            DeviceTreeNode* cpu = &cpus->nodes[i];
+            for (size_t j = 0; j < cpu->node_count; j++) {
+                DeviceTreeNode* intc = &cpu->nodes[j];
+                if (readPropertyU32OrDefault(findNodeProperty(intc, "phandle"), 0, 0) == phandle) {
+                    return readPropertyU32OrDefault(findNodeProperty(cpu, "reg"), 0, -1);
+                }
+            }
+        }
+    }
+    return -1;
+}
+
+// Every hart has a context for each privilege level. We only use the M-mode contexts.
+static void findHartContexts(DeviceTreeNode* node) {
+    for (int i = 0; i < MAX_HART_COUNT; i++) {
+        hart_contexts[i] = -1;
+    }
+    DeviceTreeProperty* ints = findNodeProperty(node, "interrupts-extended");
+    if (ints != NULL) {
+        for (size_t i = 0; 2 * i + 1 < ints->len / 4; i++) {
+            int hartid = hartForInterruptController(readPropertyU32(ints, 2 * i));
+            if (hartid >= 0 && hartid < MAX_HART_COUNT && readPropertyU32(ints, 2 * i + 1) == 11) {
+                hart_contexts[hartid] = i;
+            }
+        }
+    } else {
+        // Use the layout of the QEMU virt board, but only for harts that exist
+        for (int i = 0; i < hart_count; i++) {
+            if (hart_ids[i] >= 0 && hart_ids[i] < MAX_HART_COUNT) {
+                hart_contexts[hart_ids[i]] = 2 * hart_ids[i];
+            }
+        }
+    }
 }
 
 static Error initPlic() {
-    setPlicPriorityThreshold(0);
+    // Accept all interrupts on all harts, which ones are delivered is decided by the affinity
+    for (int i = 0; i < MAX_HART_COUNT; i++) {
+        if (hart_contexts[i] >= 0) {
+            *thresholdRegister(hart_contexts[i]) = 0;
+        }
+    }
     KERNEL_SUBSUCCESS("Initialized PLIC");
     return simpleError(SUCCESS);
 }
@@ -136,6 +307,7 @@ static Error initDeviceFor(DeviceTreeNode* node) {
         return simpleError(ENXIO);
     }
     plic_base_addr = readPropertyU64(reg, 0);
+    findHartContexts(node);
     initPlic();
     return simpleError(SUCCESS);
 }
@@ -4,23 +4,46 @@
 #include <stdint.h>
 
 #include "error/error.h"
+#include "task/harts.h"
+#include "task/types.h"
+
+// The PLIC supports interrupt ids from 1 to 1023
+#define MAX_INTERRUPTS 1024
 
 typedef uint8_t InterruptPriority;
 typedef uint32_t ExternalInterrupt;
 typedef void (*ExternalInterruptFunction)(ExternalInterrupt id, void* udata);
 
+typedef struct {
+    ExternalInterrupt id;
+    HartMask affinity;
+    uint64_t counts[MAX_HART_COUNT]; // Number of times the interrupt was handled by each hart
+} InterruptStats;
+
 void handleExternalInterrupt();
 
 void setInterruptFunction(ExternalInterrupt id, ExternalInterruptFunction function, void* udata);
 
+// Must not be called from inside an interrupt handler
 void clearInterruptFunction(ExternalInterrupt id, ExternalInterruptFunction function, void* udata);
 
+// Deliver the interrupt only to the given harts. The interrupt must have a function.
+Error setInterruptAffinity(ExternalInterrupt id, HartMask mask);
+
+// Fill stats with up to max interrupts that have ever had a function, returns the number filled
+size_t getInterruptStats(InterruptStats* stats, size_t max);
+
+// Number of claimed interrupts without a function for each hart
+void getSpuriousInterruptCounts(uint64_t counts[MAX_HART_COUNT]);
+
+// Enable the interrupt on the harts in its affinity
 void enableInterrupt(ExternalInterrupt id);
 
 void disableInterrupt(ExternalInterrupt id);
 
 void setInterruptPriority(ExternalInterrupt id, InterruptPriority priority);
 
+// Set the threshold of the executing hart
 void setPlicPriorityThreshold(InterruptPriority priority);
 
 ExternalInterrupt nextInterrupt();
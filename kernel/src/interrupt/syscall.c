@@ -11,8 +11,10 @@
 #include "loader/loader.h"
 #include "memory/kalloc.h"
 #include "memory/syscall.h"
+#include "memory/usercopy.h"
 #include "process/syscall.h"
 #include "task/harts.h"
+#include "task/schedtrace.h"
 #include "task/schedule.h"
 #include "task/syscall.h"
 #include "util/util.h"
@@ -80,6 +82,29 @@ SyscallFunction user_syscalls[] = {
     [SYSCALL_GETSID] = getSidSyscall,
     [SYSCALL_SET_NANOSECONDS] = setNanosecondsSyscall,
     [SYSCALL_SELECT] = selectSyscall,
+    [SYSCALL_MMAP] = mmapSyscall,
+    [SYSCALL_MUNMAP] = munmapSyscall,
+    [SYSCALL_SHM_OPEN] = shmOpenSyscall,
+    [SYSCALL_SHM_UNLINK] = shmUnlinkSyscall,
+    [SYSCALL_CLONE] = cloneSyscall,
+    [SYSCALL_GETTID] = gettidSyscall,
+    [SYSCALL_THREAD_EXIT] = threadExitSyscall,
+    [SYSCALL_THREAD_JOIN] = threadJoinSyscall,
+    [SYSCALL_FUTEX] = futexSyscall,
+    [SYSCALL_SCHED_SETSCHEDULER] = schedSetschedulerSyscall,
+    [SYSCALL_SCHED_GETSCHEDULER] = schedGetschedulerSyscall,
+    [SYSCALL_SETPRIORITY] = setPrioritySyscall,
+    [SYSCALL_GETPRIORITY] = getPrioritySyscall,
+    [SYSCALL_NICE] = niceSyscall,
+    [SYSCALL_SCHED_SETAFFINITY] = schedSetaffinitySyscall,
+    [SYSCALL_SCHED_GETAFFINITY] = schedGetaffinitySyscall,
+    [SYSCALL_GETRUSAGE] = getrusageSyscall,
+    [SYSCALL_RING_SETUP] = ringSetupSyscall,
+    [SYSCALL_RING_ENTER] = ringEnterSyscall,
+    [SYSCALL_EPOLL_CREATE] = epollCreateSyscall,
+    [SYSCALL_EPOLL_CTL] = epollCtlSyscall,
+    [SYSCALL_EPOLL_WAIT] = epollWaitSyscall,
+    [SYSCALL_POLL] = pollSyscall,
 };
 
 SyscallFunction kernel_syscalls[] = {
@@ -118,7 +143,7 @@ static const char* findSyscallName(Syscalls id) {
 #endif
 
 static bool isSyncSyscall(Syscalls id) {
-    return id == SYSCALL_CRITICAL;
+    return id == SYSCALL_CRITICAL || id == SYSCALL_FUTEX;
 }
 
 static void syscallTaskEnd(void* _, Task* task) {
@@ -136,6 +161,11 @@ static void syscallTask(SyscallFunction func, TrapFrame* frame) {
     assert(self != NULL); // Make sure we did not miss to call criticalReturn somewhere
     task->times.system_time += self->times.user_time + self->times.system_time;
     task->times.system_time += self->times.user_child_time + self->times.system_child_time;
+    // Faults, I/O and blocking done by the syscall are counted for the task, but not preemptions
+    task->usage.voluntary_switches += self->usage.voluntary_switches;
+    task->usage.minor_faults += self->usage.minor_faults;
+    task->usage.block_reads += self->usage.block_reads;
+    task->usage.block_writes += self->usage.block_writes;
     if (ret == CONTINUE) {
         awakenTask(task);
         enqueueTask(task);
@@ -171,7 +201,9 @@ void runSyscall(TrapFrame* frame, bool is_kernel) {
             Task* task = (Task*)frame;
             task->sched.wakeup_function = NULL;
             moveTaskToState(task, WAITING);
-            task->sys_task = createKernelTask(syscallTask, SYSCALL_STACK_SIZE, task->sched.priority);
+            traceSchedEvent(SCHED_TRACE_BLOCK, task, SCHED_TRACE_BLOCK_SYSCALL);
+            task->sys_task = createKernelTask(syscallTask, SYSCALL_STACK_SIZE, task->sched.priority, "syscall");
+            inheritSchedParams(task->sys_task, task);
             task->sys_task->frame.regs[REG_ARGUMENT_0] = (uintptr_t)func;
             task->sys_task->frame.regs[REG_ARGUMENT_1] = (uintptr_t)frame;
             task->sys_task->sys_task = task;
@@ -182,7 +214,37 @@ void runSyscall(TrapFrame* frame, bool is_kernel) {
     }
 }
 
+char* copyStringFromProcess(Process* process, uintptr_t ptr) {
+    size_t capacity = 64;
+    char* string = kalloc(capacity);
+    size_t length = 0;
+    while (string != NULL) {
+        size_t part_length;
+        Error err = strncpyFromUser(
+            process->memory.mem, string + length, ptr + length, capacity - length, &part_length
+        );
+        length += part_length;
+        if (err.kind == ENAMETOOLONG) {
+            capacity *= 2;
+            char* new_string = krealloc(string, capacity);
+            if (new_string == NULL) {
+                dealloc(string);
+            }
+            string = new_string;
+        } else if (isError(err)) {
+            dealloc(string);
+            return NULL;
+        } else {
+            return string;
+        }
+    }
+    return NULL;
+}
+
 char* copyStringFromSyscallArgs(Task* task, uintptr_t ptr) {
+    if (task->process != NULL) {
+        return copyStringFromProcess(task->process, ptr);
+    }
     VirtPtr str = virtPtrForTask(ptr, task);
     size_t length = strlenVirtPtr(str);
     char* string = kalloc(length + 1);
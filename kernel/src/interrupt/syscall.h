@@ -67,6 +67,29 @@ typedef enum {
     SYSCALL_GETPGID = 57,
     SYSCALL_SET_NANOSECONDS = 58,
     SYSCALL_SELECT = 59,
+    SYSCALL_MMAP = 60,
+    SYSCALL_MUNMAP = 61,
+    SYSCALL_SHM_OPEN = 62,
+    SYSCALL_SHM_UNLINK = 63,
+    SYSCALL_CLONE = 64,
+    SYSCALL_GETTID = 65,
+    SYSCALL_THREAD_EXIT = 66,
+    SYSCALL_THREAD_JOIN = 67,
+    SYSCALL_FUTEX = 68,
+    SYSCALL_SCHED_SETSCHEDULER = 69,
+    SYSCALL_SCHED_GETSCHEDULER = 70,
+    SYSCALL_SETPRIORITY = 71,
+    SYSCALL_GETPRIORITY = 72,
+    SYSCALL_NICE = 73,
+    SYSCALL_SCHED_SETAFFINITY = 74,
+    SYSCALL_SCHED_GETAFFINITY = 75,
+    SYSCALL_GETRUSAGE = 76,
+    SYSCALL_RING_SETUP = 77,
+    SYSCALL_RING_ENTER = 78,
+    SYSCALL_EPOLL_CREATE = 79,
+    SYSCALL_EPOLL_CTL = 80,
+    SYSCALL_EPOLL_WAIT = 81,
+    SYSCALL_POLL = 82,
 // Kernel only syscalls:
     SYSCALL_CRITICAL = 0 + KERNEL_ONLY_SYSCALL_OFFSET,
 } Syscalls;
@@ -89,4 +112,7 @@ void runSyscall(TrapFrame* frame, bool is_kernel);
 
 char* copyStringFromSyscallArgs(Task* task, uintptr_t ptr);
 
+// Copy a string from the memory of the user process
+char* copyStringFromProcess(Process* process, uintptr_t ptr);
+
 #endif
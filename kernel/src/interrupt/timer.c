@@ -9,6 +9,10 @@
 #include "memory/kalloc.h"
 #include "task/spinlock.h"
 #include "task/harts.h"
+#include "task/profile.h"
+#include "task/schedule.h"
+#include "task/syscall.h"
+#include "util/util.h"
 
 #ifdef DEBUG
 // This makes debugging simpler, but is in no way safe.
@@ -19,6 +23,9 @@
 
 #define MAX_IDLE_TIME CLOCKS_PER_SEC
 
+// Deferred work left for the next trap should not wait for the full time slice
+#define DEFERRED_WORK_DELAY (CLOCKS_PER_SEC / 1000)
+
 typedef struct TimeoutEntry_s {
     struct TimeoutEntry_s* next;
     Timeout id;
@@ -93,6 +100,16 @@ void handleTimerInterrupt() {
     }
 }
 
+void preemptCurrentHart() {
+    Task* task = criticalEnter();
+    HartFrame* hart = getCurrentHartFrame();
+    // Entering the next task sets the timer again
+    Time now = getTime();
+    setTimeCmp(now);
+    hart->timecmp = now;
+    criticalReturn(task);
+}
+
 Time setPreemptionTimer(Task* task) {
     Time time = getTime();
     Time next = UINT64_MAX;
@@ -105,11 +122,20 @@ Time setPreemptionTimer(Task* task) {
         current = current->next;
     }
     unlockSpinLock(&timeout_lock);
-    Time max = task->frame.hart->idle_task == task ? MAX_IDLE_TIME : MAX_TIME;
-    if (next < time + max) {
-        setTimeCmp(next);
-    } else {
-        setTimeCmp(time + max);
+    HartFrame* hart = task->frame.hart;
+    Time max = hart->idle_task == task ? MAX_IDLE_TIME : umin(MAX_TIME, getTaskTimeSlice(task));
+    if (__atomic_load_n(&profile_mode, __ATOMIC_RELAXED) != PROFILE_OFF) {
+        // Take samples even if nothing else needs the timer
+        max = umin(max, PROFILE_INTERVAL);
+    }
+    if (hart->deferred != NULL) {
+        max = umin(max, DEFERRED_WORK_DELAY);
+    }
+    Time deadline = umin(next, time + max);
+    // Writing the same deadline again would not change anything
+    if (deadline != hart->timecmp) {
+        setTimeCmp(deadline);
+        hart->timecmp = deadline;
     }
     return time;
 }
@@ -16,6 +16,9 @@ void handleTimerInterrupt();
 
 Time setPreemptionTimer(Task* task);
 
+// Make the timer of the executing hart fire as soon as possible, to preempt the running task
+void preemptCurrentHart();
+
 Timeout setTimeout(Time delay, TimeoutFunction function, void* udata);
 
 Timeout setTimeoutTime(Time time, TimeoutFunction function, void* udata);
@@ -8,14 +8,17 @@
 #include "devices/driver.h"
 #include "error/log.h"
 #include "files/vfs/fs.h"
+#include "interrupt/clint.h"
 #include "interrupt/com.h"
 #include "interrupt/plic.h"
 #include "interrupt/syscall.h"
 #include "interrupt/trap.h"
 #include "kernel/devtree.h"
 #include "kernel/time.h"
+#include "memory/kstack.h"
 #include "memory/pagealloc.h"
 #include "memory/virtmem.h"
+#include "process/infopage.h"
 #include "process/syscall.h"
 #include "task/harts.h"
 #include "task/schedule.h"
@@ -34,12 +37,14 @@
 Error initHart(int hartid) {
     setupHartFrame(hartid);
     initTraps();
+    initHartTimer();
     KERNEL_SUCCESS("Initialized hart %i", hartid);
     return simpleError(SUCCESS);
 }
 
 Error initPrimaryHart() {
     setupHartFrame(0);
+    initHartTimer();
     KERNEL_SUCCESS("Initialized hart 0");
     return simpleError(SUCCESS);
 }
@@ -59,11 +64,13 @@ void kernelInit(uint8_t* dtb) {
     KERNEL_INIT_TASK("Init stdout device", initStdoutDevice());
     // Initialize the rest of the kernel
     KERNEL_INIT_TASK("Init kernel virtual memory", initKernelVirtualMemory());
+    KERNEL_INIT_TASK("Init kernel stack pool", initKernelStackPool());
+    KERNEL_INIT_TASK("Init hart isolation", initHartIsolation());
     KERNEL_INIT_TASK("Init primary hart", initPrimaryHart());
     // Wake up the remaining harts
     sendMessageToAll(INITIALIZE_HARTS, NULL);
     // Enqueue main process to start the init process
-    enqueueTask(createKernelTask(kernelMain, HART_STACK_SIZE, DEFAULT_PRIORITY));
+    enqueueTask(createKernelTask(kernelMain, HART_STACK_SIZE, DEFAULT_PRIORITY, "kernel main"));
     // Start running the main process
     runNextTask();
 }
@@ -73,6 +80,8 @@ void kernelMain() {
     assert(getCurrentTask()->frame.hart != NULL);
     // Initialize devices
     KERNEL_INIT_TASK("Init devices", initDevices());
+    // Needs the rtc, must be done before loading any program
+    KERNEL_INIT_TASK("Init system info page", initSystemInfo());
     // Register filesystem drivers
     KERNEL_INIT_TASK("Register fs drivers", registerAllFilesystemDrivers());
     // Initialize virtual filesystem
@@ -1,11 +1,18 @@
 
 #include <assert.h>
+#include <string.h>
 
 #include "kernel/syscall.h"
 
 #include "kernel/time.h"
+#include "interrupt/timer.h"
+#include "memory/pagealloc.h"
+#include "memory/usercopy.h"
 #include "memory/virtptr.h"
+#include "process/infopage.h"
 #include "process/process.h"
+#include "task/task.h"
+#include "task/tasklock.h"
 
 typedef struct {
     size_t user_time;
@@ -31,11 +38,112 @@ SyscallReturn timesSyscall(TrapFrame* frame) {
     SYSCALL_RETURN(TIMES_CLOCK_SCALING(getTime()));
 }
 
+#define RUSAGE_SELF 0
+#define RUSAGE_CHILDREN -1
+#define RUSAGE_THREAD 1
+
+typedef struct {
+    int64_t tv_sec;
+    int64_t tv_usec;
+} RusageTime;
+
+// Same layout as struct rusage on Linux
+typedef struct {
+    RusageTime utime;
+    RusageTime stime;
+    long maxrss; // In kilobytes
+    long ixrss;
+    long idrss;
+    long isrss;
+    long minflt;
+    long majflt;
+    long nswap;
+    long inblock;
+    long oublock;
+    long msgsnd;
+    long msgrcv;
+    long nsignals;
+    long nvcsw;
+    long nivcsw;
+} RusageStruct;
+
+static RusageTime rusageTimeFor(Time time) {
+    RusageTime ret = {
+        .tv_sec = time / CLOCKS_PER_SEC,
+        .tv_usec = (time % CLOCKS_PER_SEC) / (CLOCKS_PER_SEC / 1000000),
+    };
+    return ret;
+}
+
+static void fillRusage(RusageStruct* rusage, Time user, Time system, TaskUsage* usage, size_t max_rss) {
+    memset(rusage, 0, sizeof(RusageStruct));
+    rusage->utime = rusageTimeFor(user);
+    rusage->stime = rusageTimeFor(system);
+    rusage->maxrss = max_rss * PAGE_SIZE / 1024;
+    rusage->minflt = usage->minor_faults;
+    rusage->majflt = 0; // No fault ever has to wait for I/O
+    rusage->inblock = usage->block_reads;
+    rusage->oublock = usage->block_writes;
+    rusage->nvcsw = usage->voluntary_switches;
+    rusage->nivcsw = usage->involuntary_switches;
+}
+
+SyscallReturn getrusageSyscall(TrapFrame* frame) {
+    assert(frame->hart != NULL);
+    Task* task = (Task*)frame;
+    assert(task->process != NULL);
+    Process* process = task->process;
+    int who = SYSCALL_ARG(0);
+    RusageStruct rusage;
+    if (who == RUSAGE_THREAD) {
+        fillRusage(&rusage, task->times.user_time, task->times.system_time, &task->usage, 0);
+    } else if (who == RUSAGE_SELF || who == RUSAGE_CHILDREN) {
+        size_t max_rss = 0;
+        if (who == RUSAGE_SELF) {
+            lockTaskLock(&process->memory.lock);
+            updateProcessMaxRss(process);
+            max_rss = process->memory.max_rss;
+            unlockTaskLock(&process->memory.lock);
+        }
+        lockSpinLock(&process->lock);
+        // Exited threads have already been added to the process
+        Time user = who == RUSAGE_SELF ? process->times.user_time : process->times.user_child_time;
+        Time system = who == RUSAGE_SELF ? process->times.system_time : process->times.system_child_time;
+        TaskUsage usage = who == RUSAGE_SELF ? process->usage : process->child_usage;
+        Task* current = process->tasks;
+        while (current != NULL) {
+            if (who == RUSAGE_SELF) {
+                user += current->times.user_time;
+                system += current->times.system_time;
+                addTaskUsage(&usage, &current->usage);
+            } else {
+                user += current->times.user_child_time;
+                system += current->times.system_child_time;
+                addTaskUsage(&usage, &current->child_usage);
+            }
+            current = current->proc_next;
+        }
+        if (who == RUSAGE_CHILDREN) {
+            max_rss = process->child_max_rss;
+        }
+        unlockSpinLock(&process->lock);
+        fillRusage(&rusage, user, system, &usage, max_rss);
+    } else {
+        SYSCALL_RETURN(-EINVAL);
+    }
+    if (isError(copyToUser(process->memory.mem, SYSCALL_ARG(1), &rusage, sizeof(RusageStruct)))) {
+        SYSCALL_RETURN(-EFAULT);
+    }
+    SYSCALL_RETURN(0);
+}
+
 SyscallReturn getNanosecondsSyscall(TrapFrame* frame) {
     SYSCALL_RETURN(getNanosecondsWithFallback());
 }
 
 SyscallReturn setNanosecondsSyscall(TrapFrame* frame) {
-    SYSCALL_RETURN(-setNanoseconds(SYSCALL_ARG(0)).kind);
+    Error error = setNanoseconds(SYSCALL_ARG(0));
+    updateSystemInfoTime();
+    SYSCALL_RETURN(-error.kind);
 }
 
@@ -5,6 +5,8 @@
 
 SyscallReturn timesSyscall(TrapFrame* frame);
 
+SyscallReturn getrusageSyscall(TrapFrame* frame);
+
 SyscallReturn getNanosecondsSyscall(TrapFrame* frame);
 
 SyscallReturn setNanosecondsSyscall(TrapFrame* frame);
@@ -39,7 +39,10 @@ bool allocatePages(PageTable* table, uintptr_t addr, size_t filesz, size_t memsz
                 // Out of memory
                 return false;
             } else {
-                mapPage(table, position, (uintptr_t)page, bits, 0);
+                if (mapPage(table, position, (uintptr_t)page, bits, 0) == NULL) {
+                    deallocPage(page);
+                    return false;
+                }
             }
             if (position + PAGE_SIZE > addr + filesz) {
                 // Zero out the remaining bytes
@@ -58,10 +61,12 @@ bool allocatePages(PageTable* table, uintptr_t addr, size_t filesz, size_t memsz
                 entry->bits &= ~PAGE_ENTRY_WRITE;
             }
         } else {
+            int zero_bits = bits;
             if ((bits & PAGE_ENTRY_WRITE) != 0) {
-                mapPage(table, position, (uintptr_t)zero_page, (bits & ~PAGE_ENTRY_WRITE) | PAGE_ENTRY_COPY, 0);
-            } else {
-                mapPage(table, position, (uintptr_t)zero_page, bits, 0);
+                zero_bits = (bits & ~PAGE_ENTRY_WRITE) | PAGE_ENTRY_COPY;
+            }
+            if (mapPage(table, position, (uintptr_t)zero_page, zero_bits, 0) == NULL) {
+                return false;
             }
         }
     }
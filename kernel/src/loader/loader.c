@@ -5,6 +5,7 @@
 #include "loader/loader.h"
 
 #include "files/process.h"
+#include "files/ring.h"
 #include "files/syscall.h"
 #include "files/vfs/fs.h"
 #include "files/vfs/file.h"
@@ -13,6 +14,7 @@
 #include "memory/pagetable.h"
 #include "memory/pagealloc.h"
 #include "memory/virtmem.h"
+#include "process/infopage.h"
 #include "process/process.h"
 #include "process/signals.h"
 #include "task/schedule.h"
@@ -83,6 +85,10 @@ Error loadProgramInto(Task* task, const char* path, VirtPtr args, VirtPtr envs)
     VfsStat stat;
     CHECKED(vfsFileStat(file, task->process, virtPtrForKernel(&stat)), vfsFileClose(file));
     MemorySpace* memory = createMemorySpace();
+    if (memory == NULL) {
+        vfsFileClose(file);
+        return simpleError(ENOMEM);
+    }
     uintptr_t entry;
     CHECKED(loadProgramFromElfFile(memory, file, &entry), {
         deallocMemorySpace(memory);
@@ -100,12 +106,19 @@ Error loadProgramInto(Task* task, const char* path, VirtPtr args, VirtPtr envs)
     uintptr_t envs_addr = pushStringArray(virtPtrFor(USER_STACK_TOP, memory), envs, NULL);
     size_t argc = 0;
     uintptr_t args_addr = pushStringArray(virtPtrFor(envs_addr, memory), args, &argc);
+    // Map the info pages below the stack
+    ProcessInfo* info;
+    CHECKED(mapInfoPages(memory, &info), deallocMemorySpace(memory));
     // If everything went well, replace the original process
     if (task->process == NULL) {
         addTaskToProcess(createUserProcess(NULL), task);
     } else {
         terminateAllProcessTasksBut(task->process, task);
     }
+    updateProcessMaxRss(task->process);
+    // The ring is in the old memory
+    releaseProcessRing(task->process);
+    detachProcessInfo(task->process);
     deallocMemorySpace(task->process->memory.mem);
     if (stat.mode & VFS_MODE_SETUID) {
         task->process->user.euid = stat.uid;
@@ -118,6 +131,7 @@ Error loadProgramInto(Task* task, const char* path, VirtPtr args, VirtPtr envs)
     task->process->memory.mem = memory;
     task->process->memory.start_brk = start_brk;
     task->process->memory.brk = start_brk;
+    attachProcessInfo(task->process, info);
     initTrapFrame(&task->frame, args_addr, 0, entry, task->process->pid, memory);
     // Set main function arguments
     task->frame.regs[REG_ARGUMENT_0] = argc;
@@ -126,7 +140,7 @@ Error loadProgramInto(Task* task, const char* path, VirtPtr args, VirtPtr envs)
     // Close files with CLOEXEC flag
     closeExecProcessFiles(task->process);
     // Reset signal handlers
-    clearSignals(task->process);
+    clearSignals(task);
     return simpleError(SUCCESS);
 }
 
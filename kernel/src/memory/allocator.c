@@ -227,3 +227,14 @@ void* reallocMemory(Allocator* alloc, void* old_ptr, size_t old_size, size_t new
     return NULL;
 }
 
+FreeMemoryStats getFreeMemoryStats(Allocator* alloc) {
+    FreeMemoryStats stats = { .total = 0, .largest = 0, .count = 0 };
+    FreeMemory* current = alloc->first_free;
+    while (current != NULL) {
+        stats.total += current->size;
+        stats.largest = umax(stats.largest, current->size);
+        stats.count++;
+        current = current->next;
+    }
+    return stats;
+}
@@ -19,6 +19,12 @@ typedef struct Allocator_s {
     void* special_range_end;
 } Allocator;
 
+typedef struct {
+    size_t total; // Total number of free bytes
+    size_t largest; // Size of the largest free block
+    size_t count; // Number of free blocks
+} FreeMemoryStats;
+
 void initAllocator(Allocator* alloc, size_t block_size, Allocator* backing);
 
 void deinitAllocator(Allocator* alloc);
@@ -29,4 +35,7 @@ void deallocMemory(Allocator* alloc, void* ptr, size_t size);
 
 void* reallocMemory(Allocator* alloc, void* old_ptr, size_t old_size, size_t new_size);
 
+// Walk the free list to measure fragmentation. The caller must hold the lock of the allocator.
+FreeMemoryStats getFreeMemoryStats(Allocator* alloc);
+
 #endif
@@ -15,6 +15,8 @@
 
 #define KALLOC_MEM_ALIGN 8
 #define KALLOC_MIN_FREE (32 * PAGE_SIZE)
+// Allocation sizes are multiples of KALLOC_MEM_ALIGN, so the lowest bit can mark sampled allocations
+#define KALLOC_SAMPLED 1
 
 typedef struct AllocatedMemory_s {
     size_t size; // Number of bytes allocated
@@ -41,6 +43,9 @@ Allocator byte_allocator = {
 static AllocatedMemory* allocated = NULL;
 #endif
 
+static KallocStats stats;
+static size_t sample_countdown = 0;
+
 static size_t kallocActualSizeFor(size_t user_size) {
     return umax(
         (user_size + sizeof(AllocatedMemory) + KALLOC_MEM_ALIGN - 1) & -KALLOC_MEM_ALIGN,
@@ -48,29 +53,105 @@ static size_t kallocActualSizeFor(size_t user_size) {
     );
 }
 
-void* kalloc(size_t size) {
+static size_t sizeClassFor(size_t size) {
+    size_t bits = 64 - __builtin_clzl(size - 1);
+    return umin(bits < 4 ? 0 : bits - 4, KALLOC_SIZE_CLASSES - 1);
+}
+
+static void recordCallsite(uintptr_t caller, size_t size) {
+    size_t index = hashInt64(caller) % KALLOC_CALLSITES;
+    for (size_t i = 0; i < KALLOC_CALLSITES; i++) {
+        KallocCallsiteStats* site = &stats.callsites[(index + i) % KALLOC_CALLSITES];
+        if (site->caller == caller || site->caller == 0) {
+            site->caller = caller;
+            site->allocs++;
+            site->bytes += size;
+            return;
+        }
+    }
+    stats.untracked_callsites++;
+}
+
+static bool insertTrace(AllocatedMemory* mem, uintptr_t caller) {
+    for (size_t i = 0; i < KALLOC_TRACE_SLOTS; i++) {
+        if (stats.traces[i].ptr == NULL) {
+            stats.traces[i].ptr = mem->bytes;
+            stats.traces[i].size = mem->size;
+            stats.traces[i].caller = caller;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void removeTrace(void* bytes) {
+    for (size_t i = 0; i < KALLOC_TRACE_SLOTS; i++) {
+        if (stats.traces[i].ptr == bytes) {
+            stats.traces[i].ptr = NULL;
+            return;
+        }
+    }
+}
+
+// Must be called with kalloc_lock held
+static void recordAllocation(AllocatedMemory* mem, uintptr_t caller) {
+    KallocClassStats* class = &stats.classes[sizeClassFor(mem->size)];
+    class->allocs++;
+    class->live_bytes += mem->size;
+    recordCallsite(caller, mem->size);
+    if (stats.sample_interval != 0) {
+        sample_countdown--;
+        if (sample_countdown == 0) {
+            sample_countdown = stats.sample_interval;
+            if (insertTrace(mem, caller)) {
+                mem->size |= KALLOC_SAMPLED;
+            } else {
+                stats.dropped_samples++;
+            }
+        }
+    }
+}
+
+// Must be called with kalloc_lock held. Takes the size including the sampled marker, the memory
+// itself is not accessed.
+static void recordFree(void* bytes, size_t size) {
+    if ((size & KALLOC_SAMPLED) != 0) {
+        size &= ~KALLOC_SAMPLED;
+        removeTrace(bytes);
+    }
+    KallocClassStats* class = &stats.classes[sizeClassFor(size)];
+    class->frees++;
+    class->live_bytes -= size;
+}
+
+static void* kallocFrom(size_t size, uintptr_t caller) {
     if (size == 0) {
         return NULL;
     } else {
         size_t actual_size = kallocActualSizeFor(size);
         lockSpinLock(&kalloc_lock);
         AllocatedMemory* res = allocMemory(&byte_allocator, actual_size);
-        unlockSpinLock(&kalloc_lock);
         if (res != NULL) {
             res->size = actual_size;
+            recordAllocation(res, caller);
 #ifdef DEBUG
             res->next = allocated;
             allocated = res;
 #endif
-            return res->bytes;
         } else {
-            return NULL;
+            stats.failed++;
         }
+        unlockSpinLock(&kalloc_lock);
+        return res != NULL ? res->bytes : NULL;
     }
 }
 
+void* kalloc(size_t size) {
+    return kallocFrom(size, (uintptr_t)__builtin_return_address(0));
+}
+
 void* zalloc(size_t size) {
-    void* mem = kalloc(size);
+    void* mem = kallocFrom(size, (uintptr_t)__builtin_return_address(0));
     if (mem != NULL) {
         memset(mem, 0, size);
     }
@@ -101,7 +182,8 @@ void dealloc(void* ptr) {
     if (ptr != NULL) {
         lockSpinLock(&kalloc_lock);
         AllocatedMemory* mem = findAllocatedMemoryFor(ptr, true);
-        deallocMemory(&byte_allocator, mem, mem->size);
+        recordFree(mem->bytes, mem->size);
+        deallocMemory(&byte_allocator, mem, mem->size & ~KALLOC_SAMPLED);
         unlockSpinLock(&kalloc_lock);
     }
 }
@@ -111,23 +193,32 @@ void* krealloc(void* ptr, size_t size) {
         dealloc(ptr);
         return NULL;
     } else if (ptr == NULL) {
-        return kalloc(size);
+        return kallocFrom(size, (uintptr_t)__builtin_return_address(0));
     } else {
         size_t actual_size = kallocActualSizeFor(size);
         lockSpinLock(&kalloc_lock);
         AllocatedMemory* mem = findAllocatedMemoryFor(ptr, true);
-        AllocatedMemory* res = reallocMemory(&byte_allocator, mem, mem->size, actual_size);
-        unlockSpinLock(&kalloc_lock);
+        size_t old_size = mem->size;
+        AllocatedMemory* res = reallocMemory(&byte_allocator, mem, old_size & ~KALLOC_SAMPLED, actual_size);
         if (res != NULL) {
+            // Only now is the old allocation gone
+            recordFree(ptr, old_size);
             res->size = actual_size;
+            recordAllocation(res, (uintptr_t)__builtin_return_address(0));
 #ifdef DEBUG
             res->next = allocated;
             allocated = res;
 #endif
-            return res->bytes;
         } else {
-            return NULL;
+            // The old allocation is left untouched
+            stats.failed++;
+#ifdef DEBUG
+            mem->next = allocated;
+            allocated = mem;
+#endif
         }
+        unlockSpinLock(&kalloc_lock);
+        return res != NULL ? res->bytes : NULL;
     }
 }
 
@@ -138,7 +229,20 @@ size_t kallocSize(void* ptr) {
         lockSpinLock(&kalloc_lock);
         AllocatedMemory* mem = findAllocatedMemoryFor(ptr, false);
         unlockSpinLock(&kalloc_lock);
-        return mem->size;
+        return mem->size & ~KALLOC_SAMPLED;
     }
 }
 
+void getKallocStats(KallocStats* out) {
+    lockSpinLock(&kalloc_lock);
+    memcpy(out, &stats, sizeof(KallocStats));
+    out->free = getFreeMemoryStats(&byte_allocator);
+    unlockSpinLock(&kalloc_lock);
+}
+
+void setKallocSampleInterval(size_t interval) {
+    lockSpinLock(&kalloc_lock);
+    stats.sample_interval = interval;
+    sample_countdown = interval;
+    unlockSpinLock(&kalloc_lock);
+}
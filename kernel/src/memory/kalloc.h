@@ -2,6 +2,43 @@
 #define _KALLOC_H_
 
 #include <stddef.h>
+#include <stdint.h>
+
+#include "memory/allocator.h"
+
+// Size classes are powers of two from 16 bytes, the last one contains all larger allocations
+#define KALLOC_SIZE_CLASSES 12
+#define KALLOC_CALLSITES 128
+#define KALLOC_TRACE_SLOTS 256
+
+typedef struct {
+    size_t allocs;
+    size_t frees;
+    size_t live_bytes;
+} KallocClassStats;
+
+typedef struct {
+    uintptr_t caller;
+    size_t allocs;
+    size_t bytes;
+} KallocCallsiteStats;
+
+typedef struct {
+    void* ptr;
+    size_t size;
+    uintptr_t caller;
+} KallocTraceEntry;
+
+typedef struct {
+    KallocClassStats classes[KALLOC_SIZE_CLASSES];
+    KallocCallsiteStats callsites[KALLOC_CALLSITES];
+    size_t untracked_callsites; // Allocations made after the callsite table was full
+    size_t failed;
+    FreeMemoryStats free;
+    size_t sample_interval;
+    size_t dropped_samples; // Sampled allocations that did not fit into the trace table
+    KallocTraceEntry traces[KALLOC_TRACE_SLOTS];
+} KallocStats;
 
 extern struct Allocator_s byte_allocator;
 
@@ -16,4 +53,10 @@ void* krealloc(void* ptr, size_t size);
 // Returns the size of the allocation at the given pointer
 size_t kallocSize(void* ptr);
 
+// Copy a snapshot of the allocator statistics into stats
+void getKallocStats(KallocStats* stats);
+
+// Record every nth allocation in the trace table until it is freed. Zero disables sampling.
+void setKallocSampleInterval(size_t interval);
+
 #endif
@@ -0,0 +1,130 @@
+
+#include <assert.h>
+
+#include "memory/kstack.h"
+
+#include "interrupt/com.h"
+#include "memory/pagealloc.h"
+#include "memory/reclaim.h"
+#include "memory/virtmem.h"
+#include "task/harts.h"
+#include "task/spinlock.h"
+#include "task/syscall.h"
+
+// Every slot in the pool consists of one guard page followed by the stack itself. Stacks must be
+// identity mapped, because code in critical sections continues on the task stack in M-mode. The
+// guard pages are therefore removed from the identity mapping of the kernel page table.
+#define KERNEL_STACK_PAGES (KERNEL_STACK_SIZE / PAGE_SIZE)
+#define KERNEL_STACK_SLOT_PAGES (KERNEL_STACK_PAGES + 1)
+
+// Maximum number of free stacks kept by a single hart
+#define KERNEL_STACK_HART_CACHE 4
+
+static SpinLock stack_pool_lock;
+static KernelStackFree* free_stacks = NULL;
+
+static void* allocNewStack() {
+    PageAllocation alloc = allocPages(KERNEL_STACK_SLOT_PAGES);
+    if (alloc.ptr == NULL) {
+        return NULL;
+    }
+    lockSpinLock(&kernel_page_table_lock);
+    PageTableEntry* entry = splitToPage(kernel_page_table, (uintptr_t)alloc.ptr);
+    if (entry == NULL) {
+        // Without a guard page the stack could silently overflow into other memory
+        unlockSpinLock(&kernel_page_table_lock);
+        deallocPages(alloc);
+        return NULL;
+    }
+    entry->entry = 0;
+    unlockSpinLock(&kernel_page_table_lock);
+    addressTranslationFenceAt(0, (uintptr_t)alloc.ptr);
+    if (getCurrentTask() != NULL) {
+        // Returning from the interrupt flushes the TLB of the other harts. In hart context we can
+        // not wait for other harts, but they will flush on their next trap return anyway.
+        sendMessageToAll(FLUSH_TLB, NULL);
+    }
+    return alloc.ptr + PAGE_SIZE;
+}
+
+static void freeStack(void* stack) {
+    uintptr_t guard = (uintptr_t)stack - PAGE_SIZE;
+    lockSpinLock(&kernel_page_table_lock);
+    mapPage(kernel_page_table, guard, guard, PAGE_ENTRY_AD_RW, 0);
+    unlockSpinLock(&kernel_page_table_lock);
+    PageAllocation alloc = {
+        .ptr = (void*)guard,
+        .size = KERNEL_STACK_SLOT_PAGES,
+    };
+    deallocPages(alloc);
+}
+
+static bool reclaimStacks(Priority priority, void* udata) {
+    lockSpinLock(&stack_pool_lock);
+    KernelStackFree* stack = free_stacks;
+    if (stack != NULL) {
+        free_stacks = stack->next;
+    }
+    unlockSpinLock(&stack_pool_lock);
+    if (stack != NULL) {
+        freeStack(stack);
+        return true;
+    } else {
+        return false;
+    }
+}
+
+Error initKernelStackPool() {
+    registerReclaimable(LOWEST_PRIORITY, reclaimStacks, NULL);
+    return simpleError(SUCCESS);
+}
+
+void* allocKernelStack() {
+    KernelStackFree* stack = NULL;
+    Task* task = criticalEnter();
+    HartFrame* hart = getCurrentHartFrame();
+    if (hart != NULL && hart->free_stacks != NULL) {
+        stack = hart->free_stacks;
+        hart->free_stacks = stack->next;
+        hart->free_stack_count--;
+    }
+    criticalReturn(task);
+    if (stack == NULL) {
+        lockSpinLock(&stack_pool_lock);
+        stack = free_stacks;
+        if (stack != NULL) {
+            free_stacks = stack->next;
+        }
+        unlockSpinLock(&stack_pool_lock);
+    }
+    if (stack == NULL) {
+        return allocNewStack();
+    } else {
+        return stack;
+    }
+}
+
+void deallocKernelStack(void* ptr) {
+    if (ptr != NULL) {
+        KernelStackFree* stack = (KernelStackFree*)ptr;
+        Task* task = criticalEnter();
+        HartFrame* hart = getCurrentHartFrame();
+        if (hart != NULL && hart->free_stack_count < KERNEL_STACK_HART_CACHE) {
+            stack->next = hart->free_stacks;
+            hart->free_stacks = stack;
+            hart->free_stack_count++;
+            stack = NULL;
+        }
+        criticalReturn(task);
+        if (stack != NULL) {
+            lockSpinLock(&stack_pool_lock);
+            stack->next = free_stacks;
+            free_stacks = stack;
+            unlockSpinLock(&stack_pool_lock);
+        }
+    }
+}
+
+bool isInKernelStackGuard(void* stack, uintptr_t addr) {
+    return addr >= (uintptr_t)stack - PAGE_SIZE && addr < (uintptr_t)stack;
+}
@@ -0,0 +1,30 @@
+#ifndef _KSTACK_H_
+#define _KSTACK_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "error/error.h"
+
+#define KERNEL_STACK_SIZE (1 << 16)
+
+// Free stacks are kept in linked lists stored at the bottom of the stack itself
+typedef struct KernelStackFree_s {
+    struct KernelStackFree_s* next;
+} KernelStackFree;
+
+// Initialize the kernel stack pool. Must be called after the kernel page table has been created.
+Error initKernelStackPool();
+
+// Allocate a stack of KERNEL_STACK_SIZE bytes. The page below the returned address is unmapped
+// in the kernel page table and acts as a guard page.
+void* allocKernelStack();
+
+// Return the stack to the pool. It will be reused for the next allocation on this hart.
+void deallocKernelStack(void* stack);
+
+// Returns true if the given address is inside the guard page below the given stack.
+bool isInKernelStackGuard(void* stack, uintptr_t addr);
+
+#endif
@@ -17,44 +17,71 @@ MemorySpace* createMemorySpace() {
 }
 
 bool handlePageFault(MemorySpace* mem, uintptr_t address) {
+    // Threads of the same process can fault on the same page concurrently, so the entry is only
+    // inspected and changed while holding the lock. Allocating and copying happens without it.
+    lockSpinLock(&global_page_lock);
     PageTableEntry* entry = virtToEntry(mem, address);
-    if (entry != NULL && entry->v && (entry->bits & PAGE_ENTRY_COPY) != 0) {
-        // This is a copy-on-write page
-        void* phy = (void*)((uintptr_t)entry->paddr << 12);
-        if (phy == zero_page) {
-            void* page = zallocPage(); // Zero page, so zallocPage
-            if (page == NULL) {
-                return false;
-            } else {
-                // We don't need to add references here, only if we have more than one reference
-                entry->bits |= PAGE_ENTRY_WRITE;
-                entry->bits &= ~PAGE_ENTRY_COPY;
-                entry->paddr = (uintptr_t)page >> 12;
-                return true;
-            }
-        } else {
-            lockSpinLock(&global_page_lock);
-            if (hasOtherReferences(&ref_count, (uintptr_t)phy)) {
-                void* page = allocPage();
-                if (page == NULL) {
-                    // No more memory... Segfault!
-                    unlockSpinLock(&global_page_lock);
-                    return false;
-                } else {
-                    memcpy(page, phy, PAGE_SIZE);
-                    entry->paddr = (uintptr_t)page >> 12;
-                }
-            } else {
-                // If we have no other reference, we can reuse the current page
+    if (entry == NULL || !entry->v || (entry->bits & PAGE_ENTRY_COPY) == 0) {
+        unlockSpinLock(&global_page_lock);
+        return false;
+    }
+    // This is a copy-on-write page
+    void* phy = (void*)((uintptr_t)entry->paddr << 12);
+    if (phy != zero_page && !hasOtherReferences(&ref_count, (uintptr_t)phy)) {
+        // If we have no other reference, we can reuse the current page
+        entry->bits |= PAGE_ENTRY_WRITE;
+        entry->bits &= ~PAGE_ENTRY_COPY;
+        unlockSpinLock(&global_page_lock);
+        return true;
+    }
+    if (phy != zero_page) {
+        // Keep the old page alive while copying it
+        addReferenceFor(&ref_count, (uintptr_t)phy);
+    }
+    unlockSpinLock(&global_page_lock);
+    void* page = allocPage();
+    if (page == NULL) {
+        // No more memory... Segfault!
+    } else if (phy == zero_page) {
+        // We don't need to add references here, only if we have more than one reference
+        memset(page, 0, PAGE_SIZE);
+    } else {
+        memcpy(page, phy, PAGE_SIZE);
+    }
+    lockSpinLock(&global_page_lock);
+    // The entry might have been changed by another thread in the meantime
+    entry = virtToEntry(mem, address);
+    bool handled = false;
+    if (entry != NULL && entry->v) {
+        if (page != NULL && (entry->bits & PAGE_ENTRY_COPY) != 0 && entry->paddr == (uintptr_t)phy >> 12) {
+            if (phy != zero_page) {
+                // This entry no longer references the old page
+                removeReferenceFor(&ref_count, (uintptr_t)phy);
             }
+            PageTableEntry old = *entry;
+            entry->paddr = (uintptr_t)page >> 12;
             entry->bits |= PAGE_ENTRY_WRITE;
             entry->bits &= ~PAGE_ENTRY_COPY;
-            unlockSpinLock(&global_page_lock);
-            return true;
+            updateResidentPages(mem, old, entry);
+            page = NULL;
+            handled = true;
+        } else {
+            // Retrying the access will fault again if required
+            handled = page != NULL && (entry->bits & (PAGE_ENTRY_WRITE | PAGE_ENTRY_COPY)) != 0;
         }
-    } else {
-        return false;
     }
+    unlockSpinLock(&global_page_lock);
+    if (page != NULL) {
+        deallocPage(page);
+    }
+    // Drop the reference taken for copying
+    removePageReference(phy);
+    return handled;
+}
+
+bool isSpuriousPageFault(MemorySpace* mem, uintptr_t address, int bits) {
+    PageTableEntry* entry = virtToEntry(mem, address);
+    return entry != NULL && entry->v && (entry->bits & PAGE_ENTRY_USER) != 0 && (entry->bits & bits) == bits;
 }
 
 uintptr_t virtToPhys(MemorySpace* mem, uintptr_t vaddr, bool write, bool allow_all) {
@@ -92,29 +119,57 @@ uintptr_t virtToPhys(MemorySpace* mem, uintptr_t vaddr, bool write, bool allow_a
     }
 }
 
+void addPageReference(void* page) {
+    if (page != zero_page) {
+        lockSpinLock(&global_page_lock);
+        addReferenceFor(&ref_count, (uintptr_t)page);
+        unlockSpinLock(&global_page_lock);
+    }
+}
+
+void removePageReference(void* page) {
+    if (page != zero_page) {
+        lockSpinLock(&global_page_lock);
+        // Remove reference to the page we are freeing
+        if (!hasOtherReferences(&ref_count, (uintptr_t)page)) {
+            unlockSpinLock(&global_page_lock);
+            // If we have no other table using this page, deallocate it
+            deallocPage(page);
+        } else {
+            removeReferenceFor(&ref_count, (uintptr_t)page);
+            unlockSpinLock(&global_page_lock);
+        }
+    }
+}
+
+bool hasOtherPageReferences(void* page) {
+    if (page == zero_page) {
+        return true;
+    } else {
+        lockSpinLock(&global_page_lock);
+        bool result = hasOtherReferences(&ref_count, (uintptr_t)page);
+        unlockSpinLock(&global_page_lock);
+        return result;
+    }
+}
+
+size_t countResidentPages(MemorySpace* mem) {
+    return getResidentPages(mem);
+}
+
 static void freePageEntryData(PageTableEntry* entry) {
     if ((entry->bits & PAGE_ENTRY_GLOBAL) == 0) {
-        void* phy = (void*)((uintptr_t)entry->paddr << 12);
-        if (phy != zero_page) {
-            lockSpinLock(&global_page_lock);
-            // Remove reference to the page we are freeing
-            if (!hasOtherReferences(&ref_count, (uintptr_t)phy)) {
-                unlockSpinLock(&global_page_lock);
-                // If we have no other table using this page, deallocate it
-                deallocPage(phy);
-            } else {
-                removeReferenceFor(&ref_count, (uintptr_t)phy);
-                unlockSpinLock(&global_page_lock);
-            }
-        }
+        removePageReference((void*)((uintptr_t)entry->paddr << 12));
     }
 }
 
 void unmapAndFreePage(MemorySpace* mem, uintptr_t vaddr) {
     PageTableEntry* entry = virtToEntry(mem, vaddr);
     if (entry != NULL) {
+        PageTableEntry old = *entry;
         freePageEntryData(entry);
         entry->v = 0;
+        updateResidentPages(mem, old, entry);
     }
 }
 
@@ -153,7 +208,8 @@ static bool copyMemoryPageEntry(PageTableEntry* dst, PageTableEntry* src) {
             // We have at least two references, the one we copy from and the one we copyied.
             addReferenceFor(&ref_count, (uintptr_t)phy);
             unlockSpinLock(&global_page_lock);
-            if ((src->bits & PAGE_ENTRY_WRITE) != 0) {
+            // Shared pages remain writable in both memory spaces
+            if ((src->bits & PAGE_ENTRY_WRITE) != 0 && (src->bits & PAGE_ENTRY_SHARED) == 0) {
                 // If this page can be written, we also have to set the copy-on-write flag
                 src->bits |= PAGE_ENTRY_COPY;
                 src->bits &= ~PAGE_ENTRY_WRITE;
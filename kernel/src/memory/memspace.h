@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "memory/pagetable.h"
 
@@ -13,10 +14,26 @@ MemorySpace* createMemorySpace();
 // Return true if handled successfully
 bool handlePageFault(MemorySpace* mem, uintptr_t address);
 
+// Return true if the page now allows the access, e.g. because another thread handled the fault
+bool isSpuriousPageFault(MemorySpace* mem, uintptr_t address, int bits);
+
 uintptr_t virtToPhys(MemorySpace* mem, uintptr_t vaddr, bool write, bool allow_all);
 
 void unmapAndFreePage(MemorySpace* mem, uintptr_t vaddr);
 
+// Add a reference to the page, e.g. for mapping it into another memory space
+void addPageReference(void* page);
+
+// Remove a reference to the page, and free it if this was the last one
+void removePageReference(void* page);
+
+// Return true if the page is referenced more than once (the zero page always is)
+bool hasOtherPageReferences(void* page);
+
+// Number of user pages that are backed by their own physical page, i.e. not the zero page. This is
+// counted while mapping, so it does not have to walk the page table.
+size_t countResidentPages(MemorySpace* mem);
+
 void freeMemorySpace(MemorySpace* mem);
 
 void deallocMemorySpace(MemorySpace* mem);
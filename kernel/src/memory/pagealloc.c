@@ -8,6 +8,7 @@
 #include "memory/reclaim.h"
 #include "task/spinlock.h"
 #include "task/syscall.h"
+#include "util/util.h"
 
 extern char __heap_start[];
 extern char __heap_end[];
@@ -21,22 +22,54 @@ Allocator page_allocator = {
 
 void* zero_page;
 
+static PageAllocStats stats;
+
+// Size class of the allocation each heap page belongs to. Frees are accounted to the class the
+// pages were allocated with, even if an allocation is freed in parts.
+static uint8_t* page_classes;
+static uintptr_t heap_start;
+
 Error initPageAllocator() {
     uintptr_t start = ((uintptr_t)__heap_start + PAGE_SIZE - 1) & -PAGE_SIZE;
     uintptr_t end = (uintptr_t)__heap_end & -PAGE_SIZE;
     assert(end >= start);
     deallocMemory(&page_allocator, (void*)start, end - start);
+    size_t classes_size = ((end - start) / PAGE_SIZE + PAGE_SIZE - 1) & -PAGE_SIZE;
+    page_classes = allocMemory(&page_allocator, classes_size);
+    if (page_classes == NULL) {
+        return simpleError(ENOMEM);
+    }
+    heap_start = start;
     KERNEL_SUBSUCCESS("Initialized page allocator");
     zero_page = zallocPage();
     KERNEL_SUBSUCCESS("Initialized zero page");
     return simpleError(SUCCESS);
 }
 
-void* allocPage() {
-    return allocPages(1).ptr;
+static size_t sizeClassFor(size_t pages) {
+    return umin(63 - __builtin_clzl(pages), PAGE_SIZE_CLASSES - 1);
 }
 
-static PageAllocation basicAllocPages(size_t pages) {
+static uint8_t* pageClassesFor(void* ptr) {
+    return &page_classes[((uintptr_t)ptr - heap_start) / PAGE_SIZE];
+}
+
+// Must be called with alloc_lock held
+static void recordCallsite(uintptr_t caller, size_t pages) {
+    size_t index = hashInt64(caller) % PAGE_CALLSITES;
+    for (size_t i = 0; i < PAGE_CALLSITES; i++) {
+        PageCallsiteStats* site = &stats.callsites[(index + i) % PAGE_CALLSITES];
+        if (site->caller == caller || site->caller == 0) {
+            site->caller = caller;
+            site->allocs++;
+            site->pages += pages;
+            return;
+        }
+    }
+    stats.untracked_callsites++;
+}
+
+static PageAllocation basicAllocPages(size_t pages, uintptr_t caller) {
     PageAllocation ret = {
         .ptr = NULL,
         .size = 0,
@@ -46,30 +79,58 @@ static PageAllocation basicAllocPages(size_t pages) {
         ret.ptr = allocMemory(&page_allocator, pages * PAGE_SIZE);
         if (ret.ptr != NULL) {
             ret.size = pages;
+            size_t class = sizeClassFor(pages);
+            stats.classes[class].allocs++;
+            stats.classes[class].live_pages += pages;
+            memset(pageClassesFor(ret.ptr), class, pages);
+            recordCallsite(caller, pages);
         }
         unlockSpinLock(&alloc_lock);
     }
     return ret;
 }
 
-PageAllocation allocPages(size_t pages) {
-    PageAllocation alloc = basicAllocPages(pages);
+static PageAllocation allocPagesFrom(size_t pages, uintptr_t caller) {
+    PageAllocation alloc = basicAllocPages(pages, caller);
     if (pages != 0 && alloc.size == 0) {
         // Try to reclaim memory.
         Priority priority = LOWEST_PRIORITY;
-        while (tryReclaimingMemory(priority) || priority > HIGHEST_PRIORITY) {
+        for (;;) {
+            bool reclaimed = tryReclaimingMemory(priority);
+            lockSpinLock(&alloc_lock);
+            stats.reclaim_runs++;
+            if (reclaimed) {
+                stats.reclaimed++;
+            }
+            unlockSpinLock(&alloc_lock);
+            if (!reclaimed && priority <= HIGHEST_PRIORITY) {
+                break;
+            }
             if (priority > HIGHEST_PRIORITY) {
                 priority--;
             }
-            alloc = basicAllocPages(pages);
+            alloc = basicAllocPages(pages, caller);
             if (alloc.size > 0) {
                 break;
             }
         }
+        if (alloc.size == 0) {
+            lockSpinLock(&alloc_lock);
+            stats.failed++;
+            unlockSpinLock(&alloc_lock);
+        }
     }
     return alloc;
 }
 
+void* allocPage() {
+    return allocPagesFrom(1, (uintptr_t)__builtin_return_address(0)).ptr;
+}
+
+PageAllocation allocPages(size_t pages) {
+    return allocPagesFrom(pages, (uintptr_t)__builtin_return_address(0));
+}
+
 void deallocPage(void* ptr) {
     PageAllocation alloc = {
         .ptr = ptr,
@@ -87,18 +148,32 @@ void deallocPages(PageAllocation alloc) {
             && alloc.ptr + alloc.size * PAGE_SIZE <= (void*)__heap_end
         );
         lockSpinLock(&alloc_lock);
+        uint8_t* classes = pageClassesFor(alloc.ptr);
+        stats.classes[classes[0]].frees++;
+        for (size_t i = 0; i < alloc.size; i++) {
+            stats.classes[classes[i]].live_pages--;
+        }
         deallocMemory(&page_allocator, alloc.ptr, alloc.size * PAGE_SIZE);
         unlockSpinLock(&alloc_lock);
     }
 }
 
 void* zallocPage() {
-    return zallocPages(1).ptr;
+    PageAllocation alloc = allocPagesFrom(1, (uintptr_t)__builtin_return_address(0));
+    memset(alloc.ptr, 0, alloc.size * PAGE_SIZE);
+    return alloc.ptr;
 }
 
 PageAllocation zallocPages(size_t pages) {
-    PageAllocation alloc = allocPages(pages);
+    PageAllocation alloc = allocPagesFrom(pages, (uintptr_t)__builtin_return_address(0));
     memset(alloc.ptr, 0, alloc.size * PAGE_SIZE);
     return alloc;
 }
 
+void getPageAllocStats(PageAllocStats* out) {
+    lockSpinLock(&alloc_lock);
+    memcpy(out, &stats, sizeof(PageAllocStats));
+    out->free = getFreeMemoryStats(&page_allocator);
+    unlockSpinLock(&alloc_lock);
+}
+
@@ -2,11 +2,17 @@
 #define _PAGEALLOC_H_
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include "error/error.h"
+#include "memory/allocator.h"
 
 #define PAGE_SIZE (1 << 12)
 
+// Size classes are powers of two from one page, the last one contains all larger allocations
+#define PAGE_SIZE_CLASSES 8
+#define PAGE_CALLSITES 64
+
 extern void* zero_page;
 extern struct Allocator_s page_allocator;
 
@@ -15,6 +21,28 @@ typedef struct {
     size_t size;
 } PageAllocation;
 
+typedef struct {
+    size_t allocs;
+    size_t frees;
+    size_t live_pages;
+} PageClassStats;
+
+typedef struct {
+    uintptr_t caller;
+    size_t allocs;
+    size_t pages;
+} PageCallsiteStats;
+
+typedef struct {
+    PageClassStats classes[PAGE_SIZE_CLASSES];
+    PageCallsiteStats callsites[PAGE_CALLSITES];
+    size_t untracked_callsites; // Allocations made after the callsite table was full
+    size_t failed;
+    size_t reclaim_runs; // Number of times an allocation tried to reclaim memory
+    size_t reclaimed; // Number of times reclaiming freed some memory
+    FreeMemoryStats free;
+} PageAllocStats;
+
 // Initialize the memory for page allocation.
 Error initPageAllocator();
 
@@ -36,4 +64,7 @@ void* zallocPage();
 // Allocate a set of continuous pages and fill the page with zeros.
 PageAllocation zallocPages(size_t pages);
 
+// Copy a snapshot of the page allocator statistics into stats
+void getPageAllocStats(PageAllocStats* stats);
+
 #endif
@@ -4,14 +4,34 @@
 
 #include "memory/pagetable.h"
 
+#include "error/panic.h"
 #include "memory/pagealloc.h"
+#include "memory/virtmem.h"
+
+// The last entry of a root table would map the top of the address space, which is never used. It
+// stays invalid, so the hardware ignores its other bits and we keep the resident page count there.
+#define RESIDENT_COUNT_INDEX (PAGE_TABLE_SIZE - 1)
+
+static bool isResidentEntry(PageTableEntry entry) {
+    return entry.v && (entry.bits & (PAGE_ENTRY_USER | PAGE_ENTRY_GLOBAL)) == PAGE_ENTRY_USER
+        && (void*)((uintptr_t)entry.paddr << 12) != zero_page;
+}
+
+void updateResidentPages(PageTable* root, PageTableEntry old, PageTableEntry* entry) {
+    int64_t change = (int64_t)isResidentEntry(*entry) - (int64_t)isResidentEntry(old);
+    if (change != 0) {
+        // Threads of a process can fault and unmap pages concurrently
+        __atomic_add_fetch(&root->entries[RESIDENT_COUNT_INDEX].entry, (uint64_t)change << 1, __ATOMIC_RELAXED);
+    }
+}
+
+size_t getResidentPages(PageTable* root) {
+    return __atomic_load_n(&root->entries[RESIDENT_COUNT_INDEX].entry, __ATOMIC_RELAXED) >> 1;
+}
 
 PageTable* createPageTable() {
     static_assert(PAGE_SIZE == sizeof(PageTable));
-    PageTable* page = zallocPage();
-    // TODO: handle alloc errors (Not here but in the users)
-    assert(page != NULL);
-    return page;
+    return zallocPage();
 }
 
 void freePageTable(PageTable* table) {
@@ -29,10 +49,14 @@ PageTableEntry* mapPage(PageTable* root, uintptr_t vaddr, uintptr_t paddr, int b
         (vaddr >> 21) & 0x1ff,
         (vaddr >> 30) & 0x1ff,
     };
+    assert(vpn[2] != RESIDENT_COUNT_INDEX);
     PageTableEntry* entry = &root->entries[vpn[2]];
     for (int i = 1; i >= level; i--) {
         if (!entry->v) {
             PageTable* page = createPageTable();
+            if (page == NULL) {
+                return NULL;
+            }
             entry->entry = 0;
             entry->paddr = ((uintptr_t)page) >> 12;
             entry->v = true;
@@ -44,12 +68,50 @@ PageTableEntry* mapPage(PageTable* root, uintptr_t vaddr, uintptr_t paddr, int b
     }
     // This must be a leaf node or invalid
     assert(!entry->v || (entry->bits & PAGE_ENTRY_RWX) != 0);
+    PageTableEntry old = *entry;
     entry->paddr = paddr >> 12;
     entry->bits = bits;
     entry->v = true;
+    updateResidentPages(root, old, entry);
     return entry;
 }
 
+PageTableEntry* splitToPage(PageTable* root, uintptr_t vaddr) {
+    uintptr_t vpn[3] = {
+        (vaddr >> 12) & 0x1ff,
+        (vaddr >> 21) & 0x1ff,
+        (vaddr >> 30) & 0x1ff,
+    };
+    PageTableEntry* entry = &root->entries[vpn[2]];
+    for (int i = 2; i > 0; i--) {
+        if (!entry->v) {
+            return NULL;
+        }
+        if ((entry->bits & PAGE_ENTRY_RWX) != 0) {
+            // This is a leaf at a higher level. Replace it with a table that maps the same range.
+            PageTable* page = createPageTable();
+            if (page == NULL) {
+                return NULL;
+            }
+            uintptr_t size = PAGE_SIZE << (9 * (i - 1));
+            for (int j = 0; j < PAGE_TABLE_SIZE; j++) {
+                page->entries[j].entry = 0;
+                page->entries[j].paddr = ((entry->paddr << 12) + j * size) >> 12;
+                page->entries[j].bits = entry->bits;
+            }
+            // Other harts might be walking this table, so write the new entry all at once.
+            PageTableEntry branch = { .entry = 0 };
+            branch.paddr = ((uintptr_t)page) >> 12;
+            branch.v = true;
+            memoryFence();
+            entry->entry = branch.entry;
+        }
+        PageTable* next_level = (PageTable*)((uintptr_t)entry->paddr << 12);
+        entry = &next_level->entries[vpn[i - 1]];
+    }
+    return entry->v ? entry : NULL;
+}
+
 static bool tryToFreeTable(PageTable* table) {
     for (int i = 0; i < PAGE_TABLE_SIZE; i++) {
         PageTableEntry* entry = &table->entries[i];
@@ -78,7 +140,9 @@ void unmapPage(PageTable* root, uintptr_t vaddr) {
                 assert(i != 0); // Level 0 can not contain branches
                 table[i - 1] = (PageTable*)((uintptr_t)entry[i]->paddr << 12);
             } else {
+                PageTableEntry old = *entry[i];
                 entry[i]->entry = 0;
+                updateResidentPages(root, old, entry[i]);
                 for (int j = i; j < 2; j++) {
                     if (tryToFreeTable(table[j])) {
                         entry[j + 1]->entry = 0;
@@ -227,7 +291,10 @@ void mapPageRange(PageTable* root, uintptr_t from_vaddr, uintptr_t to_vaddr, uin
 void mapPageRangeAtLevel(PageTable* root, uintptr_t from_vaddr, uintptr_t to_vaddr, uintptr_t paddr, int bits, int level) {
     uintptr_t size = (PAGE_SIZE << (9 * level));
     for (uintptr_t i = 0; i < to_vaddr - from_vaddr; i += size, paddr += size) {
-        mapPage(root, from_vaddr + i, paddr, bits, level);
+        // Range maps are only used for the kernel page table during initialization
+        if (mapPage(root, from_vaddr + i, paddr, bits, level) == NULL) {
+            panic();
+        }
     }
 }
 
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 typedef enum {
     PAGE_ENTRY_VALID    = (1 << 0),
@@ -14,6 +15,7 @@ typedef enum {
     PAGE_ENTRY_ACCESSED = (1 << 6),
     PAGE_ENTRY_DIRTY    = (1 << 7),
     PAGE_ENTRY_COPY     = (1 << 8),
+    PAGE_ENTRY_SHARED   = (1 << 9),
     PAGE_ENTRY_RW       = (PAGE_ENTRY_READ | PAGE_ENTRY_WRITE),
     PAGE_ENTRY_RX       = (PAGE_ENTRY_READ | PAGE_ENTRY_EXEC),
     PAGE_ENTRY_RWX      = (PAGE_ENTRY_READ | PAGE_ENTRY_WRITE | PAGE_ENTRY_EXEC),
@@ -54,19 +56,30 @@ typedef struct {
     PageTableEntry entries[PAGE_TABLE_SIZE];
 } PageTable;
 
-// Allocate a new page table
+// Allocate a new page table. Returns NULL if out of memory.
 PageTable* createPageTable();
 
 // Free an allocated page table
 void freePageTable(PageTable* table);
 
 // Add a map to the given page table. This function should be idempotent. Returns the changes table
-// entry.
+// entry, or NULL if an intermediate table could not be allocated.
 PageTableEntry* mapPage(PageTable* root, uintptr_t vaddr, uintptr_t paddr, int bits, int level);
 
+// Make sure the given vaddr is mapped by a level 0 entry, splitting larger pages if required.
+// Returns the level 0 entry or NULL if the address is not mapped or a table could not be allocated.
+PageTableEntry* splitToPage(PageTable* root, uintptr_t vaddr);
+
 // Remove the map for a given virtual address. This function should be idempotent.
 void unmapPage(PageTable* root, uintptr_t vaddr);
 
+// Must be called after changing a leaf entry directly instead of using mapPage or unmapPage. old is
+// the value the entry had before.
+void updateResidentPages(PageTable* root, PageTableEntry old, PageTableEntry* entry);
+
+// Number of user pages mapped in the table, not counting the zero page or global pages
+size_t getResidentPages(PageTable* root);
+
 // Remove all maps from the given page root.
 void unmapAllPages(PageTable* root);
 
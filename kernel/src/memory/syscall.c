@@ -3,11 +3,18 @@
 
 #include "memory/syscall.h"
 
+#include "files/process.h"
+#include "files/special/shm.h"
+#include "loader/loader.h"
+#include "memory/memspace.h"
 #include "memory/pagealloc.h"
 #include "memory/pagetable.h"
-#include "memory/memspace.h"
+#include "process/infopage.h"
+#include "process/process.h"
+#include "task/tasklock.h"
 #include "util/util.h"
 
+// Returns the old break, or -ENOMEM if the new pages could not be mapped
 static uintptr_t changeProcessBreak(Process* process, intptr_t change) {
     uintptr_t old_brk = process->memory.brk;
     uintptr_t end = old_brk + smax(change, -old_brk);
@@ -21,14 +28,23 @@ static uintptr_t changeProcessBreak(Process* process, intptr_t change) {
         return old_brk;
     } else if (page_end > page_start) {
         for (uintptr_t i = page_start; i < page_end; i += PAGE_SIZE) {
-            mapPage(
-                process->memory.mem, i, (uintptr_t)zero_page,
-                PAGE_ENTRY_USER | PAGE_ENTRY_READ | PAGE_ENTRY_AD | PAGE_ENTRY_COPY, 0
-            );
+            if (
+                mapPage(
+                    process->memory.mem, i, (uintptr_t)zero_page,
+                    PAGE_ENTRY_USER | PAGE_ENTRY_READ | PAGE_ENTRY_AD | PAGE_ENTRY_COPY, 0
+                ) == NULL
+            ) {
+                // The pages are not accessible yet, so they can be removed without a flush
+                for (uintptr_t j = page_start; j < i; j += PAGE_SIZE) {
+                    unmapAndFreePage(process->memory.mem, j);
+                }
+                return -ENOMEM;
+            }
         }
         process->memory.brk = end;
         return old_brk;
     } else {
+        updateProcessMaxRss(process);
         for (uintptr_t i = page_end; i < page_start; i += PAGE_SIZE) {
             unmapAndFreePage(process->memory.mem, i);
         }
@@ -40,7 +56,13 @@ static uintptr_t changeProcessBreak(Process* process, intptr_t change) {
 SyscallReturn sbrkSyscall(TrapFrame* frame) {
     assert(frame->hart != NULL);
     Task* task = (Task*)frame;
-    SYSCALL_RETURN(changeProcessBreak(task->process, SYSCALL_ARG(0)));
+    lockTaskLock(&task->process->memory.lock);
+    uintptr_t old_brk = changeProcessBreak(task->process, SYSCALL_ARG(0));
+    unlockTaskLock(&task->process->memory.lock);
+    if ((intptr_t)SYSCALL_ARG(0) < 0) {
+        flushProcessTlb(task->process);
+    }
+    SYSCALL_RETURN(old_brk);
 }
 
 #define PROT_NONE 0
@@ -58,12 +80,18 @@ typedef struct {
 static void allPagesProtectCallback(PageTableEntry* entry, uintptr_t vaddr, void* udata) {
     ProtectSyscallRequest* request = (ProtectSyscallRequest*)udata;
     if (vaddr >= request->start && vaddr < request->end && (entry->bits & PAGE_ENTRY_USER) != 0) {
-        entry->bits &= ~PAGE_ENTRY_RWX;
+        entry->bits &= ~(PAGE_ENTRY_RWX | PAGE_ENTRY_COPY);
         if ((request->protect & PROT_READ) != 0) {
             entry->bits |= PAGE_ENTRY_READ;
         }
         if ((request->protect & PROT_WRITE) != 0) {
-            entry->bits |= PAGE_ENTRY_WRITE;
+            void* page = (void*)((uintptr_t)entry->paddr << 12);
+            if ((entry->bits & PAGE_ENTRY_SHARED) == 0 && hasOtherPageReferences(page)) {
+                // Private pages used by someone else must remain copy-on-write
+                entry->bits |= PAGE_ENTRY_READ | PAGE_ENTRY_COPY;
+            } else {
+                entry->bits |= PAGE_ENTRY_WRITE;
+            }
         }
         if ((request->protect & PROT_EXEC) != 0) {
             entry->bits |= PAGE_ENTRY_EXEC;
@@ -77,7 +105,7 @@ SyscallReturn protectSyscall(TrapFrame* frame) {
     uintptr_t addr = task->frame.regs[REG_ARGUMENT_1];
     uintptr_t length = task->frame.regs[REG_ARGUMENT_2];
     uintptr_t protect = task->frame.regs[REG_ARGUMENT_3];
-    if ((protect & PROT_READ_WRITE_EXEC) == 0) {
+    if ((protect & PROT_READ_WRITE_EXEC) == 0 || overlapsInfoPages(addr, addr + length)) {
         SYSCALL_RETURN(-EINVAL);
     } else {
         if (length != 0) {
@@ -86,9 +114,189 @@ SyscallReturn protectSyscall(TrapFrame* frame) {
                 .end = (addr + length + PAGE_SIZE - 1) & -PAGE_SIZE,
                 .protect = protect,
             };
+            lockTaskLock(&task->process->memory.lock);
             allPagesDo(task->process->memory.mem, allPagesProtectCallback, &request);
+            unlockTaskLock(&task->process->memory.lock);
+            flushProcessTlb(task->process);
         }
         SYSCALL_RETURN(0);
     }
 }
 
+#define MAP_SHARED 0x01
+#define MAP_PRIVATE 0x02
+#define MAP_FIXED 0x10
+#define MAP_ANONYMOUS 0x20
+
+// Mappings without a fixed address are placed below the info pages
+#define MMAP_TOP (USER_INFO_ADDR - PAGE_SIZE)
+
+// Largest mapping that can be created with a single call
+#define MMAP_MAX_LENGTH (1UL << 36)
+
+// User mappings must be below the top of the stack, i.e. in the lower half of the Sv39 space
+static bool isUserRange(uintptr_t addr, size_t length) {
+    return length <= USER_STACK_TOP && addr <= USER_STACK_TOP - length;
+}
+
+static bool isRangeUnmapped(MemorySpace* mem, uintptr_t start, uintptr_t end) {
+    for (uintptr_t i = start; i < end; i += PAGE_SIZE) {
+        PageTableEntry* entry = virtToEntry(mem, i);
+        if (entry != NULL && entry->v) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uintptr_t findUnmappedRange(Process* process, size_t size) {
+    uintptr_t bottom = (process->memory.brk + PAGE_SIZE - 1) & -PAGE_SIZE;
+    uintptr_t end = MMAP_TOP;
+    while (end >= bottom + size) {
+        uintptr_t start = end - size;
+        uintptr_t i = end;
+        while (i > start) {
+            i -= PAGE_SIZE;
+            PageTableEntry* entry = virtToEntry(process->memory.mem, i);
+            if (entry != NULL && entry->v) {
+                break;
+            }
+        }
+        PageTableEntry* entry = virtToEntry(process->memory.mem, i);
+        if (entry == NULL || !entry->v) {
+            return start;
+        }
+        // Continue searching below the mapped page
+        end = i;
+    }
+    return 0;
+}
+
+static void unmapRange(MemorySpace* mem, uintptr_t start, uintptr_t end) {
+    for (uintptr_t i = start; i < end; i += PAGE_SIZE) {
+        unmapAndFreePage(mem, i);
+    }
+}
+
+static Error mapRange(Process* process, uintptr_t start, size_t size, int prot, int flags, VfsNode* shm, size_t offset) {
+    int bits = PAGE_ENTRY_USER | PAGE_ENTRY_AD;
+    if ((prot & (PROT_READ | PROT_WRITE)) != 0) {
+        bits |= PAGE_ENTRY_READ;
+    }
+    if ((prot & PROT_EXEC) != 0) {
+        bits |= PAGE_ENTRY_EXEC;
+    }
+    bool shared = (flags & MAP_SHARED) != 0;
+    if ((prot & PROT_WRITE) != 0) {
+        bits |= shared ? PAGE_ENTRY_WRITE : PAGE_ENTRY_COPY;
+    }
+    if (shared) {
+        bits |= PAGE_ENTRY_SHARED;
+    }
+    for (size_t i = 0; i < size; i += PAGE_SIZE) {
+        void* page;
+        if (shm != NULL) {
+            CHECKED(getShmPage(shm, (offset + i) / PAGE_SIZE, &page), {
+                unmapRange(process->memory.mem, start, start + i);
+            });
+        } else if (shared) {
+            // Shared anonymous pages can not use the zero page, they must be shared after a fork.
+            page = zallocPage();
+            if (page == NULL) {
+                unmapRange(process->memory.mem, start, start + i);
+                return simpleError(ENOMEM);
+            }
+        } else {
+            page = zero_page;
+        }
+        if (mapPage(process->memory.mem, start + i, (uintptr_t)page, bits, 0) == NULL) {
+            removePageReference(page);
+            unmapRange(process->memory.mem, start, start + i);
+            return simpleError(ENOMEM);
+        }
+    }
+    return simpleError(SUCCESS);
+}
+
+SyscallReturn mmapSyscall(TrapFrame* frame) {
+    assert(frame->hart != NULL);
+    Task* task = (Task*)frame;
+    assert(task->process != NULL);
+    uintptr_t addr = SYSCALL_ARG(0);
+    size_t length = SYSCALL_ARG(1);
+    int prot = SYSCALL_ARG(2);
+    int flags = SYSCALL_ARG(3);
+    int fd = SYSCALL_ARG(4);
+    size_t offset = SYSCALL_ARG(5);
+    if (
+        length == 0 || length > MMAP_MAX_LENGTH || (prot & PROT_READ_WRITE_EXEC) == 0 || offset % PAGE_SIZE != 0
+        || ((flags & MAP_SHARED) != 0) == ((flags & MAP_PRIVATE) != 0)
+        || (
+            (flags & MAP_FIXED) != 0
+            && (addr % PAGE_SIZE != 0 || !isUserRange(addr, length) || overlapsInfoPages(addr, addr + length))
+        )
+    ) {
+        SYSCALL_RETURN(-EINVAL);
+    }
+    size_t size = (length + PAGE_SIZE - 1) & -PAGE_SIZE;
+    VfsFileDescriptor* desc = NULL;
+    if ((flags & MAP_ANONYMOUS) == 0) {
+        desc = getFileDescriptor(task->process, fd);
+        if (desc == NULL) {
+            SYSCALL_RETURN(-EBADF);
+        } else if (!isShmNode(desc->file->node)) {
+            // Only shared memory objects can be mapped for now
+            vfsFileDescriptorClose(task->process, desc);
+            SYSCALL_RETURN(-ENODEV);
+        } else if (
+            (desc->file->flags & VFS_FILE_READ) == 0
+            || ((flags & MAP_SHARED) != 0 && (prot & PROT_WRITE) != 0 && (desc->file->flags & VFS_FILE_WRITE) == 0)
+        ) {
+            vfsFileDescriptorClose(task->process, desc);
+            SYSCALL_RETURN(-EACCES);
+        }
+    }
+    lockTaskLock(&task->process->memory.lock);
+    MemorySpace* mem = task->process->memory.mem;
+    if ((flags & MAP_FIXED) != 0) {
+        unmapRange(mem, addr, addr + size);
+    } else if (addr == 0 || addr % PAGE_SIZE != 0 || addr > MMAP_TOP - size || !isRangeUnmapped(mem, addr, addr + size)) {
+        addr = findUnmappedRange(task->process, size);
+    }
+    Error err = simpleError(ENOMEM);
+    if (addr != 0) {
+        err = mapRange(task->process, addr, size, prot, flags, desc != NULL ? desc->file->node : NULL, offset);
+    }
+    unlockTaskLock(&task->process->memory.lock);
+    if ((flags & MAP_FIXED) != 0) {
+        flushProcessTlb(task->process);
+    }
+    if (desc != NULL) {
+        vfsFileDescriptorClose(task->process, desc);
+    }
+    if (isError(err)) {
+        SYSCALL_RETURN(-err.kind);
+    } else {
+        SYSCALL_RETURN(addr);
+    }
+}
+
+SyscallReturn munmapSyscall(TrapFrame* frame) {
+    assert(frame->hart != NULL);
+    Task* task = (Task*)frame;
+    assert(task->process != NULL);
+    uintptr_t addr = SYSCALL_ARG(0);
+    size_t length = SYSCALL_ARG(1);
+    if (
+        addr % PAGE_SIZE != 0 || length == 0 || !isUserRange(addr, length)
+        || overlapsInfoPages(addr, addr + length)
+    ) {
+        SYSCALL_RETURN(-EINVAL);
+    }
+    lockTaskLock(&task->process->memory.lock);
+    updateProcessMaxRss(task->process);
+    unmapRange(task->process->memory.mem, addr, (addr + length + PAGE_SIZE - 1) & -PAGE_SIZE);
+    unlockTaskLock(&task->process->memory.lock);
+    flushProcessTlb(task->process);
+    SYSCALL_RETURN(0);
+}
@@ -7,4 +7,8 @@ SyscallReturn sbrkSyscall(TrapFrame* frame);
 
 SyscallReturn protectSyscall(TrapFrame* frame);
 
+SyscallReturn mmapSyscall(TrapFrame* frame);
+
+SyscallReturn munmapSyscall(TrapFrame* frame);
+
 #endif
@@ -0,0 +1,116 @@
+#include <assert.h>
+#include <stddef.h>
+
+#include "memory/usercopy.h"
+
+#include "memory/pagealloc.h"
+#include "memory/virtmem.h"
+#include "task/frameoffsets.h"
+#include "task/syscall.h"
+#include "task/task.h"
+#include "util/util.h"
+
+// Copy in chunks, to limit the time spent with interrupts disabled
+#define USER_COPY_CHUNK (16 * PAGE_SIZE)
+
+typedef struct {
+    uintptr_t insn;
+    uintptr_t fixup;
+} ExceptionFixup;
+
+extern ExceptionFixup __extable_start[];
+extern ExceptionFixup __extable_end[];
+
+static_assert(offsetof(TrapFrame, regs[REG_STACK_POINTER]) == TRAP_FRAME_SP);
+static_assert(offsetof(TrapFrame, pc) == TRAP_FRAME_PC);
+static_assert(offsetof(TrapFrame, satp) == TRAP_FRAME_SATP);
+static_assert(offsetof(HartFrame, stack_top) == HART_FRAME_STACK_TOP);
+
+// Returned in a0 and a1. The address is only valid if faulted is set, it can also be zero.
+typedef struct {
+    uintptr_t faulted;
+    uintptr_t address;
+} UserAccessResult;
+
+UserAccessResult copyFromUserRaw(uint64_t satp, void* to, uintptr_t from, size_t n);
+
+UserAccessResult copyToUserRaw(uint64_t satp, uintptr_t to, const void* from, size_t n);
+
+UserAccessResult strncpyFromUserRaw(uint64_t satp, char* to, uintptr_t from, size_t n, size_t* length);
+
+Error copyFromUser(MemorySpace* mem, void* to, uintptr_t from, size_t n) {
+    uint64_t satp = satpForMemory(0, mem);
+    while (n > 0) {
+        size_t chunk = umin(n, USER_COPY_CHUNK);
+        Task* task = criticalEnter();
+        UserAccessResult result = copyFromUserRaw(satp, to, from, chunk);
+        criticalReturn(task);
+        if (result.faulted) {
+            return simpleError(EFAULT);
+        }
+        to += chunk;
+        from += chunk;
+        n -= chunk;
+    }
+    return simpleError(SUCCESS);
+}
+
+Error copyToUser(MemorySpace* mem, uintptr_t to, const void* from, size_t n) {
+    uint64_t satp = satpForMemory(0, mem);
+    while (n > 0) {
+        size_t chunk = umin(n, USER_COPY_CHUNK);
+        Task* task = criticalEnter();
+        UserAccessResult result = copyToUserRaw(satp, to, from, chunk);
+        criticalReturn(task);
+        if (result.faulted) {
+            // This might be a copy-on-write page. If so, retry after copying it.
+            if (!handlePageFault(mem, result.address)) {
+                return simpleError(EFAULT);
+            } else if (task != NULL) {
+                task->usage.minor_faults++;
+            }
+        } else {
+            to += chunk;
+            from += chunk;
+            n -= chunk;
+        }
+    }
+    return simpleError(SUCCESS);
+}
+
+Error strncpyFromUser(MemorySpace* mem, char* to, uintptr_t from, size_t n, size_t* length) {
+    uint64_t satp = satpForMemory(0, mem);
+    *length = 0;
+    while (n > 0) {
+        size_t chunk = umin(n, USER_COPY_CHUNK);
+        size_t chunk_length = 0;
+        Task* task = criticalEnter();
+        UserAccessResult result = strncpyFromUserRaw(satp, to, from, chunk, &chunk_length);
+        criticalReturn(task);
+        if (result.faulted) {
+            return simpleError(EFAULT);
+        }
+        *length += chunk_length;
+        if (chunk_length < chunk) {
+            return simpleError(SUCCESS);
+        }
+        if (to != NULL) {
+            to += chunk;
+        }
+        from += chunk;
+        n -= chunk;
+    }
+    return simpleError(ENAMETOOLONG);
+}
+
+bool applyExceptionFixup(TrapFrame* frame, uintptr_t val) {
+    for (ExceptionFixup* entry = __extable_start; entry < __extable_end; entry++) {
+        if (entry->insn == frame->pc) {
+            frame->pc = entry->fixup;
+            frame->regs[REG_ARGUMENT_0] = 1;
+            frame->regs[REG_ARGUMENT_1] = val;
+            return true;
+        }
+    }
+    return false;
+}
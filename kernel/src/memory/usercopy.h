@@ -0,0 +1,28 @@
+#ifndef _USERCOPY_H_
+#define _USERCOPY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "error/error.h"
+#include "memory/memspace.h"
+#include "task/types.h"
+
+// These functions access user memory directly through the user page table instead of translating
+// every address in software. Faults are caught using the exception fixup table.
+
+// Copy n bytes from the user address from in mem to the kernel buffer to.
+Error copyFromUser(MemorySpace* mem, void* to, uintptr_t from, size_t n);
+
+// Copy n bytes from the kernel buffer from to the user address to in mem.
+Error copyToUser(MemorySpace* mem, uintptr_t to, const void* from, size_t n);
+
+// Copy the string at from, including the terminating NUL, to to. At most n bytes are copied, if the
+// string is longer ENAMETOOLONG is returned. The length without NUL is written to length. to may
+// be NULL, in which case only the length is computed.
+Error strncpyFromUser(MemorySpace* mem, char* to, uintptr_t from, size_t n, size_t* length);
+
+// If the trap at the pc of frame was caused by a user access, continue at the fixup.
+bool applyExceptionFixup(TrapFrame* frame, uintptr_t val);
+
+#endif
@@ -36,6 +36,10 @@ static Error identityMapDeviceNode(DeviceTreeNode* node, void* null) {
 Error initKernelVirtualMemory() {
     lockSpinLock(&kernel_page_table_lock);
     kernel_page_table = createPageTable();
+    if (kernel_page_table == NULL) {
+        unlockSpinLock(&kernel_page_table_lock);
+        return simpleError(ENOMEM);
+    }
     // Identity map all the memory. Only .text is executable. .text and .rodata are read only.
     mapPageRange(
         kernel_page_table, (uintptr_t)__text_start, (uintptr_t)__text_end,
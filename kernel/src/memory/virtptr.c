@@ -7,6 +7,7 @@
 #include "memory/virtptr.h"
 
 #include "memory/pagealloc.h"
+#include "memory/usercopy.h"
 #include "memory/virtmem.h"
 #include "error/log.h"
 
@@ -37,6 +38,15 @@ VirtPtr unsafeVirtPtrFor(uintptr_t addr, MemorySpace* mem) {
     return ret;
 }
 
+static bool isKernelVirtPtr(VirtPtr addr) {
+    return addr.table == NULL || addr.table == kernel_page_table;
+}
+
+static bool isUserVirtPtr(VirtPtr addr) {
+    // Pointers with allow_all must ignore the page permissions, they can not use direct access.
+    return !isKernelVirtPtr(addr) && !addr.allow_all;
+}
+
 void* virtPtrPhys(VirtPtr addr) {
     return (void*)virtToPhys(addr.table, addr.address, false, addr.allow_all);
 }
@@ -97,6 +107,16 @@ void* virtPtrPartsDo(VirtPtr addr, size_t length, VirtPtrPartsDoCallback callbac
 }
 
 void memcpyBetweenVirtPtr(VirtPtr dest, VirtPtr src, size_t n) {
+    // Try direct access first. If it faults, fall back to copying the accessible parts.
+    if (isKernelVirtPtr(dest) && isUserVirtPtr(src)) {
+        if (!isError(copyFromUser(src.table, (void*)dest.address, src.address, n))) {
+            return;
+        }
+    } else if (isUserVirtPtr(dest) && isKernelVirtPtr(src)) {
+        if (!isError(copyToUser(dest.table, dest.address, (void*)src.address, n))) {
+            return;
+        }
+    }
     // This does not support overlaps.
     size_t dest_count = getVirtPtrParts(dest, n, NULL, 0, true);
     size_t src_count = getVirtPtrParts(src, n, NULL, 0, false);
@@ -193,6 +213,12 @@ void writeMisaligned(VirtPtr addr, size_t size, uint64_t value) {
 
 size_t strlenVirtPtr(VirtPtr str) {
     size_t length = 0;
+    if (isUserVirtPtr(str)) {
+        if (!isError(strncpyFromUser(str.table, NULL, str.address, SIZE_MAX, &length))) {
+            return length;
+        }
+        length = 0;
+    }
     while (readInt(str, 8) != 0) {
         str.address++;
         length++;
@@ -0,0 +1,261 @@
+
+#include <assert.h>
+
+#include "process/futex.h"
+
+#include "interrupt/timer.h"
+#include "memory/memspace.h"
+#include "memory/pagetable.h"
+#include "task/schedtrace.h"
+#include "task/schedule.h"
+#include "task/spinlock.h"
+#include "util/util.h"
+
+#define FUTEX_BUCKETS 64
+
+typedef struct {
+    SpinLock lock;
+    Task* waiters; // Linked using sched.locks_next
+} FutexBucket;
+
+static FutexBucket buckets[FUTEX_BUCKETS];
+
+static FutexBucket* bucketFor(uintptr_t key) {
+    return &buckets[hashInt64(key) % FUTEX_BUCKETS];
+}
+
+static uintptr_t futexKeyFor(Process* process, uintptr_t addr) {
+    if (addr % sizeof(int32_t) != 0) {
+        return 0;
+    }
+    MemorySpace* mem = process->memory.mem;
+    PageTableEntry* entry = virtToEntry(mem, addr);
+    if (entry == NULL || !entry->v || (entry->bits & PAGE_ENTRY_USER) == 0) {
+        return 0;
+    }
+    // Resolve copy-on-write first, otherwise the key would change with the first write
+    uintptr_t key = virtToPhys(mem, addr, true, false);
+    if (key == 0) {
+        key = virtToPhys(mem, addr, false, false);
+    }
+    return key;
+}
+
+// Must be called with the bucket lock held
+static void appendWaiter(FutexBucket* bucket, Task* task) {
+    Task** current = &bucket->waiters;
+    while (*current != NULL) {
+        current = &(*current)->sched.locks_next;
+    }
+    task->sched.locks_next = NULL;
+    *current = task;
+}
+
+// Must be called with the bucket lock held
+static bool removeWaiter(FutexBucket* bucket, Task* task) {
+    Task** current = &bucket->waiters;
+    while (*current != NULL) {
+        if (*current == task) {
+            *current = task->sched.locks_next;
+            task->futex_key = 0;
+            return true;
+        }
+        current = &(*current)->sched.locks_next;
+    }
+    return false;
+}
+
+// Remove the task from the queue it is waiting in. Returns false if it was not waiting.
+static bool removeQueuedWaiter(Task* task) {
+    // The key can change concurrently by a requeue, so retry until the task is in no queue.
+    uintptr_t key;
+    while ((key = task->futex_key) != 0) {
+        FutexBucket* bucket = bucketFor(key);
+        lockSpinLock(&bucket->lock);
+        bool removed = removeWaiter(bucket, task);
+        unlockSpinLock(&bucket->lock);
+        if (removed) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void interruptWaiter(Task* task, int error) {
+    if (removeQueuedWaiter(task)) {
+        if (task->futex_timeout != 0) {
+            clearTimeout(task->futex_timeout_id);
+        }
+        task->frame.regs[REG_ARGUMENT_0] = -error;
+        if (tryAwakeningTask(task)) {
+            enqueueTask(task);
+        }
+    }
+}
+
+static void handleFutexTimeout(Time time, void* udata) {
+    Task* task = (Task*)udata;
+    // The task might have been woken and freed already. It can only be used if it is still queued.
+    for (size_t i = 0; i < FUTEX_BUCKETS; i++) {
+        FutexBucket* bucket = &buckets[i];
+        lockSpinLock(&bucket->lock);
+        Task* current = bucket->waiters;
+        while (current != NULL && current != task) {
+            current = current->sched.locks_next;
+        }
+        bool timeout = current != NULL && task->futex_timeout != 0 && time >= task->futex_timeout;
+        if (timeout) {
+            removeWaiter(bucket, task);
+        }
+        unlockSpinLock(&bucket->lock);
+        if (timeout) {
+            task->frame.regs[REG_ARGUMENT_0] = -ETIMEDOUT;
+            if (tryAwakeningTask(task)) {
+                enqueueTask(task);
+            }
+            return;
+        }
+    }
+}
+
+static bool hasPendingSignals(Process* process) {
+    lockSpinLock(&process->lock);
+    bool pending = process->signals.signals != NULL;
+    unlockSpinLock(&process->lock);
+    return pending;
+}
+
+void futexWait(Task* task, uintptr_t addr, int32_t value, Time timeout) {
+    assert(getCurrentTask() == NULL);
+    // The task might still be queued if it was stopped while waiting before
+    removeFutexWaiter(task);
+    uintptr_t key = futexKeyFor(task->process, addr);
+    if (key == 0) {
+        task->frame.regs[REG_ARGUMENT_0] = -EFAULT;
+        return;
+    }
+    FutexBucket* bucket = bucketFor(key);
+    lockSpinLock(&bucket->lock);
+    if (*(volatile int32_t*)key != value) {
+        unlockSpinLock(&bucket->lock);
+        task->frame.regs[REG_ARGUMENT_0] = -EAGAIN;
+        return;
+    }
+    task->frame.regs[REG_ARGUMENT_0] = 0;
+    task->futex_key = key;
+    task->futex_timeout = timeout != 0 ? getTime() + timeout : 0;
+    task->times.system_time += getTime() - task->times.entered;
+    lockSpinLock(&task->sched.lock);
+    task->sched.wakeup_function = NULL;
+    unlockSpinLock(&task->sched.lock);
+    // The task must be in the waiting list before a waker can find it in the bucket.
+    moveTaskToState(task, WAITING);
+    traceSchedEvent(SCHED_TRACE_BLOCK, task, SCHED_TRACE_BLOCK_FUTEX);
+    task->usage.voluntary_switches++;
+    enqueueTask(task);
+    if (timeout != 0) {
+        // Wakers clear the timeout, so it must be set before they can find the task
+        task->futex_timeout_id = setTimeoutTime(task->futex_timeout, handleFutexTimeout, task);
+    }
+    appendWaiter(bucket, task);
+    unlockSpinLock(&bucket->lock);
+    // Signals are queued before interrupting the waiters, so one of us will see the other.
+    if (hasPendingSignals(task->process)) {
+        interruptWaiter(task, EINTR);
+    }
+    runNextTask();
+}
+
+void interruptFutexWaits(Process* process) {
+    lockSpinLock(&process->lock);
+    Task* current = process->tasks;
+    while (current != NULL) {
+        interruptWaiter(current, EINTR);
+        current = current->proc_next;
+    }
+    unlockSpinLock(&process->lock);
+}
+
+// Must be called with the bucket lock held
+static size_t wakeWaiters(FutexBucket* bucket, uintptr_t key, size_t count) {
+    size_t woken = 0;
+    Task** current = &bucket->waiters;
+    while (*current != NULL && woken < count) {
+        Task* task = *current;
+        if (task->futex_key == key) {
+            *current = task->sched.locks_next;
+            task->futex_key = 0;
+            if (task->futex_timeout != 0) {
+                clearTimeout(task->futex_timeout_id);
+            }
+            // Tasks that were stopped or terminated while waiting are only removed
+            if (tryAwakeningTask(task)) {
+                enqueueTask(task);
+                woken++;
+            }
+        } else {
+            current = &task->sched.locks_next;
+        }
+    }
+    return woken;
+}
+
+Error futexWake(Process* process, uintptr_t addr, size_t count, size_t* woken) {
+    uintptr_t key = futexKeyFor(process, addr);
+    if (key == 0) {
+        return simpleError(EFAULT);
+    }
+    FutexBucket* bucket = bucketFor(key);
+    lockSpinLock(&bucket->lock);
+    *woken = wakeWaiters(bucket, key, count);
+    unlockSpinLock(&bucket->lock);
+    return simpleError(SUCCESS);
+}
+
+Error futexRequeue(
+    Process* process, uintptr_t addr, size_t count, uintptr_t addr2, size_t requeue,
+    bool check, int32_t value, size_t* woken
+) {
+    uintptr_t key = futexKeyFor(process, addr);
+    uintptr_t key2 = futexKeyFor(process, addr2);
+    if (key == 0 || key2 == 0) {
+        return simpleError(EFAULT);
+    }
+    FutexBucket* bucket = bucketFor(key);
+    FutexBucket* bucket2 = bucketFor(key2);
+    // Lock in a fixed order to avoid deadlocks
+    lockSpinLock(bucket < bucket2 ? &bucket->lock : &bucket2->lock);
+    if (bucket != bucket2) {
+        lockSpinLock(bucket < bucket2 ? &bucket2->lock : &bucket->lock);
+    }
+    Error err = simpleError(SUCCESS);
+    if (check && *(volatile int32_t*)key != value) {
+        err = simpleError(EAGAIN);
+    } else {
+        *woken = wakeWaiters(bucket, key, count);
+        size_t moved = 0;
+        Task** current = &bucket->waiters;
+        while (*current != NULL && moved < requeue) {
+            Task* task = *current;
+            if (task->futex_key == key) {
+                *current = task->sched.locks_next;
+                task->futex_key = key2;
+                appendWaiter(bucket2, task);
+                moved++;
+            } else {
+                current = &task->sched.locks_next;
+            }
+        }
+    }
+    if (bucket != bucket2) {
+        unlockSpinLock(&bucket2->lock);
+    }
+    unlockSpinLock(&bucket->lock);
+    return err;
+}
+
+void removeFutexWaiter(Task* task) {
+    if (removeQueuedWaiter(task) && task->futex_timeout != 0) {
+        clearTimeout(task->futex_timeout_id);
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef _FUTEX_H_
+#define _FUTEX_H_
+
+#include <stdint.h>
+
+#include "error/error.h"
+#include "process/types.h"
+
+// Futexes are keyed by the physical address of the futex word, so they also work between
+// processes sharing memory.
+
+// Block the task if the futex word still equals value. If this returns, the task was not blocked and
+// the result of the syscall is already set. Must be called from the trap handler.
+void futexWait(Task* task, uintptr_t addr, int32_t value, Time timeout);
+
+// Wake up to count tasks waiting on the futex. Returns the number of tasks woken.
+Error futexWake(Process* process, uintptr_t addr, size_t count, size_t* woken);
+
+// Wake up to count tasks waiting on addr and move up to requeue of the remaining ones to addr2.
+// If check is true, fails with EAGAIN unless the word at addr equals value.
+Error futexRequeue(
+    Process* process, uintptr_t addr, size_t count, uintptr_t addr2, size_t requeue,
+    bool check, int32_t value, size_t* woken
+);
+
+// Remove the task from any futex wait queue, called before freeing it
+void removeFutexWaiter(Task* task);
+
+// Interrupt all futex waits of the process with EINTR, called when a signal is added
+void interruptFutexWaits(Process* process);
+
+#endif
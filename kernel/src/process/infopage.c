@@ -0,0 +1,114 @@
+
+#include <assert.h>
+
+#include "process/infopage.h"
+
+#include "interrupt/timer.h"
+#include "kernel/time.h"
+#include "memory/memspace.h"
+#include "memory/pagetable.h"
+#include "memory/virtmem.h"
+#include "task/spinlock.h"
+
+#define CLOCK_TO_NANOS (1000000000UL / CLOCKS_PER_SEC)
+
+static SystemInfo* system_info = NULL;
+static SpinLock info_lock;
+
+// User space retries reading if the counter is odd or changed while reading
+static void beginInfoWrite(uint32_t* seq) {
+    (*seq)++;
+    memoryFence();
+}
+
+static void endInfoWrite(uint32_t* seq) {
+    memoryFence();
+    (*seq)++;
+}
+
+Error initSystemInfo() {
+    system_info = zallocPage();
+    if (system_info == NULL) {
+        return simpleError(ENOMEM);
+    }
+    system_info->time_frequency = CLOCKS_PER_SEC;
+    updateSystemInfoTime();
+    return simpleError(SUCCESS);
+}
+
+void updateSystemInfoTime() {
+    if (system_info != NULL) {
+        int64_t offset = getNanosecondsWithFallback() - getTime() * CLOCK_TO_NANOS;
+        lockSpinLock(&info_lock);
+        beginInfoWrite(&system_info->seq);
+        system_info->wall_offset = offset;
+        endInfoWrite(&system_info->seq);
+        unlockSpinLock(&info_lock);
+    }
+}
+
+Error mapInfoPages(MemorySpace* mem, ProcessInfo** info) {
+    assert(system_info != NULL);
+    ProcessInfo* page = zallocPage();
+    if (page == NULL) {
+        return simpleError(ENOMEM);
+    }
+    // After a fork, the process page is still shared with the parent
+    unmapAndFreePage(mem, PROCESS_INFO_ADDR);
+    // The system page is not owned by any memory space
+    if (
+        mapPage(mem, SYSTEM_INFO_ADDR, (uintptr_t)system_info, PAGE_ENTRY_USER | PAGE_ENTRY_AD_R | PAGE_ENTRY_GLOBAL, 0) == NULL
+        || mapPage(mem, PROCESS_INFO_ADDR, (uintptr_t)page, PAGE_ENTRY_USER | PAGE_ENTRY_AD_R, 0) == NULL
+    ) {
+        deallocPage(page);
+        return simpleError(ENOMEM);
+    }
+    *info = page;
+    return simpleError(SUCCESS);
+}
+
+void attachProcessInfo(Process* process, ProcessInfo* info) {
+    // Keep the page alive, even if the mapping is somehow removed
+    addPageReference(info);
+    lockSpinLock(&info_lock);
+    process->memory.info = info;
+    unlockSpinLock(&info_lock);
+    updateProcessInfo(process);
+}
+
+void detachProcessInfo(Process* process) {
+    lockSpinLock(&info_lock);
+    ProcessInfo* info = process->memory.info;
+    process->memory.info = NULL;
+    unlockSpinLock(&info_lock);
+    if (info != NULL) {
+        removePageReference(info);
+    }
+}
+
+void updateProcessInfo(Process* process) {
+    lockSpinLock(&process->user.lock);
+    Uid uid = process->user.ruid;
+    Gid gid = process->user.rgid;
+    Uid euid = process->user.euid;
+    Gid egid = process->user.egid;
+    unlockSpinLock(&process->user.lock);
+    lockSpinLock(&info_lock);
+    ProcessInfo* info = process->memory.info;
+    if (info != NULL) {
+        beginInfoWrite(&info->seq);
+        info->pid = process->pid;
+        info->ppid = process->tree.parent != NULL ? process->tree.parent->pid : 0;
+        info->uid = uid;
+        info->gid = gid;
+        info->euid = euid;
+        info->egid = egid;
+        endInfoWrite(&info->seq);
+    }
+    unlockSpinLock(&info_lock);
+}
+
+bool overlapsInfoPages(uintptr_t start, uintptr_t end) {
+    return start < USER_INFO_END && end > USER_INFO_ADDR;
+}
+
@@ -0,0 +1,57 @@
+#ifndef _INFOPAGE_H_
+#define _INFOPAGE_H_
+
+#include <stdint.h>
+
+#include "error/error.h"
+#include "loader/loader.h"
+#include "memory/pagealloc.h"
+#include "process/types.h"
+
+// Every user process gets two read-only pages below the stack. The first is shared by all processes
+// and allows reading the time without a syscall, the second contains the ids of the process. Both
+// are protected by a sequence counter that is odd while the kernel is changing the page.
+#define USER_INFO_ADDR (USER_STACK_TOP - USER_STACK_SIZE - 3 * PAGE_SIZE)
+#define SYSTEM_INFO_ADDR USER_INFO_ADDR
+#define PROCESS_INFO_ADDR (USER_INFO_ADDR + PAGE_SIZE)
+#define USER_INFO_END (USER_INFO_ADDR + 2 * PAGE_SIZE)
+
+typedef struct {
+    uint32_t seq;
+    uint32_t reserved;
+    uint64_t time_frequency; // Frequency of the time CSR
+    int64_t wall_offset;     // Nanoseconds since the epoch at which the time CSR was zero
+} SystemInfo;
+
+typedef struct ProcessInfo_s {
+    uint32_t seq;
+    Pid pid;
+    Pid ppid;
+    Uid uid;
+    Gid gid;
+    Uid euid;
+    Gid egid;
+} ProcessInfo;
+
+// Allocate the system page. Must be called after the rtc has been initialized.
+Error initSystemInfo();
+
+// Recompute the wall clock offset, e.g. after the rtc has been changed
+void updateSystemInfoTime();
+
+// Map the system page and a new process page into mem, the process page is returned in info
+Error mapInfoPages(MemorySpace* mem, ProcessInfo** info);
+
+// Use the process page, which must be mapped into the memory of the process
+void attachProcessInfo(Process* process, ProcessInfo* info);
+
+// Drop the reference to the process page held by the process
+void detachProcessInfo(Process* process);
+
+// Fill in the ids in the process page
+void updateProcessInfo(Process* process);
+
+// Return true if the range overlaps the info pages, which can not be changed by the process
+bool overlapsInfoPages(uintptr_t start, uintptr_t end);
+
+#endif
@@ -9,6 +9,7 @@
 #include "error/panic.h"
 #include "files/path.h"
 #include "files/process.h"
+#include "files/ring.h"
 #include "interrupt/com.h"
 #include "interrupt/syscall.h"
 #include "interrupt/timer.h"
@@ -17,12 +18,16 @@
 #include "memory/memspace.h"
 #include "memory/pagealloc.h"
 #include "memory/pagetable.h"
+#include "memory/usercopy.h"
 #include "memory/virtmem.h"
 #include "memory/virtptr.h"
+#include "process/futex.h"
+#include "process/infopage.h"
 #include "process/signals.h"
 #include "process/syscall.h"
 #include "process/types.h"
 #include "task/harts.h"
+#include "task/schedtrace.h"
 #include "task/schedule.h"
 #include "task/spinlock.h"
 #include "task/syscall.h"
@@ -46,6 +51,9 @@ SpinLock process_lock;
 #define STATUS_STOP 2
 #define STATUS_CONT 3
 
+// Maximum number of exited threads that are remembered for joining
+#define MAX_EXITED_THREADS 256
+
 static Error basicProcessWait(Task* task) {
     size_t found = 0;
     Pid pid = task->frame.regs[REG_ARGUMENT_1];
@@ -74,6 +82,15 @@ static Error basicProcessWait(Task* task) {
                 child->status = 0; // After we have read the status, reset it.
                 task->times.user_child_time += child->times.user_time + child->times.user_child_time;
                 task->times.system_child_time += child->times.system_time + child->times.system_child_time;
+                if (child->tasks == NULL) {
+                    // Only account the usage once the child has exited. The memory of the child
+                    // is freed after we deallocate it, so the resident set can still be sampled.
+                    addTaskUsage(&task->child_usage, &child->usage);
+                    addTaskUsage(&task->child_usage, &child->child_usage);
+                    updateProcessMaxRss(child);
+                    size_t max_rss = umax(child->memory.max_rss, child->child_max_rss);
+                    task->process->child_max_rss = umax(task->process->child_max_rss, max_rss);
+                }
                 task->frame.regs[REG_ARGUMENT_0] = child->pid;
                 clearPendingChildSignals(task->process, child->pid);
                 if (child->tasks == NULL) {
@@ -124,6 +141,7 @@ void executeProcessWait(Task* task) {
         if (err.kind == EINTR) {
             lockSpinLock(&task->sched.lock); 
             task->sched.wakeup_function = handleProcessWaitWakeup;
+            task->usage.voluntary_switches++;
             unlockSpinLock(&task->sched.lock); 
         } else {
             task->frame.regs[REG_ARGUMENT_0] = -err.kind;
@@ -157,6 +175,7 @@ static void unregisterProcess(Process* process) {
         Process* child = process->tree.children;
         while (child != NULL) {
             child->tree.parent = process->tree.parent;
+            updateProcessInfo(child);
             child->tree.child_next = process->tree.parent->tree.children;
             process->tree.parent->tree.children = child;
             child = child->tree.child_next;
@@ -179,6 +198,8 @@ static void unregisterProcess(Process* process) {
             child->tree.parent = NULL;
             if (child->tasks == NULL) {
                 deallocProcess(child);
+            } else {
+                updateProcessInfo(child);
             }
             child = child->tree.child_next;
         }
@@ -205,7 +226,9 @@ Pid allocateNewPid() {
 Process* createUserProcess(Process* parent) {
     Process* process = zalloc(sizeof(Process));
     if (process != NULL) {
+        ProcessInfo* info = NULL;
         process->pid = allocateNewPid();
+        initTaskLock(&process->memory.lock);
         process->tree.parent = parent;
         if (parent != NULL) {
             // Copy session id and process group id
@@ -231,6 +254,10 @@ Process* createUserProcess(Process* parent) {
             process->memory.start_brk = parent->memory.start_brk;
             process->memory.brk = parent->memory.brk;
             process->memory.mem = cloneMemorySpace(parent->memory.mem);
+            if (process->memory.mem != NULL && parent->memory.info != NULL) {
+                // The child needs its own process page. Without memory, it will see the ids of the parent.
+                mapInfoPages(process->memory.mem, &info);
+            }
             // Copy files
             forkFileDescriptors(process, parent);
         } else {
@@ -242,6 +269,9 @@ Process* createUserProcess(Process* parent) {
             process->resources.cwd = stringClone("/");
         }
         registerProcess(process);
+        if (info != NULL) {
+            attachProcessInfo(process, info);
+        }
     }
     return process;
 }
@@ -250,6 +280,7 @@ Task* createTaskInProcess(Process* process, uintptr_t sp, uintptr_t gp, uintptr_
     Task* task = createTask();
     if (task != NULL) {
         task->process = process;
+        task->tid = process->pid;
         task->sched.priority = priority;
         moveTaskToState(task, ENQUABLE);
         initTrapFrame(&task->frame, sp, gp, pc, process->pid, process->memory.mem);
@@ -269,17 +300,33 @@ void addTaskToProcess(Process* process, Task* task) {
 static void processFinalizeTask(Process* process) {
     // This must be a task because it might include blocking operations.
     unregisterProcess(process);
+    releaseProcessRing(process);
     closeAllProcessFiles(process);
     if (process->pid != 0) {
+        detachProcessInfo(process);
         deallocMemorySpace(process->memory.mem);
     }
+    while (process->exited_threads != NULL) {
+        ExitedThread* thread = process->exited_threads;
+        process->exited_threads = thread->next;
+        dealloc(thread);
+    }
     dealloc(process);
     leave();
 }
 
+void updateProcessMaxRss(Process* process) {
+    if (process->pid != 0 && process->memory.mem != NULL) {
+        size_t rss = countResidentPages(process->memory.mem);
+        if (rss > process->memory.max_rss) {
+            process->memory.max_rss = rss;
+        }
+    }
+}
+
 void deallocProcess(Process* process) {
     if (getCurrentTask() == NULL) {
-        Task* syscall_task = createKernelTask(processFinalizeTask, HART_STACK_SIZE, DEFAULT_PRIORITY - 10);
+        Task* syscall_task = createKernelTask(processFinalizeTask, HART_STACK_SIZE, DEFAULT_PRIORITY - 10, "process finalize");
         syscall_task->frame.regs[REG_ARGUMENT_0] = (uintptr_t)process;
         enqueueTask(syscall_task);
     } else {
@@ -306,12 +353,29 @@ static void moveAllProcessTasksToStateBut(Process* process, TaskState state, Tas
 
 void terminateAllProcessTasksBut(Process* process, Task* keep) {
     moveAllProcessTasksToStateBut(process, TERMINATED, keep);
+    // The memory is about to be replaced, so the thread ids must not be cleared in it anymore
+    lockSpinLock(&process->lock);
+    Task* current = process->tasks;
+    while (current != NULL) {
+        current->clear_tid = 0;
+        current = current->proc_next;
+    }
+    unlockSpinLock(&process->lock);
 }
 
 void terminateAllProcessTasks(Process* process) {
     moveAllProcessTasksToStateBut(process, TERMINATED, NULL);
 }
 
+static void awakenThreadJoiners(Task* joining) {
+    while (joining != NULL) {
+        Task* next = joining->sched.locks_next;
+        awakenTask(joining);
+        enqueueTask(joining);
+        joining = next;
+    }
+}
+
 void exitProcess(Process* process, Signal signal, int exit) {
     lockSpinLock(&process->lock);
     if (signal == SIGNONE) {
@@ -321,6 +385,12 @@ void exitProcess(Process* process, Signal signal, int exit) {
     }
     unlockSpinLock(&process->lock);
     terminateAllProcessTasks(process);
+    // The joining tasks must notice that they have been terminated
+    lockSpinLock(&process->lock);
+    Task* joining = process->joining;
+    process->joining = NULL;
+    unlockSpinLock(&process->lock);
+    awakenThreadJoiners(joining);
 }
 
 void stopProcess(Process* process, Signal signal) {
@@ -349,10 +419,147 @@ void continueProcess(Process* process, Signal signal) {
     unlockSpinLock(&process->lock);
 }
 
+Task* createThreadInProcess(Task* task, uintptr_t sp) {
+    Process* process = task->process;
+    Task* new_task = createTaskInProcess(
+        process, sp, task->frame.regs[REG_GLOBAL_POINTER], task->frame.pc, task->sched.priority
+    );
+    if (new_task != NULL) {
+        memcpy(&new_task->frame.regs, &task->frame.regs, sizeof(task->frame.regs));
+        memcpy(&new_task->frame.fregs, &task->frame.fregs, sizeof(task->frame.fregs));
+        new_task->frame.regs[REG_STACK_POINTER] = sp;
+        new_task->tid = allocateNewPid();
+        new_task->signals.mask = task->signals.mask;
+        inheritSchedParams(new_task, task);
+        // If the process started exiting while we were adding the thread, it must exit too
+        lockSpinLock(&process->lock);
+        bool terminated = task->sched.state == TERMINATED;
+        unlockSpinLock(&process->lock);
+        if (terminated) {
+            moveTaskToState(new_task, TERMINATED);
+        }
+    }
+    return new_task;
+}
+
+void exitProcessThread(Task* task, uintptr_t value) {
+    Process* process = task->process;
+    ExitedThread* thread = kalloc(sizeof(ExitedThread));
+    lockSpinLock(&process->lock);
+    if (process->tasks == task && task->proc_next == NULL) {
+        // This is the last thread, so the process exits
+        unlockSpinLock(&process->lock);
+        dealloc(thread);
+        exitProcess(process, SIGNONE, value);
+    } else {
+        if (thread != NULL) {
+            thread->tid = task->tid;
+            thread->value = value;
+            thread->next = process->exited_threads;
+            process->exited_threads = thread;
+            process->exited_thread_count++;
+            if (process->exited_thread_count > MAX_EXITED_THREADS) {
+                // Nobody is going to join the oldest threads, forget them
+                ExitedThread* last = thread;
+                for (size_t i = 1; i < MAX_EXITED_THREADS; i++) {
+                    last = last->next;
+                }
+                dealloc(last->next);
+                last->next = NULL;
+                process->exited_thread_count--;
+            }
+        }
+        Task* joining = process->joining;
+        process->joining = NULL;
+        unlockSpinLock(&process->lock);
+        moveTaskToState(task, TERMINATED);
+        awakenThreadJoiners(joining);
+    }
+}
+
+static bool hasThreadWithId(Process* process, Pid tid) {
+    Task* current = process->tasks;
+    while (current != NULL) {
+        if (current->tid == tid) {
+            return true;
+        }
+        current = current->proc_next;
+    }
+    return false;
+}
+
+static void waitForThreadExit(void* _, Task* task, Process* process) {
+    task->sched.wakeup_function = NULL;
+    moveTaskToState(task, WAITING);
+    traceSchedEvent(SCHED_TRACE_BLOCK, task, SCHED_TRACE_BLOCK_IO);
+    task->usage.voluntary_switches++;
+    enqueueTask(task);
+    task->sched.locks_next = process->joining;
+    process->joining = task;
+    unlockSpinLock(&process->lock);
+    runNextTask();
+}
+
+Error joinProcessThread(Task* task, Pid tid, uintptr_t* value) {
+    Process* process = task->process;
+    for (;;) {
+        Task* self = criticalEnter();
+        assert(self != NULL);
+        lockSpinLock(&process->lock);
+        ExitedThread** current = &process->exited_threads;
+        while (*current != NULL) {
+            ExitedThread* thread = *current;
+            if (thread->tid == tid) {
+                *current = thread->next;
+                process->exited_thread_count--;
+                unlockSpinLock(&process->lock);
+                criticalReturn(self);
+                *value = thread->value;
+                dealloc(thread);
+                return simpleError(SUCCESS);
+            }
+            current = &thread->next;
+        }
+        if (!hasThreadWithId(process, tid) || task->sched.state == TERMINATED) {
+            unlockSpinLock(&process->lock);
+            criticalReturn(self);
+            return simpleError(ESRCH);
+        } else if (saveToFrame(&self->frame)) {
+            // Woken by exitProcessThread or exitProcess
+            callInHart((void*)waitForThreadExit, self, process);
+        }
+    }
+}
+
+void flushProcessTlb(Process* process) {
+    lockSpinLock(&process->lock);
+    bool threaded = process->tasks != NULL && process->tasks->proc_next != NULL;
+    unlockSpinLock(&process->lock);
+    if (threaded) {
+        // Returning from the interrupt flushes the TLB of the other harts
+        sendMessageToAll(FLUSH_TLB, process);
+    }
+}
+
+// Must be called with the process lock held, so the memory is not replaced concurrently
+static void clearThreadId(Task* task) {
+    if (task->clear_tid != 0) {
+        Process* process = task->process;
+        int zero = 0;
+        if (!isError(copyToUser(process->memory.mem, task->clear_tid, &zero, sizeof(int)))) {
+            size_t woken;
+            futexWake(process, task->clear_tid, 1, &woken);
+        }
+        task->clear_tid = 0;
+    }
+}
+
 void removeProcessTask(Task* task) {
     assert(task->process != NULL);
     Process* process = task->process;
     lockSpinLock(&process->lock);
+    // This also wakes threads joining through the futex if the thread was killed
+    clearThreadId(task);
     Task** curr = &process->tasks;
     while (*curr != NULL) {
         if (*curr == task) {
@@ -365,6 +572,8 @@ void removeProcessTask(Task* task) {
     process->times.system_time += task->times.system_time;
     process->times.user_child_time += task->times.user_child_time;
     process->times.system_child_time += task->times.system_child_time;
+    addTaskUsage(&process->usage, &task->usage);
+    addTaskUsage(&process->child_usage, &task->child_usage);
     task->process = NULL;
     if (process->tasks == NULL) {
         if (process->tree.parent == NULL) {
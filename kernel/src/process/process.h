@@ -17,6 +17,21 @@ Task* createTaskInProcess(Process* process, uintptr_t sp, uintptr_t gp, uintptr_
 
 void addTaskToProcess(Process* process, Task* task);
 
+Pid allocateNewPid();
+
+// Create a new thread sharing the process of task, starting with a copy of its registers
+Task* createThreadInProcess(Task* task, uintptr_t sp);
+
+// Terminate only the given thread, or the whole process if it is the last one
+void exitProcessThread(Task* task, uintptr_t value);
+
+// Wait for the thread with the given id to exit and return its exit value. Must be called from the
+// syscall task of the given task. Returns ESRCH if there is no such thread.
+Error joinProcessThread(Task* task, Pid tid, uintptr_t* value);
+
+// Make sure other harts don't use stale translations after changing the mappings of the process
+void flushProcessTlb(Process* process);
+
 void terminateAllProcessTasks(Process* process);
 
 void terminateAllProcessTasksBut(Process* process, Task* keep);
@@ -27,6 +42,9 @@ void removeProcessTask(Task* task);
 
 bool shouldTaskWakeup(Task* task);
 
+// Sample the resident set size. Must be called with the memory lock held, or without running tasks.
+void updateProcessMaxRss(Process* process);
+
 void deallocProcess(Process* process);
 
 void exitProcess(Process* process, Signal signal, int exit);
@@ -3,6 +3,7 @@
 
 #include "interrupt/timer.h"
 
+#include "process/futex.h"
 #include "process/process.h"
 #include "process/signals.h"
 #include "error/log.h"
@@ -46,6 +47,7 @@ void addSignalToProcess(Process* process, Signal signal, Pid child_pid) {
             process->signals.signals_tail = entry;
         }
         unlockSpinLock(&process->lock);
+        interruptFutexWaits(process);
     }
 }
 
@@ -105,18 +107,18 @@ static bool handleActualSignal(Task* task, Signal signal) {
         // Before these values that will be restored, we can but some other data
         PUSH_TO_VIRTPTR(stack_pointer, info);
         VirtPtr info_address = stack_pointer;
-        PUSH_TO_VIRTPTR(stack_pointer, task->process->signals.mask);
-        PUSH_TO_VIRTPTR(stack_pointer, task->process->signals.restore_frame);
-        PUSH_TO_VIRTPTR(stack_pointer, task->process->signals.current_signal);
+        PUSH_TO_VIRTPTR(stack_pointer, task->signals.mask);
+        PUSH_TO_VIRTPTR(stack_pointer, task->signals.restore_frame);
+        PUSH_TO_VIRTPTR(stack_pointer, task->signals.current_signal);
         PUSH_TO_VIRTPTR(stack_pointer, task->frame.pc);
         PUSH_TO_VIRTPTR(stack_pointer, task->frame.fregs);
         PUSH_TO_VIRTPTR(stack_pointer, task->frame.regs);
-        task->process->signals.mask |= action->mask;
+        task->signals.mask |= action->mask;
         if ((action->flags & SA_NODEFER) != 0) {
-            task->process->signals.mask |= 1UL << (signal - 1);
+            task->signals.mask |= 1UL << (signal - 1);
         }
-        task->process->signals.restore_frame = stack_pointer.address;
-        task->process->signals.current_signal = signal;
+        task->signals.restore_frame = stack_pointer.address;
+        task->signals.current_signal = signal;
         task->frame.pc = action->handler;
         // Set argument to signal type
         task->frame.regs[REG_ARGUMENT_0] = signal;
@@ -141,7 +143,7 @@ static Signal getSignalToHandle(Task* task) {
         Signal signal = (*current)->signal;
         if (
             signal == SIGKILL || signal == SIGSTOP
-            || (task->process->signals.mask & (1UL << (signal - 1))) == 0
+            || (task->signals.mask & (1UL << (signal - 1))) == 0
         ) {
             PendingSignal* pending = *current;
             *current = pending->next;
@@ -174,19 +176,20 @@ bool handlePendingSignals(Task* task) {
 
 void returnFromSignal(Task* task) {
     lockSpinLock(&task->process->lock);
-    if (task->process->signals.current_signal != SIGNONE) {
-        VirtPtr stack_pointer = virtPtrForTask(task->process->signals.restore_frame, task);
+    if (task->signals.current_signal != SIGNONE) {
+        VirtPtr stack_pointer = virtPtrForTask(task->signals.restore_frame, task);
         POP_FROM_VIRTPTR(stack_pointer, task->frame.regs);
         POP_FROM_VIRTPTR(stack_pointer, task->frame.fregs);
         POP_FROM_VIRTPTR(stack_pointer, task->frame.pc);
-        POP_FROM_VIRTPTR(stack_pointer, task->process->signals.current_signal);
-        POP_FROM_VIRTPTR(stack_pointer, task->process->signals.restore_frame);
-        POP_FROM_VIRTPTR(stack_pointer, task->process->signals.mask);
+        POP_FROM_VIRTPTR(stack_pointer, task->signals.current_signal);
+        POP_FROM_VIRTPTR(stack_pointer, task->signals.restore_frame);
+        POP_FROM_VIRTPTR(stack_pointer, task->signals.mask);
     } // If we are not in a handle do nothing
     unlockSpinLock(&task->process->lock);
 }
 
-void clearSignals(Process* process) {
+void clearSignals(Task* task) {
+    Process* process = task->process;
     lockSpinLock(&process->lock);
     while (process->signals.signals != NULL) {
         PendingSignal* signal = process->signals.signals;
@@ -195,8 +198,8 @@ void clearSignals(Process* process) {
     }
     process->signals.signals_tail = NULL;
     process->signals.altstack = 0;
-    process->signals.current_signal = 0;
-    process->signals.restore_frame = 0;
+    task->signals.current_signal = 0;
+    task->signals.restore_frame = 0;
     for (size_t i = 0; i < SIG_COUNT; i++) {
         process->signals.handlers[i].flags = 0;
         if (process->signals.handlers[i].handler != SIG_IGN) {
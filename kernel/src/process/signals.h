@@ -13,7 +13,7 @@ bool handlePendingSignals(Task* task);
 
 void returnFromSignal(Task* process);
 
-void clearSignals(Process* process);
+void clearSignals(Task* task);
 
 void clearPendingChildSignals(Process* process, Pid child_pid);
 
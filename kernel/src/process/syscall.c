@@ -7,8 +7,11 @@
 #include "interrupt/syscall.h"
 #include "interrupt/timer.h"
 #include "memory/kalloc.h"
+#include "memory/usercopy.h"
 #include "memory/virtmem.h"
 #include "memory/virtptr.h"
+#include "process/futex.h"
+#include "process/infopage.h"
 #include "process/process.h"
 #include "process/signals.h"
 #include "process/syscall.h"
@@ -27,13 +30,18 @@ SyscallReturn forkSyscall(TrapFrame* frame) {
         Priority priority = DEFAULT_PRIORITY;
         size_t stack_size = HART_STACK_SIZE;
         uintptr_t old_stack_top;
+        const char* name = "kernel fork";
         if (frame->hart == NULL) {
             old_stack_top = ((HartFrame*)frame)->stack_top;
         } else {
             priority = task->sched.priority;
             old_stack_top = task->stack_top;
+            name = task->name;
+        }
+        Task* new_task = createKernelTask((void*)frame->pc, stack_size, priority, name);
+        if (frame->hart != NULL) {
+            inheritSchedParams(new_task, task);
         }
-        Task* new_task = createKernelTask((void*)frame->pc, stack_size, priority);
         // Copy registers
         memcpy(&new_task->frame, frame, sizeof(TrapFrame));
         // Copy stack
@@ -62,6 +70,8 @@ SyscallReturn forkSyscall(TrapFrame* frame) {
             memcpy(&new_task->frame.regs, &task->frame.regs, sizeof(task->frame.regs));
             memcpy(&new_task->frame.fregs, &task->frame.fregs, sizeof(task->frame.fregs));
             new_task->frame.regs[REG_ARGUMENT_0] = 0;
+            new_task->signals = task->signals;
+            inheritSchedParams(new_task, task);
             enqueueTask(new_task);
             SYSCALL_RETURN(new_process->pid);
         } else {
@@ -83,6 +93,133 @@ SyscallReturn exitSyscall(TrapFrame* frame) {
     return WAIT;
 }
 
+#define CLONE_VM 0x00000100
+#define CLONE_FS 0x00000200
+#define CLONE_FILES 0x00000400
+#define CLONE_SIGHAND 0x00000800
+#define CLONE_THREAD 0x00010000
+#define CLONE_SETTLS 0x00080000
+#define CLONE_PARENT_SETTID 0x00100000
+#define CLONE_CHILD_CLEARTID 0x00200000
+#define CLONE_CHILD_SETTID 0x01000000
+
+// A process has exactly one memory space, file table and set of signal handlers. So we can only
+// create threads that share all of them.
+#define CLONE_THREAD_FLAGS (CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SIGHAND | CLONE_THREAD)
+
+SyscallReturn cloneSyscall(TrapFrame* frame) {
+    assert(frame->hart != NULL);
+    Task* task = (Task*)frame;
+    assert(task->process != NULL);
+    uintptr_t flags = SYSCALL_ARG(0);
+    uintptr_t stack = SYSCALL_ARG(1);
+    uintptr_t parent_tid = SYSCALL_ARG(2);
+    uintptr_t tls = SYSCALL_ARG(3);
+    uintptr_t child_tid = SYSCALL_ARG(4);
+    if ((flags & CLONE_THREAD_FLAGS) != CLONE_THREAD_FLAGS) {
+        SYSCALL_RETURN(-EINVAL);
+    }
+    Task* new_task = createThreadInProcess(task, stack != 0 ? stack : task->frame.regs[REG_STACK_POINTER]);
+    if (new_task == NULL) {
+        SYSCALL_RETURN(-ENOMEM);
+    }
+    new_task->frame.regs[REG_ARGUMENT_0] = 0;
+    if ((flags & CLONE_SETTLS) != 0) {
+        new_task->frame.regs[REG_THREAD_POINTER] = tls;
+    }
+    if ((flags & CLONE_CHILD_CLEARTID) != 0) {
+        new_task->clear_tid = child_tid;
+    }
+    int tid = new_task->tid;
+    if ((flags & CLONE_PARENT_SETTID) != 0) {
+        copyToUser(task->process->memory.mem, parent_tid, &tid, sizeof(int));
+    }
+    if ((flags & CLONE_CHILD_SETTID) != 0) {
+        copyToUser(task->process->memory.mem, child_tid, &tid, sizeof(int));
+    }
+    enqueueTask(new_task);
+    SYSCALL_RETURN(tid);
+}
+
+SyscallReturn gettidSyscall(TrapFrame* frame) {
+    assert(frame->hart != NULL);
+    Task* task = (Task*)frame;
+    SYSCALL_RETURN(task->tid);
+}
+
+SyscallReturn threadExitSyscall(TrapFrame* frame) {
+    assert(frame->hart != NULL);
+    Task* task = (Task*)frame;
+    assert(task->process != NULL);
+    // The thread id is cleared when the task is freed
+    exitProcessThread(task, SYSCALL_ARG(0));
+    enqueueTask(task);
+    return WAIT;
+}
+
+SyscallReturn threadJoinSyscall(TrapFrame* frame) {
+    assert(frame->hart != NULL);
+    Task* task = (Task*)frame;
+    assert(task->process != NULL);
+    if ((int)SYSCALL_ARG(0) == task->tid) {
+        SYSCALL_RETURN(-EDEADLK);
+    }
+    uintptr_t value;
+    Error err = joinProcessThread(task, SYSCALL_ARG(0), &value);
+    if (isError(err)) {
+        SYSCALL_RETURN(-err.kind);
+    }
+    if (SYSCALL_ARG(1) != 0) {
+        err = copyToUser(task->process->memory.mem, SYSCALL_ARG(1), &value, sizeof(uintptr_t));
+    }
+    SYSCALL_RETURN(-err.kind);
+}
+
+#define FUTEX_WAIT 0
+#define FUTEX_WAKE 1
+#define FUTEX_REQUEUE 3
+#define FUTEX_CMP_REQUEUE 4
+#define FUTEX_PRIVATE_FLAG 128
+
+// This is a sync syscall, executed directly in the trap handler without a syscall task.
+SyscallReturn futexSyscall(TrapFrame* frame) {
+    assert(frame->hart != NULL);
+    Task* task = (Task*)frame;
+    assert(task->process != NULL);
+    uintptr_t addr = SYSCALL_ARG(0);
+    int op = SYSCALL_ARG(1) & ~FUTEX_PRIVATE_FLAG;
+    int32_t value = SYSCALL_ARG(2);
+    uintptr_t arg = SYSCALL_ARG(3); // Timeout in nanoseconds or number of tasks to requeue
+    uintptr_t addr2 = SYSCALL_ARG(4);
+    int32_t value3 = SYSCALL_ARG(5);
+    size_t woken = 0;
+    Error err;
+    switch (op) {
+        case FUTEX_WAIT: {
+            Time timeout = arg == 0 ? 0 : umax(1, arg / (1000000000UL / CLOCKS_PER_SEC));
+            futexWait(task, addr, value, timeout);
+            return CONTINUE;
+        }
+        case FUTEX_WAKE:
+            err = futexWake(task->process, addr, value, &woken);
+            break;
+        case FUTEX_REQUEUE:
+            err = futexRequeue(task->process, addr, value, addr2, arg, false, 0, &woken);
+            break;
+        case FUTEX_CMP_REQUEUE:
+            err = futexRequeue(task->process, addr, value, addr2, arg, true, value3, &woken);
+            break;
+        default:
+            err = simpleError(EINVAL);
+            break;
+    }
+    if (isError(err)) {
+        SYSCALL_RETURN(-err.kind);
+    } else {
+        SYSCALL_RETURN(woken);
+    }
+}
+
 static bool handlePauseWakeup(Task* task, void* _) {
     lockSpinLock(&task->process->lock); 
     if (task->process->signals.signals != NULL) {
@@ -101,6 +238,7 @@ SyscallReturn pauseSyscall(TrapFrame* frame) {
     task->frame.regs[REG_ARGUMENT_0] = -EINTR; // This is the only possible return value.
     lockSpinLock(&task->sched.lock); 
     task->sched.wakeup_function = handlePauseWakeup;
+    task->usage.voluntary_switches++;
     unlockSpinLock(&task->sched.lock); 
     return WAIT;
 }
@@ -197,7 +335,7 @@ SyscallReturn sigpendingSyscall(TrapFrame* frame) {
         set |= (1UL << (current->signal - 1));
         current = current->next;
     }
-    SYSCALL_RETURN(set & task->process->signals.mask);
+    SYSCALL_RETURN(set & task->signals.mask);
 }
 
 typedef enum {
@@ -210,15 +348,15 @@ SyscallReturn sigprocmaskSyscall(TrapFrame* frame) {
     assert(frame->hart != NULL);
     Task* task = (Task*)frame;
     assert(task->process != NULL);
-    SignalSet old = task->process->signals.mask;
+    SignalSet old = task->signals.mask;
     SigProcHow how = SYSCALL_ARG(0);
     SignalSet new = SYSCALL_ARG(1);
     if (how == SIG_SETMASK) {
-        task->process->signals.mask = new;
+        task->signals.mask = new;
     } else if (how == SIG_BLOCK) {
-        task->process->signals.mask |= new;
+        task->signals.mask |= new;
     } else if (how == SIG_UNBLOCK) {
-        task->process->signals.mask &= ~new;
+        task->signals.mask &= ~new;
     }
     SYSCALL_RETURN(old);
 }
@@ -298,10 +436,12 @@ SyscallReturn setUidSyscall(TrapFrame* frame) {
         task->process->user.suid = new_uid;
         task->process->user.euid = new_uid;
         unlockSpinLock(&task->process->user.lock);
+        updateProcessInfo(task->process);
         SYSCALL_RETURN(-SUCCESS);
     } else if (task->process->user.ruid == new_uid || task->process->user.suid == new_uid) {
         task->process->user.euid = new_uid;
         unlockSpinLock(&task->process->user.lock);
+        updateProcessInfo(task->process);
         SYSCALL_RETURN(-SUCCESS);
     } else {
         unlockSpinLock(&task->process->user.lock);
@@ -320,10 +460,12 @@ SyscallReturn setGidSyscall(TrapFrame* frame) {
         task->process->user.sgid = new_gid;
         task->process->user.egid = new_gid;
         unlockSpinLock(&task->process->user.lock);
+        updateProcessInfo(task->process);
         SYSCALL_RETURN(-SUCCESS);
     } else if (task->process->user.rgid == new_gid || task->process->user.sgid == new_gid) {
         task->process->user.egid = new_gid;
         unlockSpinLock(&task->process->user.lock);
+        updateProcessInfo(task->process);
         SYSCALL_RETURN(-SUCCESS);
     } else {
         unlockSpinLock(&task->process->user.lock);
@@ -380,6 +522,7 @@ SyscallReturn setEUidSyscall(TrapFrame* frame) {
     if (task->process->user.euid == 0 || task->process->user.ruid == new_uid || task->process->user.suid == new_uid) {
         task->process->user.euid = new_uid;
         unlockSpinLock(&task->process->user.lock);
+        updateProcessInfo(task->process);
         SYSCALL_RETURN(-SUCCESS);
     } else {
         unlockSpinLock(&task->process->user.lock);
@@ -396,6 +539,7 @@ SyscallReturn setEGidSyscall(TrapFrame* frame) {
     if (task->process->user.euid == 0 || task->process->user.rgid == new_gid || task->process->user.sgid == new_gid) {
         task->process->user.egid = new_gid;
         unlockSpinLock(&task->process->user.lock);
+        updateProcessInfo(task->process);
         SYSCALL_RETURN(-SUCCESS);
     } else {
         unlockSpinLock(&task->process->user.lock);
@@ -428,6 +572,7 @@ SyscallReturn setREUidSyscall(TrapFrame* frame) {
             task->process->user.suid = task->process->user.euid;
         }
         unlockSpinLock(&task->process->user.lock);
+        updateProcessInfo(task->process);
         SYSCALL_RETURN(-SUCCESS);
     } else {
         unlockSpinLock(&task->process->user.lock);
@@ -460,6 +605,7 @@ SyscallReturn setREGidSyscall(TrapFrame* frame) {
             task->process->user.sgid = task->process->user.egid;
         }
         unlockSpinLock(&task->process->user.lock);
+        updateProcessInfo(task->process);
         SYSCALL_RETURN(-SUCCESS);
     } else {
         unlockSpinLock(&task->process->user.lock);
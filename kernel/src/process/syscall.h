@@ -7,6 +7,16 @@ SyscallReturn forkSyscall(TrapFrame* frame);
 
 SyscallReturn exitSyscall(TrapFrame* frame);
 
+SyscallReturn cloneSyscall(TrapFrame* frame);
+
+SyscallReturn gettidSyscall(TrapFrame* frame);
+
+SyscallReturn threadExitSyscall(TrapFrame* frame);
+
+SyscallReturn threadJoinSyscall(TrapFrame* frame);
+
+SyscallReturn futexSyscall(TrapFrame* frame);
+
 SyscallReturn pauseSyscall(TrapFrame* frame);
 
 SyscallReturn alarmSyscall(TrapFrame* frame);
@@ -18,12 +18,16 @@ typedef struct {
     MemorySpace* mem;
     uintptr_t start_brk;
     uintptr_t brk;
+    size_t max_rss; // Peak number of resident pages, updated before the mappings shrink
+    struct ProcessInfo_s* info; // Process page mapped at PROCESS_INFO_ADDR
+    TaskLock lock; // Serializes changes to the mappings between threads
 } ProcessMemory;
 
 typedef struct {
     VfsMode umask;
     VfsFileDescriptor* files;
     char* cwd;
+    struct IoRing_s* ring; // Submission ring, see files/ring.h
     TaskLock lock;
 } ProcessResources;
 
@@ -116,13 +120,16 @@ typedef struct {
     PendingSignal* signals;
     PendingSignal* signals_tail;
     SignalHandler handlers[SIG_COUNT];
-    Signal current_signal;
-    uintptr_t restore_frame;
     Time alarm_at;
     uintptr_t altstack;
-    SignalSet mask;
 } ProcessSignals;
 
+typedef struct ExitedThread_s {
+    struct ExitedThread_s* next;
+    Pid tid;
+    uintptr_t value;
+} ExitedThread;
+
 typedef struct Process_s {
     SpinLock lock;
     Pid pid;
@@ -131,11 +138,17 @@ typedef struct Process_s {
     int status; // This is the status returned from wait
     Task* tasks;
     TaskTimes times;
+    TaskUsage usage;
+    TaskUsage child_usage;
+    size_t child_max_rss; // Largest max_rss of all waited for children and their children
     ProcessUser user;
     ProcessTree tree;
     ProcessMemory memory;
     ProcessResources resources;
     ProcessSignals signals;
+    ExitedThread* exited_threads; // Threads that exited but have not been joined
+    size_t exited_thread_count;
+    Task* joining; // Syscall tasks waiting in joinProcessThread, linked by sched.locks_next
 } Process;
 
 #endif
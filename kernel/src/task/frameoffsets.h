@@ -0,0 +1,12 @@
+#ifndef _FRAMEOFFSETS_H_
+#define _FRAMEOFFSETS_H_
+
+// Offsets into TrapFrame and HartFrame for use in assembly. They are checked against the structs
+// in task/types.h by static assertions in memory/usercopy.c.
+
+#define TRAP_FRAME_SP 16           // frame.regs[REG_STACK_POINTER]
+#define TRAP_FRAME_PC 512          // frame.pc
+#define TRAP_FRAME_SATP 520        // frame.satp
+#define HART_FRAME_STACK_TOP 528   // stack_top
+
+#endif
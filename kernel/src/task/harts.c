@@ -7,6 +7,7 @@
 #include "task/task.h"
 #include "util/unsafelock.h"
 #include "memory/kalloc.h"
+#include "memory/kstack.h"
 #include "memory/virtmem.h"
 
 extern char __global_pointer[];
@@ -21,8 +22,6 @@ static void idle() {
     }
 }
 
-#define MAX_HART_COUNT 32
-
 int hart_count = 1;
 int hart_ids[MAX_HART_COUNT];
 
@@ -41,9 +40,9 @@ HartFrame* setupHartFrame(int hartid) {
     assert(existing == NULL);
 #endif
     HartFrame* hart = zalloc(sizeof(HartFrame));
-    hart->stack_top = (uintptr_t)kalloc(HART_STACK_SIZE) + HART_STACK_SIZE;
+    hart->stack_top = (uintptr_t)allocKernelStack() + HART_STACK_SIZE;
     initKernelTrapFrame(&hart->frame, hart->stack_top, 0);
-    hart->idle_task = createKernelTask(idle, IDLE_STACK_SIZE, LOWEST_PRIORITY); // Every hart needs an idle process
+    hart->idle_task = createKernelTask(idle, IDLE_STACK_SIZE, LOWEST_PRIORITY, "idle"); // Every hart needs an idle process
     hart->hartid = hartid;
     writeSscratch(&hart->frame);
     lockUnsafeLock(&hart_lock); 
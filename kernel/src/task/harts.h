@@ -3,10 +3,12 @@
 
 #include <stdnoreturn.h>
 
+#include "memory/kstack.h"
 #include "task/types.h"
 
-#define HART_STACK_SIZE (1 << 16)
+#define HART_STACK_SIZE KERNEL_STACK_SIZE
 #define IDLE_STACK_SIZE 64
+#define MAX_HART_COUNT 32
 
 extern int hart_count;
 extern int hart_ids[];
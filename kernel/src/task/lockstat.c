@@ -0,0 +1,98 @@
+
+#include "task/lockstat.h"
+
+#include "util/util.h"
+
+static LockStatEntry lock_stats[LOCK_STAT_SLOTS];
+static size_t lock_stats_dropped;
+
+#ifdef LOCK_STATS
+// This is used from inside lockSpinLock, so it can not use any locks itself.
+
+LockStatEntry* getLockStatEntry(LockStatKind kind, void* lock, uintptr_t caller) {
+    size_t start = hashCombine(hashInt64((uintptr_t)lock), hashInt64(caller)) % LOCK_STAT_SLOTS;
+    size_t idx = start;
+    do {
+        LockStatEntry* entry = &lock_stats[idx];
+        int state = __atomic_load_n(&entry->state, __ATOMIC_ACQUIRE);
+        if (state == 0) {
+            if (__atomic_compare_exchange_n(&entry->state, &state, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                entry->kind = kind;
+                entry->lock = (uintptr_t)lock;
+                entry->caller = caller;
+                __atomic_store_n(&entry->state, 2, __ATOMIC_RELEASE);
+                return entry;
+            }
+        }
+        while (state == 1) {
+            // Someone else is claiming this slot right now.
+            state = __atomic_load_n(&entry->state, __ATOMIC_ACQUIRE);
+        }
+        if (entry->lock == (uintptr_t)lock && entry->caller == caller) {
+            return entry;
+        }
+        idx = (idx + 1) % LOCK_STAT_SLOTS;
+    } while (idx != start);
+    __atomic_fetch_add(&lock_stats_dropped, 1, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+static void updateMaximum(uint64_t* max, uint64_t value) {
+    uint64_t old = __atomic_load_n(max, __ATOMIC_RELAXED);
+    while (old < value && !__atomic_compare_exchange_n(max, &old, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+void recordLockAcquired(LockStatEntry* entry, bool contended, uint64_t wait) {
+    if (entry != NULL) {
+        __atomic_fetch_add(&entry->acquired, 1, __ATOMIC_RELAXED);
+        if (contended) {
+            __atomic_fetch_add(&entry->contended, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&entry->wait_total, wait, __ATOMIC_RELAXED);
+            updateMaximum(&entry->wait_max, wait);
+        }
+    }
+}
+
+void recordLockSpun(LockStatEntry* entry) {
+    if (entry != NULL) {
+        __atomic_fetch_add(&entry->spun, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void recordLockReleased(LockStatEntry* entry, uint64_t hold) {
+    if (entry != NULL) {
+        updateMaximum(&entry->hold_max, hold);
+    }
+}
+#endif
+
+void getLockStats(LockStats* stats) {
+    stats->count = 0;
+    stats->dropped = lock_stats_dropped;
+    for (size_t i = 0; i < LOCK_STAT_SLOTS; i++) {
+        if (__atomic_load_n(&lock_stats[i].state, __ATOMIC_ACQUIRE) == 2) {
+            // Insertion sort by total wait time. The table is small, and this is not hot.
+            LockStatEntry entry = lock_stats[i];
+            size_t j = stats->count;
+            while (j > 0 && stats->entries[j - 1].wait_total < entry.wait_total) {
+                stats->entries[j] = stats->entries[j - 1];
+                j--;
+            }
+            stats->entries[j] = entry;
+            stats->count++;
+        }
+    }
+}
+
+void resetLockStats() {
+    for (size_t i = 0; i < LOCK_STAT_SLOTS; i++) {
+        LockStatEntry* entry = &lock_stats[i];
+        __atomic_store_n(&entry->acquired, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&entry->contended, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&entry->spun, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&entry->wait_total, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&entry->wait_max, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&entry->hold_max, 0, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&lock_stats_dropped, 0, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,56 @@
+#ifndef _LOCKSTAT_H_
+#define _LOCKSTAT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Lock statistics are only collected if the kernel is built with LOCK_STATS defined. Statistics
+// are kept per lock instance and acquiring call site. Times are in cycles for spin locks and in
+// timer ticks for task locks, because tasks can migrate between harts while waiting.
+
+#define LOCK_STAT_SLOTS 512
+
+typedef enum {
+    LOCK_STAT_SPIN,
+    LOCK_STAT_TASK,
+} LockStatKind;
+
+typedef struct LockStatEntry_s {
+    int state;          // 0 if unused, 1 while being claimed, 2 once lock and caller are valid
+    LockStatKind kind;
+    uintptr_t lock;
+    uintptr_t caller;
+    size_t acquired;
+    size_t contended;
+    size_t spun;        // Contended acquisitions of task locks that succeeded without sleeping
+    uint64_t wait_total;
+    uint64_t wait_max;
+    uint64_t hold_max;
+} LockStatEntry;
+
+typedef struct {
+    LockStatEntry entries[LOCK_STAT_SLOTS];
+    size_t count;
+    size_t dropped; // Acquisitions that found no free slot
+} LockStats;
+
+#ifdef LOCK_STATS
+// Find or create the entry for the given lock and call site. Returns NULL if the table is full.
+LockStatEntry* getLockStatEntry(LockStatKind kind, void* lock, uintptr_t caller);
+
+void recordLockAcquired(LockStatEntry* entry, bool contended, uint64_t wait);
+
+// The task lock was acquired by spinning while its owner was running
+void recordLockSpun(LockStatEntry* entry);
+
+void recordLockReleased(LockStatEntry* entry, uint64_t hold);
+#endif
+
+// Copy the statistics of all entries into stats, sorted by decreasing total wait time
+void getLockStats(LockStats* stats);
+
+// Clear all counters. Slots stay assigned, because held locks might still reference them.
+void resetLockStats();
+
+#endif
@@ -0,0 +1,49 @@
+
+#include "task/pollqueue.h"
+
+void initPollQueue(PollQueue* queue) {
+    initSpinLock(&queue->lock);
+    queue->waiters = NULL;
+}
+
+void addPollWaiter(PollQueue* queue, PollWaiter* waiter, PollWakeFunction function, void* udata) {
+    waiter->queue = queue;
+    waiter->function = function;
+    waiter->udata = udata;
+    waiter->prev = NULL;
+    lockSpinLock(&queue->lock);
+    waiter->next = queue->waiters;
+    if (queue->waiters != NULL) {
+        queue->waiters->prev = waiter;
+    }
+    queue->waiters = waiter;
+    unlockSpinLock(&queue->lock);
+}
+
+void removePollWaiter(PollWaiter* waiter) {
+    PollQueue* queue = waiter->queue;
+    if (queue != NULL) {
+        lockSpinLock(&queue->lock);
+        if (waiter->prev != NULL) {
+            waiter->prev->next = waiter->next;
+        } else {
+            queue->waiters = waiter->next;
+        }
+        if (waiter->next != NULL) {
+            waiter->next->prev = waiter->prev;
+        }
+        unlockSpinLock(&queue->lock);
+        waiter->queue = NULL;
+    }
+}
+
+void notifyPollQueue(PollQueue* queue) {
+    lockSpinLock(&queue->lock);
+    PollWaiter* current = queue->waiters;
+    while (current != NULL) {
+        PollWaiter* next = current->next;
+        current->function(current);
+        current = next;
+    }
+    unlockSpinLock(&queue->lock);
+}
@@ -0,0 +1,36 @@
+#ifndef _POLLQUEUE_H_
+#define _POLLQUEUE_H_
+
+#include "task/spinlock.h"
+
+// A poll queue belongs to a file that can block (e.g. a pipe or tty). It is notified whenever the
+// file might have become ready, and the waiters have to check the readiness themselves.
+
+struct PollWaiter_s;
+
+// Called with the queue locked, possibly in an interrupt handler. Must not block.
+typedef void (*PollWakeFunction)(struct PollWaiter_s* waiter);
+
+typedef struct PollWaiter_s {
+    struct PollWaiter_s* next;
+    struct PollWaiter_s* prev;
+    struct PollQueue_s* queue;
+    PollWakeFunction function;
+    void* udata;
+} PollWaiter;
+
+typedef struct PollQueue_s {
+    SpinLock lock;
+    PollWaiter* waiters;
+} PollQueue;
+
+void initPollQueue(PollQueue* queue);
+
+void addPollWaiter(PollQueue* queue, PollWaiter* waiter, PollWakeFunction function, void* udata);
+
+// After this returns, the wake function of the waiter will not be called anymore
+void removePollWaiter(PollWaiter* waiter);
+
+void notifyPollQueue(PollQueue* queue);
+
+#endif
@@ -0,0 +1,131 @@
+
+#include <string.h>
+
+#include "task/profile.h"
+
+#include "interrupt/timer.h"
+#include "memory/kalloc.h"
+#include "task/harts.h"
+#include "task/spinlock.h"
+
+ProfileMode profile_mode = PROFILE_OFF;
+
+static SpinLock profile_lock; // Only used by readers and when enabling
+static ProfileRing* rings[MAX_HART_COUNT];
+
+// Follow the frame pointers, but never leave the stack of the interrupted task
+static size_t walkFramePointers(uintptr_t fp, uintptr_t sp, uintptr_t stack_top, uint64_t* stack) {
+    size_t depth = 0;
+    while (depth < PROFILE_MAX_DEPTH && fp % sizeof(uintptr_t) == 0 && fp >= sp + 2 * sizeof(uintptr_t) && fp <= stack_top) {
+        uintptr_t ra = ((uintptr_t*)fp)[-1];
+        uintptr_t next = ((uintptr_t*)fp)[-2];
+        if (ra == 0) {
+            break;
+        }
+        stack[depth] = ra;
+        depth++;
+        sp = fp;
+        fp = next;
+    }
+    return depth;
+}
+
+void recordProfileSample(TrapFrame* frame, uintptr_t pc) {
+    int hartid = getCurrentHartId();
+    int index = hartIdToIndex(hartid);
+    ProfileRing* ring = index < MAX_HART_COUNT ? __atomic_load_n(&rings[index], __ATOMIC_ACQUIRE) : NULL;
+    if (ring == NULL) {
+        return;
+    }
+    uint64_t idx = __atomic_fetch_add(&ring->head, 1, __ATOMIC_RELAXED);
+    size_t slot = idx % PROFILE_RING_SIZE;
+    __atomic_store_n(&ring->seqs[slot], 2 * idx + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    ProfileSample* sample = &ring->samples[slot];
+    sample->time = getTime() * (1000000000UL / CLOCKS_PER_SEC);
+    sample->hart = hartid;
+    sample->pc = pc;
+    sample->depth = 0;
+    if (frame->hart == NULL) {
+        // Interrupted the hart itself, not a task
+        sample->tid = 0;
+        sample->flags = PROFILE_FLAG_KERNEL;
+    } else {
+        Task* task = (Task*)frame;
+        if (task->process != NULL) {
+            sample->tid = task->tid;
+            sample->flags = PROFILE_FLAG_USER;
+        } else {
+            sample->tid = task->sys_task != NULL ? task->sys_task->tid : task->tid;
+            sample->flags = PROFILE_FLAG_KERNEL;
+            if (task == frame->hart->idle_task) {
+                sample->flags |= PROFILE_FLAG_IDLE;
+            }
+            if (profile_mode == PROFILE_BACKTRACE && task->stack_top != 0) {
+                sample->depth = walkFramePointers(
+                    frame->regs[REG_SAVED_0], frame->regs[REG_STACK_POINTER], task->stack_top, sample->stack
+                );
+            }
+        }
+    }
+    __atomic_store_n(&ring->seqs[slot], 2 * idx + 2, __ATOMIC_RELEASE);
+}
+
+Error setProfileMode(ProfileMode mode) {
+    lockSpinLock(&profile_lock);
+    if (mode != PROFILE_OFF) {
+        for (int i = 0; i < hart_count && i < MAX_HART_COUNT; i++) {
+            if (rings[i] == NULL) {
+                ProfileRing* ring = zalloc(sizeof(ProfileRing));
+                if (ring == NULL) {
+                    unlockSpinLock(&profile_lock);
+                    return simpleError(ENOMEM);
+                }
+                __atomic_store_n(&rings[i], ring, __ATOMIC_RELEASE);
+            }
+        }
+    }
+    __atomic_store_n(&profile_mode, mode, __ATOMIC_RELEASE);
+    unlockSpinLock(&profile_lock);
+    return simpleError(SUCCESS);
+}
+
+static size_t drainRing(ProfileRing* ring, ProfileSample* samples, size_t max) {
+    size_t count = 0;
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (head - ring->tail > PROFILE_RING_SIZE) {
+        ring->dropped += head - ring->tail - PROFILE_RING_SIZE;
+        ring->tail = head - PROFILE_RING_SIZE;
+    }
+    while (ring->tail < head && count < max) {
+        size_t slot = ring->tail % PROFILE_RING_SIZE;
+        uint64_t seq = __atomic_load_n(&ring->seqs[slot], __ATOMIC_ACQUIRE);
+        if (seq < 2 * ring->tail + 2) {
+            // The writer has not finished yet, continue here next time
+            break;
+        }
+        memcpy(&samples[count], &ring->samples[slot], sizeof(ProfileSample));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (seq == 2 * ring->tail + 2 && __atomic_load_n(&ring->seqs[slot], __ATOMIC_RELAXED) == seq) {
+            count++;
+        } else {
+            // Overwritten while we were copying
+            ring->dropped++;
+        }
+        ring->tail++;
+    }
+    return count;
+}
+
+size_t drainProfileSamples(ProfileSample* samples, size_t max) {
+    size_t count = 0;
+    lockSpinLock(&profile_lock);
+    for (int i = 0; i < MAX_HART_COUNT && count < max; i++) {
+        ProfileRing* ring = __atomic_load_n(&rings[i], __ATOMIC_ACQUIRE);
+        if (ring != NULL) {
+            count += drainRing(ring, samples + count, max - count);
+        }
+    }
+    unlockSpinLock(&profile_lock);
+    return count;
+}
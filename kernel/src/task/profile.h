@@ -0,0 +1,70 @@
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "error/error.h"
+#include "kernel/time.h"
+#include "task/types.h"
+
+// While profiling is enabled, every timer interrupt records the interrupted pc into a ring buffer
+// per hart, and the timer fires at least every PROFILE_INTERVAL. Like the scheduler trace, the
+// writers never block and overwrite the oldest samples if the reader does not keep up.
+
+#define PROFILE_RING_SIZE 1024
+#define PROFILE_INTERVAL (CLOCKS_PER_SEC / 1000)
+
+// Number of return addresses recorded with backtraces. Backtraces follow the frame pointer, so
+// they are only useful if the kernel is built with -fno-omit-frame-pointer.
+#define PROFILE_MAX_DEPTH 8
+
+typedef enum {
+    PROFILE_OFF = 0,
+    PROFILE_PC = 1,
+    PROFILE_BACKTRACE = 2,
+} ProfileMode;
+
+#define PROFILE_FLAG_USER (1 << 0)   // The pc is in user code of the thread tid
+#define PROFILE_FLAG_KERNEL (1 << 1) // A kernel task, e.g. a syscall task working for the thread tid
+#define PROFILE_FLAG_IDLE (1 << 2)   // The idle task of the hart
+
+// This is also the format read from /dev/profile
+typedef struct {
+    uint64_t time;  // Nanoseconds since boot
+    int32_t tid;
+    uint8_t hart;
+    uint8_t flags;
+    uint8_t depth;  // Number of valid entries in stack
+    uint8_t reserved;
+    uint64_t pc;
+    uint64_t stack[PROFILE_MAX_DEPTH]; // Return addresses, innermost first
+} ProfileSample;
+
+typedef struct {
+    uint64_t head;      // Next sample to write
+    uint64_t tail;      // Next sample to read
+    uint64_t dropped;   // Samples that were overwritten before they were read
+    uint64_t seqs[PROFILE_RING_SIZE]; // 2 * index + 2 once the sample at index is complete
+    ProfileSample samples[PROFILE_RING_SIZE];
+} ProfileRing;
+
+extern ProfileMode profile_mode;
+
+void recordProfileSample(TrapFrame* frame, uintptr_t pc);
+
+// Called on timer interrupts with the interrupted frame
+static inline void profileTimerInterrupt(TrapFrame* frame, uintptr_t pc) {
+    if (__atomic_load_n(&profile_mode, __ATOMIC_RELAXED) != PROFILE_OFF) {
+        recordProfileSample(frame, pc);
+    }
+}
+
+// Allocates the ring buffers when enabling for the first time
+Error setProfileMode(ProfileMode mode);
+
+// Copy up to max samples out of the ring buffers. Returns the number of samples copied.
+size_t drainProfileSamples(ProfileSample* samples, size_t max);
+
+#endif
@@ -0,0 +1,151 @@
+
+#include <assert.h>
+
+#include "task/rwtasklock.h"
+
+#include "task/schedtrace.h"
+#include "task/schedule.h"
+#include "task/syscall.h"
+#include "task/task.h"
+
+void initRwTaskLock(RwTaskLock* lock) {
+    lock->unsafelock.lock = 0;
+    lock->writer = NULL;
+    lock->num_writes = 0;
+    lock->readers = 0;
+    lock->read_queue = NULL;
+    lock->read_tail = NULL;
+    lock->write_queue = NULL;
+    lock->write_tail = NULL;
+}
+
+#ifndef NO_TASK_LOCKS
+static void waitForRwTaskLock(void* _, Task* task, RwTaskLock* lock, bool write) {
+    task->sched.wakeup_function = NULL;
+    moveTaskToState(task, WAITING);
+    traceSchedEvent(SCHED_TRACE_BLOCK, task, SCHED_TRACE_BLOCK_LOCK);
+    task->usage.voluntary_switches++;
+    enqueueTask(task);
+    Task** queue = write ? &lock->write_queue : &lock->read_queue;
+    Task** tail = write ? &lock->write_tail : &lock->read_tail;
+    task->sched.locks_next = NULL;
+    if (*tail != NULL) {
+        (*tail)->sched.locks_next = task;
+    } else {
+        *queue = task;
+    }
+    *tail = task;
+    unlockUnsafeLock(&lock->unsafelock);
+    runNextTask();
+}
+
+static void wakeupRwTaskLockWaiter(Task* task) {
+    awakenTask(task);
+    enqueueTask(task);
+}
+
+// Pass the lock on to waiting tasks. Must be called with the unsafelock locked and the lock free.
+static void handOffRwTaskLock(RwTaskLock* lock, bool prefer_readers) {
+    if (lock->read_queue != NULL && (prefer_readers || lock->write_queue == NULL)) {
+        // All waiting readers get the lock at once.
+        while (lock->read_queue != NULL) {
+            Task* wakeup = lock->read_queue;
+            lock->read_queue = wakeup->sched.locks_next;
+            lock->readers++;
+            wakeupRwTaskLockWaiter(wakeup);
+        }
+        lock->read_tail = NULL;
+    } else if (lock->write_queue != NULL) {
+        Task* wakeup = lock->write_queue;
+        lock->write_queue = wakeup->sched.locks_next;
+        if (lock->write_queue == NULL) {
+            lock->write_tail = NULL;
+        }
+        lock->writer = wakeup;
+        wakeupRwTaskLockWaiter(wakeup);
+    }
+}
+
+static void lockOrWaitRwTaskLock(RwTaskLock* lock, bool write) {
+    Task* task = criticalEnter();
+    assert(task != NULL);
+    lockUnsafeLock(&lock->unsafelock);
+    bool can_lock = write
+        ? lock->writer == NULL && lock->readers == 0
+        : lock->writer == NULL && lock->write_queue == NULL;
+    if (can_lock) {
+        if (write) {
+            lock->writer = task;
+        } else {
+            lock->readers++;
+        }
+        unlockUnsafeLock(&lock->unsafelock);
+        criticalReturn(task);
+    } else if (saveToFrame(&task->frame)) {
+        callInHart((void*)waitForRwTaskLock, task, lock, write);
+    }
+    // If we had to wait, the unlocking task handed the lock to us.
+}
+#endif
+
+void lockRwTaskLockRead(RwTaskLock* lock) {
+#ifndef NO_TASK_LOCKS
+    Task* task = getCurrentTask();
+    assert(task != NULL);
+    if (lock->writer == task) {
+        // Reading while holding the write lock is the same as locking recursively.
+        lock->num_writes++;
+    } else {
+        lockOrWaitRwTaskLock(lock, false);
+    }
+#endif
+}
+
+void unlockRwTaskLockRead(RwTaskLock* lock) {
+#ifndef NO_TASK_LOCKS
+    Task* task = getCurrentTask();
+    assert(task != NULL);
+    if (lock->writer == task) {
+        unlockRwTaskLockWrite(lock);
+    } else {
+        task = criticalEnter();
+        lockUnsafeLock(&lock->unsafelock);
+        assert(lock->readers > 0);
+        lock->readers--;
+        if (lock->readers == 0) {
+            handOffRwTaskLock(lock, false);
+        }
+        unlockUnsafeLock(&lock->unsafelock);
+        criticalReturn(task);
+    }
+#endif
+}
+
+void lockRwTaskLockWrite(RwTaskLock* lock) {
+#ifndef NO_TASK_LOCKS
+    Task* task = getCurrentTask();
+    assert(task != NULL);
+    if (lock->writer != task) {
+        lockOrWaitRwTaskLock(lock, true);
+        assert(lock->writer == task);
+    }
+    lock->num_writes++;
+#endif
+}
+
+void unlockRwTaskLockWrite(RwTaskLock* lock) {
+#ifndef NO_TASK_LOCKS
+    assert(getCurrentTask() != NULL);
+    assert(getCurrentTask() == lock->writer);
+    lock->num_writes--;
+    if (lock->num_writes == 0) {
+        Task* task = criticalEnter();
+        lockUnsafeLock(&lock->unsafelock);
+        lock->writer = NULL;
+        // Let the readers that queued up behind us go first, so that writers can not starve them.
+        handOffRwTaskLock(lock, true);
+        unlockUnsafeLock(&lock->unsafelock);
+        criticalReturn(task);
+    }
+#endif
+}
@@ -0,0 +1,32 @@
+#ifndef _RW_TASK_LOCK_H_
+#define _RW_TASK_LOCK_H_
+
+#include <stdbool.h>
+
+#include "task/types.h"
+#include "util/unsafelock.h"
+
+// A sleeping reader-writer lock with writer preference. New readers wait if a writer is waiting.
+// The writer may lock recursively, also for reading. Readers must not lock recursively.
+typedef struct {
+    UnsafeLock unsafelock;
+    Task* writer;
+    size_t num_writes;
+    size_t readers;
+    Task* read_queue; // Waiting readers, all of them get the lock when the writer unlocks
+    Task* read_tail;
+    Task* write_queue; // Waiting writers in FIFO order
+    Task* write_tail;
+} RwTaskLock;
+
+void initRwTaskLock(RwTaskLock* lock);
+
+void lockRwTaskLockRead(RwTaskLock* lock);
+
+void unlockRwTaskLockRead(RwTaskLock* lock);
+
+void lockRwTaskLockWrite(RwTaskLock* lock);
+
+void unlockRwTaskLockWrite(RwTaskLock* lock);
+
+#endif
@@ -0,0 +1,116 @@
+
+#include <string.h>
+
+#include "task/schedtrace.h"
+
+#include "interrupt/timer.h"
+#include "memory/kalloc.h"
+#include "task/harts.h"
+#include "task/spinlock.h"
+#include "util/util.h"
+
+bool sched_trace_enabled = false;
+
+static SpinLock trace_lock; // Only used by readers and when enabling
+static SchedTraceRing* rings[MAX_HART_COUNT];
+static uint64_t reported_dropped; // Dropped events already reported to the reader
+
+void recordSchedEvent(SchedTraceKind kind, Task* task, uint8_t data) {
+    int hartid = getCurrentHartId();
+    int index = hartIdToIndex(hartid);
+    SchedTraceRing* ring = index < MAX_HART_COUNT ? __atomic_load_n(&rings[index], __ATOMIC_ACQUIRE) : NULL;
+    if (ring == NULL) {
+        return;
+    }
+    // We can be interrupted while writing, so the slot must be reserved atomically.
+    uint64_t idx = __atomic_fetch_add(&ring->head, 1, __ATOMIC_RELAXED);
+    size_t slot = idx % SCHED_TRACE_RING_SIZE;
+    __atomic_store_n(&ring->seqs[slot], 2 * idx + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    SchedTraceEvent* event = &ring->events[slot];
+    event->time = getTime() * (1000000000UL / CLOCKS_PER_SEC);
+    event->hart = hartid;
+    event->kind = kind;
+    event->data = data;
+    if (task->process == NULL) {
+        // Attribute syscall tasks to the thread they are working for
+        event->tid = task->sys_task != NULL ? task->sys_task->tid : task->tid;
+        event->flags = SCHED_TRACE_FLAG_KERNEL;
+    } else {
+        event->tid = task->tid;
+        event->flags = 0;
+    }
+    __atomic_store_n(&ring->seqs[slot], 2 * idx + 2, __ATOMIC_RELEASE);
+}
+
+Error setSchedTraceEnabled(bool enabled) {
+    lockSpinLock(&trace_lock);
+    if (enabled) {
+        for (int i = 0; i < hart_count && i < MAX_HART_COUNT; i++) {
+            if (rings[i] == NULL) {
+                SchedTraceRing* ring = zalloc(sizeof(SchedTraceRing));
+                if (ring == NULL) {
+                    unlockSpinLock(&trace_lock);
+                    return simpleError(ENOMEM);
+                }
+                __atomic_store_n(&rings[i], ring, __ATOMIC_RELEASE);
+            }
+        }
+    }
+    __atomic_store_n(&sched_trace_enabled, enabled, __ATOMIC_RELEASE);
+    unlockSpinLock(&trace_lock);
+    return simpleError(SUCCESS);
+}
+
+static size_t drainRing(SchedTraceRing* ring, SchedTraceEvent* events, size_t max) {
+    size_t count = 0;
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (head - ring->tail > SCHED_TRACE_RING_SIZE) {
+        ring->dropped += head - ring->tail - SCHED_TRACE_RING_SIZE;
+        ring->tail = head - SCHED_TRACE_RING_SIZE;
+    }
+    while (ring->tail < head && count < max) {
+        size_t slot = ring->tail % SCHED_TRACE_RING_SIZE;
+        uint64_t seq = __atomic_load_n(&ring->seqs[slot], __ATOMIC_ACQUIRE);
+        if (seq < 2 * ring->tail + 2) {
+            // The writer has not finished yet, continue here next time
+            break;
+        }
+        memcpy(&events[count], &ring->events[slot], sizeof(SchedTraceEvent));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (seq == 2 * ring->tail + 2 && __atomic_load_n(&ring->seqs[slot], __ATOMIC_RELAXED) == seq) {
+            count++;
+        } else {
+            // Overwritten while we were copying
+            ring->dropped++;
+        }
+        ring->tail++;
+    }
+    return count;
+}
+
+size_t drainSchedEvents(SchedTraceEvent* events, size_t max) {
+    size_t count = 0;
+    uint64_t dropped = 0;
+    lockSpinLock(&trace_lock);
+    for (int i = 0; i < MAX_HART_COUNT; i++) {
+        SchedTraceRing* ring = __atomic_load_n(&rings[i], __ATOMIC_ACQUIRE);
+        if (ring != NULL) {
+            if (count < max) {
+                count += drainRing(ring, events + count, max - count);
+            }
+            dropped += ring->dropped;
+        }
+    }
+    if (dropped != reported_dropped && count < max) {
+        SchedTraceEvent* event = &events[count];
+        memset(event, 0, sizeof(SchedTraceEvent));
+        event->time = getTime() * (1000000000UL / CLOCKS_PER_SEC);
+        event->tid = umin(dropped - reported_dropped, INT32_MAX);
+        event->kind = SCHED_TRACE_DROPPED;
+        reported_dropped += event->tid;
+        count++;
+    }
+    unlockSpinLock(&trace_lock);
+    return count;
+}
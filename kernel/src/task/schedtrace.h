@@ -0,0 +1,70 @@
+#ifndef _SCHEDTRACE_H_
+#define _SCHEDTRACE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "error/error.h"
+#include "task/types.h"
+
+// Scheduler events are recorded into a ring buffer per hart, but only while tracing is enabled.
+// Writers never block, if the reader does not keep up the oldest events are overwritten.
+
+#define SCHED_TRACE_RING_SIZE 4096
+
+typedef enum {
+    SCHED_TRACE_SWITCH_IN = 1,  // The task started running on the hart
+    SCHED_TRACE_SWITCH_OUT = 2, // The task trapped into the kernel and stopped running
+    SCHED_TRACE_WAKEUP = 3,     // The task stopped waiting and can be enqueued
+    SCHED_TRACE_BLOCK = 4,      // The task started waiting, data is the SchedTraceBlockReason
+    SCHED_TRACE_MIGRATE = 5,    // The task runs on a different hart, data is the previous hart
+    SCHED_TRACE_DROPPED = 6,    // Added by the reader, tid is the number of events lost since the last one
+} SchedTraceKind;
+
+typedef enum {
+    SCHED_TRACE_BLOCK_SYSCALL = 0,
+    SCHED_TRACE_BLOCK_LOCK = 1,
+    SCHED_TRACE_BLOCK_FUTEX = 2,
+    SCHED_TRACE_BLOCK_IO = 3,
+} SchedTraceBlockReason;
+
+// The event happened in a kernel task, e.g. a syscall task working for the thread tid
+#define SCHED_TRACE_FLAG_KERNEL (1 << 0)
+
+// This is also the format read from /dev/schedtrace
+typedef struct {
+    uint64_t time;  // Nanoseconds since boot
+    int32_t tid;
+    uint8_t hart;
+    uint8_t kind;
+    uint8_t data;
+    uint8_t flags;
+} SchedTraceEvent;
+
+typedef struct {
+    uint64_t head;      // Next event to write
+    uint64_t tail;      // Next event to read
+    uint64_t dropped;   // Events that were overwritten before they were read
+    uint64_t seqs[SCHED_TRACE_RING_SIZE]; // 2 * index + 2 once the event at index is complete
+    SchedTraceEvent events[SCHED_TRACE_RING_SIZE];
+} SchedTraceRing;
+
+extern bool sched_trace_enabled;
+
+void recordSchedEvent(SchedTraceKind kind, Task* task, uint8_t data);
+
+static inline void traceSchedEvent(SchedTraceKind kind, Task* task, uint8_t data) {
+    if (__atomic_load_n(&sched_trace_enabled, __ATOMIC_RELAXED)) {
+        recordSchedEvent(kind, task, data);
+    }
+}
+
+// Allocates the ring buffers when enabling for the first time
+Error setSchedTraceEnabled(bool enabled);
+
+// Copy up to max events out of the ring buffers. Returns the number of events copied. If events
+// were lost because the buffers were full, a SCHED_TRACE_DROPPED event reports how many.
+size_t drainSchedEvents(SchedTraceEvent* events, size_t max);
+
+#endif
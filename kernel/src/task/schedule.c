@@ -1,13 +1,19 @@
 
 #include <assert.h>
+#include <string.h>
 
 #include "task/schedule.h"
 
 #include "error/log.h"
+#include "kernel/devtree.h"
+#include "interrupt/com.h"
+#include "interrupt/deferred.h"
+#include "interrupt/timer.h"
 #include "interrupt/trap.h"
 #include "process/process.h"
 #include "process/signals.h"
 #include "task/harts.h"
+#include "task/schedtrace.h"
 #include "task/spinlock.h"
 #include "task/task.h"
 #include "task/types.h"
@@ -15,6 +21,175 @@
 
 #define PRIORITY_DECREASE (CLOCKS_PER_SEC / 75)
 
+// Boot argument listing the harts to isolate, e.g. "isolharts=2,3"
+#define ISOLATE_HARTS_OPTION "isolharts="
+
+// Real-time tasks can use at most RT_RUNTIME of every RT_PERIOD on a hart, if other tasks are ready
+#define RT_PERIOD CLOCKS_PER_SEC
+#define RT_RUNTIME (RT_PERIOD / 20 * 19)
+// Time slice of SCHED_RR tasks
+#define RR_TIME_SLICE (CLOCKS_PER_SEC / 10)
+
+#ifdef FAIR_SCHEDULER
+// Every runnable task should run once in this period, if there are not too many of them
+#define TARGET_LATENCY (CLOCKS_PER_SEC / 50)
+// The minimum time slice given to any task
+#define MIN_GRANULARITY (CLOCKS_PER_SEC / 500)
+// Maximum virtual runtime a task can be behind the queue minimum when it is enqueued. This gives
+// tasks that wake up after sleeping a head start over tasks that keep running.
+#define SLEEPER_CREDIT (TARGET_LATENCY / 2)
+
+#define DEFAULT_WEIGHT 1024
+
+// Every priority step changes the weight by about 1.25x, so the nice value of the priority has a
+// relative meaning: Two tasks with a difference of one get about 55% and 45% of the hart.
+static const uint64_t priority_weights[MAX_PRIORITY] = {
+    88761, 71755, 56483, 46273, 36291, 29154, 23254, 18705, 14949, 11916,
+    9548, 7620, 6100, 4904, 3906, 3121, 2501, 1991, 1586, 1277,
+    1024, 820, 655, 526, 423, 335, 272, 215, 172, 137,
+    110, 87, 70, 56, 45, 36, 29, 23, 18, 15,
+};
+
+static uint64_t taskWeight(Task* task) {
+    return priority_weights[getEffectivePriority(task)];
+}
+
+// The weight a task was accounted with when pushed to the queue
+static uint64_t queuedWeight(Task* task) {
+    return priority_weights[task->sched.queue_priority];
+}
+
+// Virtual runtimes are only comparable within one queue, so keep the distance to the minimum when
+// moving a task to the queue of another hart. The minimum of the other queue is read without its
+// lock, it only has to be approximately right.
+static void moveVruntime(Task* task, ScheduleQueue* from, ScheduleQueue* to) {
+    if (from != to) {
+        int64_t lag = task->sched.vruntime - from->min_vruntime;
+        if (lag < 0 && (uint64_t)-lag > to->min_vruntime) {
+            task->sched.vruntime = 0;
+        } else {
+            task->sched.vruntime = to->min_vruntime + lag;
+        }
+    }
+}
+#else
+static void moveVruntime(Task* task, ScheduleQueue* from, ScheduleQueue* to) {
+    // Only the fair scheduler uses virtual runtimes
+}
+#endif
+
+// Harts that only run tasks explicitly pinned to them
+static HartMask isolated_harts = 0;
+
+static HartMask hartMaskFor(int hartid) {
+    return hartid < 64 ? (HartMask)1 << hartid : 0;
+}
+
+HartMask getOnlineHarts() {
+    HartMask mask = 0;
+    for (int i = 0; i < hart_count; i++) {
+        mask |= hartMaskFor(hart_ids[i]);
+    }
+    return mask;
+}
+
+HartMask getDefaultAffinity() {
+    return ~isolated_harts;
+}
+
+bool canRunOnHart(Task* task, HartFrame* hart) {
+    return (task->sched.affinity & hartMaskFor(hart->hartid)) != 0;
+}
+
+// Parse a list of hart ids and ranges, e.g. "1,3-5"
+static HartMask parseHartList(const char* str) {
+    HartMask mask = 0;
+    while (*str >= '0' && *str <= '9') {
+        int start = 0;
+        while (*str >= '0' && *str <= '9') {
+            start = start * 10 + (*str - '0');
+            str++;
+        }
+        int end = start;
+        if (*str == '-') {
+            str++;
+            end = 0;
+            while (*str >= '0' && *str <= '9') {
+                end = end * 10 + (*str - '0');
+                str++;
+            }
+        }
+        for (int i = start; i <= end && i < 64; i++) {
+            mask |= hartMaskFor(i);
+        }
+        if (*str == ',') {
+            str++;
+        }
+    }
+    return mask;
+}
+
+Error initHartIsolation() {
+    DeviceTreeNode* chosen = findNodeAtPath("/chosen");
+    if (chosen != NULL) {
+        const char* args = readPropertyStringOrDefault(findNodeProperty(chosen, "bootargs"), 0, NULL);
+        const char* option = args != NULL ? strstr(args, ISOLATE_HARTS_OPTION) : NULL;
+        if (option != NULL) {
+            HartMask mask = parseHartList(option + strlen(ISOLATE_HARTS_OPTION));
+            if ((getOnlineHarts() & ~mask) == 0) {
+                // Someone has to run the general tasks
+                return simpleError(EINVAL);
+            }
+            isolated_harts = mask;
+            KERNEL_SUBSUCCESS("Isolated harts %p", mask);
+        }
+    }
+    return simpleError(SUCCESS);
+}
+
+bool setTaskAffinity(Task* task, HartMask mask, TaskMigration* migration) {
+    lockSpinLock(&task->sched.lock);
+    task->sched.affinity = mask;
+    TaskState state = task->sched.state;
+    HartFrame* hart = task->frame.hart;
+    unlockSpinLock(&task->sched.lock);
+    migration->task = task;
+    migration->hart = hart;
+    migration->running = state == RUNNING;
+    migration->affinity = mask;
+    if (state == RUNNING) {
+        return hart != NULL && !canRunOnHart(task, hart) && hart != getCurrentHartFrame();
+    } else {
+        // A ready task might have been queued on any hart
+        return state == READY && hart != NULL;
+    }
+}
+
+void migrateTask(TaskMigration* migration) {
+    if (migration->running) {
+        // The task will be moved when it is enqueued after the preemption
+        requestReschedule(migration->hart);
+    } else {
+        HartFrame* current = migration->hart;
+        do {
+            if (
+                (migration->affinity & hartMaskFor(current->hartid)) == 0
+                && removeTaskFromQueue(&current->queue, migration->task) != NULL
+            ) {
+                // Once removed from the queue, the task can not exit until we enqueue it again.
+                // enqueueTask expects the virtual runtime to be relative to the last hart.
+                if (migration->task->frame.hart != NULL) {
+                    moveVruntime(migration->task, &current->queue, &migration->task->frame.hart->queue);
+                }
+                moveTaskToState(migration->task, ENQUABLE);
+                enqueueTask(migration->task);
+                break;
+            }
+            current = current->next;
+        } while (current != migration->hart);
+    }
+}
+
 SpinLock waiting_lock;
 Task* waiting = NULL;
 
@@ -33,6 +208,40 @@ static void addWaitingTask(Task* task) {
     unlockSpinLock(&waiting_lock);
 }
 
+static bool shouldPreempt(HartFrame* hart, Task* task) {
+    // If nothing is running, the hart is currently selecting the next task anyway. The running task
+    // might be freed at any moment, so only use the values published in enterTask.
+    Task* running = hart->running;
+    return running != NULL
+        && (running == hart->idle_task || hart->running_policy == SCHED_OTHER
+            || hart->running_rt_priority < task->sched.rt_priority);
+}
+
+// Real-time tasks should not have to wait for the preemption timer of the hart they are queued on.
+static void preemptHartFor(HartFrame* hart, Task* task) {
+    if (shouldPreempt(hart, task)) {
+        if (hart == getCurrentHartFrame()) {
+            // We can not message ourselves, but the timer can interrupt the running task
+            preemptCurrentHart();
+        } else {
+            // Does not wait for the other hart, we might be holding locks it is spinning on
+            requestReschedule(hart);
+        }
+    }
+}
+
+// Returns the first hart starting from the given one that the task is allowed to run on
+static HartFrame* allowedHartFor(Task* task, HartFrame* hart) {
+    HartFrame* current = hart;
+    do {
+        if (canRunOnHart(task, current)) {
+            return current;
+        }
+        current = current->next;
+    } while (current != hart);
+    return hart; // The mask is checked when setting it, so this should not happen
+}
+
 void enqueueTask(Task* task) {
     HartFrame* hart = task->frame.hart;
     if (hart == NULL) {
@@ -40,8 +249,10 @@ void enqueueTask(Task* task) {
         hart = getCurrentHartFrame();
     }
     assert(hart != NULL);
-    ScheduleQueue* queue = &hart->queue;
     if (hart->idle_task != task) { // Ignore the idle process
+        HartFrame* last = hart;
+        hart = allowedHartFor(task, hart);
+        ScheduleQueue* queue = &hart->queue;
         lockSpinLock(&task->sched.lock);
         switch (task->sched.state) {
             case WAITING:
@@ -50,6 +261,10 @@ void enqueueTask(Task* task) {
                 break;
             case ENQUABLE:
                 moveTaskToState(task, READY);
+#ifdef FAIR_SCHEDULER
+                // The queue is ordered by virtual runtime, the priority is only used for the weight.
+                task->sched.queue_priority = getEffectivePriority(task);
+#else
                 if (task->sched.run_for > PRIORITY_DECREASE) {
                     // Lower priority to not starve other processes
                     task->sched.queue_priority =
@@ -58,8 +273,17 @@ void enqueueTask(Task* task) {
                 } else {
                     task->sched.queue_priority = task->sched.priority;
                 }
+                if (task->sched.inherited_priority < task->sched.queue_priority) {
+                    // Tasks holding locks wanted by others should not be penalized
+                    task->sched.queue_priority = task->sched.inherited_priority;
+                }
+#endif
+                moveVruntime(task, &last->queue, queue);
                 pushTaskToQueue(queue, task);
                 unlockSpinLock(&task->sched.lock);
+                if (task->sched.policy != SCHED_OTHER) {
+                    preemptHartFor(hart, task);
+                }
                 break;
             case READY: // Task has already been enqueued
             case RUNNING: // It is currently running
@@ -88,6 +312,7 @@ static void awakenTasks() {
         ) {
             task->sched.state = ENQUABLE;
             unlockSpinLock(&task->sched.lock);
+            traceSchedEvent(SCHED_TRACE_WAKEUP, task, 0);
             *current = task->sched.sched_next;
             enqueueTask(task);
         } else {
@@ -112,6 +337,7 @@ noreturn void runNextTask() {
 
 noreturn void runNextTaskFrom(HartFrame* hart) {
     for (;;) {
+        runDeferredWork();
         awakenTasks();
         Task* next = NULL;
         while (next == NULL) {
@@ -127,6 +353,14 @@ noreturn void runNextTaskFrom(HartFrame* hart) {
         }
         assert(next != NULL);
         if (next->process == NULL || handlePendingSignals(next)) {
+            if (next->sched.interrupted) {
+                // The interrupt only preempted the task if something else ran in the meantime
+                if (hart->last_entered != next) {
+                    next->usage.involuntary_switches++;
+                }
+                next->sched.interrupted = false;
+            }
+            hart->last_entered = next;
             enterTask(next);
         } else {
             enqueueTask(next);
@@ -138,7 +372,7 @@ Task* pullTaskForHart(HartFrame* hart) {
     assert(hart != NULL);
     HartFrame* current = hart;
     do {
-        Task* task = pullTaskFromQueue(&current->queue);
+        Task* task = pullTaskFromQueue(&current->queue, hart);
         if (task != NULL) {
             return task;
         } else {
@@ -148,13 +382,52 @@ Task* pullTaskForHart(HartFrame* hart) {
     return hart->idle_task;
 }
 
-Task* pullTaskFromQueue(ScheduleQueue* queue) {
-    lockSpinLock(&queue->lock);
-    if (queue->head == NULL) {
-        unlockSpinLock(&queue->lock);
-        return NULL;
-    } else {
-        Task* ret = queue->head;
+// The following helpers must be called with the queue lock held.
+
+#ifdef FAIR_SCHEDULER
+static Task* pullNormalTask(ScheduleQueue* queue) {
+    Task* ret = queue->head;
+    if (ret != NULL) {
+        queue->head = ret->sched.sched_next;
+        queue->weight -= queuedWeight(ret);
+        if (ret->sched.vruntime > queue->min_vruntime) {
+            queue->min_vruntime = ret->sched.vruntime;
+        }
+    }
+    return ret;
+}
+
+static void pushNormalTask(ScheduleQueue* queue, Task* task) {
+    uint64_t min_vruntime = queue->min_vruntime > SLEEPER_CREDIT ? queue->min_vruntime - SLEEPER_CREDIT : 0;
+    if (task->sched.vruntime < min_vruntime) {
+        // Do not let tasks that slept for long (or are new) monopolize the hart.
+        task->sched.vruntime = min_vruntime;
+    }
+    Task** current = &queue->head;
+    while (*current != NULL && (*current)->sched.vruntime <= task->sched.vruntime) {
+        current = &(*current)->sched.sched_next;
+    }
+    task->sched.sched_next = *current;
+    *current = task;
+    queue->weight += queuedWeight(task);
+}
+
+static bool removeNormalTask(ScheduleQueue* queue, Task* task) {
+    Task** current = &queue->head;
+    while (*current != NULL) {
+        if (*current == task) {
+            *current = task->sched.sched_next;
+            queue->weight -= queuedWeight(task);
+            return true;
+        }
+        current = &(*current)->sched.sched_next;
+    }
+    return false;
+}
+#else
+static Task* pullNormalTask(ScheduleQueue* queue) {
+    Task* ret = queue->head;
+    if (ret != NULL) {
         queue->head = ret->sched.sched_next;
         if (queue->tails[ret->sched.queue_priority] == ret) {
             if (ret->sched.queue_priority == 0) {
@@ -166,16 +439,14 @@ Task* pullTaskFromQueue(ScheduleQueue* queue) {
                 queue->tails[i] = queue->tails[i - 1];
             }
         }
-        unlockSpinLock(&queue->lock);
-        return ret;
     }
+    return ret;
 }
 
-void pushTaskToQueue(ScheduleQueue* queue, Task* process) {
+static void pushNormalTask(ScheduleQueue* queue, Task* process) {
     if (process->sched.queue_priority > LOWEST_PRIORITY) {
         process->sched.queue_priority = LOWEST_PRIORITY;
     }
-    lockSpinLock(&queue->lock);
     if (queue->tails[process->sched.queue_priority] == NULL) {
         process->sched.sched_next = queue->head;
         queue->head = process;
@@ -187,22 +458,117 @@ void pushTaskToQueue(ScheduleQueue* queue, Task* process) {
     for (Priority i = process->sched.queue_priority; i < MAX_PRIORITY && queue->tails[i] == old; i++) {
         queue->tails[i] = process;
     }
-    unlockSpinLock(&queue->lock);
 }
 
-Task* removeTaskFromQueue(ScheduleQueue* queue, Task* task) {
-    lockSpinLock(&queue->lock);
+static bool removeNormalTask(ScheduleQueue* queue, Task* task) {
+    Task* prev = NULL;
     Task** current = &queue->head;
     while (*current != NULL) {
         if (*current == task) {
-            *current = (*current)->sched.sched_next;
-            unlockSpinLock(&queue->lock);
-            return task;
+            *current = task->sched.sched_next;
+            // The queue is sorted by priority, so prev is the new tail of all of our priorities.
+            for (Priority i = 0; i < MAX_PRIORITY; i++) {
+                if (queue->tails[i] == task) {
+                    queue->tails[i] = prev;
+                }
+            }
+            return true;
+        }
+        prev = *current;
+        current = &(*current)->sched.sched_next;
+    }
+    return false;
+}
+#endif
+
+static bool isRealTimeTask(Task* task) {
+    return task->sched.policy != SCHED_OTHER;
+}
+
+static void updateRealTimePeriod(ScheduleQueue* queue, Time time) {
+    if (time >= queue->rt_period_start + RT_PERIOD) {
+        queue->rt_period_start = time;
+        queue->rt_used = 0;
+    }
+}
+
+static bool isRealTimeThrottled(ScheduleQueue* queue) {
+    updateRealTimePeriod(queue, getTime());
+    return queue->rt_used >= RT_RUNTIME;
+}
+
+static void pushRealTimeTask(ScheduleQueue* queue, Task* task) {
+    Task** current = &queue->rt_head;
+    while (*current != NULL && (*current)->sched.rt_priority >= task->sched.rt_priority) {
+        current = &(*current)->sched.sched_next;
+    }
+    task->sched.sched_next = *current;
+    *current = task;
+}
+
+static bool removeRealTimeTask(ScheduleQueue* queue, Task* task) {
+    Task** current = &queue->rt_head;
+    while (*current != NULL) {
+        if (*current == task) {
+            *current = task->sched.sched_next;
+            return true;
         }
-        *current = NULL;
+        current = &(*current)->sched.sched_next;
+    }
+    return false;
+}
+
+static Task* findTaskForHart(Task* list, HartFrame* hart) {
+    while (list != NULL && !canRunOnHart(list, hart)) {
+        list = list->sched.sched_next;
+    }
+    return list;
+}
+
+Task* pullTaskFromQueue(ScheduleQueue* queue, HartFrame* hart) {
+    lockSpinLock(&queue->lock);
+    // Usually the first task is allowed to run, so this is not more expensive than a plain pop.
+    Task* rt = findTaskForHart(queue->rt_head, hart);
+    Task* normal = findTaskForHart(queue->head, hart);
+    Task* ret = NULL;
+    // Throttled real-time tasks only run if there is nothing else to do.
+    if (rt != NULL && (normal == NULL || !isRealTimeThrottled(queue))) {
+        removeRealTimeTask(queue, rt);
+        ret = rt;
+    } else if (normal != NULL && normal == queue->head) {
+        ret = pullNormalTask(queue);
+    } else if (normal != NULL) {
+        removeNormalTask(queue, normal);
+        ret = normal;
+    }
+    if (ret != NULL) {
+        queue->count--;
+        // The task might be stolen from the queue of another hart
+        moveVruntime(ret, queue, &hart->queue);
+    }
+    unlockSpinLock(&queue->lock);
+    return ret;
+}
+
+void pushTaskToQueue(ScheduleQueue* queue, Task* task) {
+    lockSpinLock(&queue->lock);
+    if (isRealTimeTask(task)) {
+        pushRealTimeTask(queue, task);
+    } else {
+        pushNormalTask(queue, task);
+    }
+    queue->count++;
+    unlockSpinLock(&queue->lock);
+}
+
+Task* removeTaskFromQueue(ScheduleQueue* queue, Task* task) {
+    lockSpinLock(&queue->lock);
+    bool found = removeRealTimeTask(queue, task) || removeNormalTask(queue, task);
+    if (found) {
+        queue->count--;
     }
     unlockSpinLock(&queue->lock);
-    return NULL;
+    return found ? task : NULL;
 }
 
 void moveTaskToState(Task* task, TaskState state) {
@@ -219,20 +585,100 @@ void moveTaskToState(Task* task, TaskState state) {
     unlockSpinLock(&task->sched.lock);
 }
 
-void awakenTask(Task* task) {
+bool tryAwakeningTask(Task* task) {
     lockSpinLock(&waiting_lock);
     Task** current = &waiting;
     while (*current != NULL && *current != task) {
         current = &(*current)->sched.sched_next;
     }
-    assert(*current == task);
+    if (*current != task) {
+        unlockSpinLock(&waiting_lock);
+        return false;
+    }
     *current = (*current)->sched.sched_next;
     lockSpinLock(&task->sched.lock);
     if (task->sched.state != TERMINATED && task->sched.state != STOPPED) {
         assert(task->sched.state == WAITING);
         task->sched.state = ENQUABLE;
+        traceSchedEvent(SCHED_TRACE_WAKEUP, task, 0);
     }
     unlockSpinLock(&task->sched.lock);
     unlockSpinLock(&waiting_lock);
+    return true;
 }
 
+void awakenTask(Task* task) {
+    if (!tryAwakeningTask(task)) {
+        panic(); // The task must be waiting
+    }
+}
+
+
+void chargeTaskRuntime(Task* task, Time elapsed) {
+    task->sched.run_for += elapsed;
+    if (isRealTimeTask(task)) {
+        ScheduleQueue* queue = &task->frame.hart->queue;
+        lockSpinLock(&queue->lock);
+        updateRealTimePeriod(queue, getTime());
+        queue->rt_used += elapsed;
+        unlockSpinLock(&queue->lock);
+        return;
+    }
+#ifdef FAIR_SCHEDULER
+    task->sched.vruntime += elapsed * DEFAULT_WEIGHT / taskWeight(task);
+#endif
+}
+
+Time getTaskTimeSlice(Task* task) {
+    ScheduleQueue* queue = &task->frame.hart->queue;
+    if (isRealTimeTask(task)) {
+        // Real-time tasks run until they block, unless they have to round-robin or get throttled.
+        Time slice = task->sched.policy == SCHED_RR ? RR_TIME_SLICE : UINT64_MAX;
+        if (queue->rt_used < RT_RUNTIME) {
+            return umin(slice, RT_RUNTIME - queue->rt_used);
+        } else {
+            // Already throttled, check periodically whether other tasks became ready.
+            return umin(slice, RR_TIME_SLICE);
+        }
+    }
+#ifdef FAIR_SCHEDULER
+    // The time slice is the share of the target latency given by the weight of the task.
+    uint64_t weight = taskWeight(task);
+    uint64_t total = weight + queue->weight;
+    return umax(TARGET_LATENCY * weight / total, MIN_GRANULARITY);
+#else
+    return UINT64_MAX;
+#endif
+}
+
+void inheritSchedParams(Task* task, Task* from) {
+    task->sched.policy = from->sched.policy;
+    task->sched.rt_priority = from->sched.rt_priority;
+    task->sched.affinity = from->sched.affinity;
+#ifdef FAIR_SCHEDULER
+    task->sched.vruntime = from->sched.vruntime;
+#endif
+}
+
+Priority getEffectivePriority(Task* task) {
+    return umin(task->sched.priority, task->sched.inherited_priority);
+}
+
+void boostTaskPriority(Task* task, Priority priority) {
+    lockSpinLock(&task->sched.lock);
+    task->sched.inherited_priority = priority;
+    bool ready = task->sched.state == READY;
+    unlockSpinLock(&task->sched.lock);
+    HartFrame* hart = getCurrentHartFrame();
+    if (ready && hart != NULL && priority < task->sched.queue_priority) {
+        HartFrame* current = hart;
+        do {
+            if (removeTaskFromQueue(&current->queue, task) != NULL) {
+                task->sched.queue_priority = priority;
+                pushTaskToQueue(&current->queue, task);
+                break;
+            }
+            current = current->next;
+        } while (current != hart);
+    }
+}
@@ -3,6 +3,7 @@
 
 #include <stdnoreturn.h>
 
+#include "error/error.h"
 #include "task/types.h"
 
 // Enqueue the given process
@@ -14,7 +15,8 @@ noreturn void runNextTaskFrom(HartFrame* hart);
 
 Task* pullTaskForHart(HartFrame* hart);
 
-Task* pullTaskFromQueue(ScheduleQueue* queue);
+// Pull the next task from the queue that is allowed to run on the given hart
+Task* pullTaskFromQueue(ScheduleQueue* queue, HartFrame* hart);
 
 void pushTaskToQueue(ScheduleQueue* queue, Task* task);
 
@@ -24,4 +26,48 @@ void moveTaskToState(Task* task, TaskState state);
 
 void awakenTask(Task* task);
 
+// Like awakenTask, but returns false if the task is not in the waiting list
+bool tryAwakeningTask(Task* task);
+
+// Account elapsed time spent running the task
+void chargeTaskRuntime(Task* task, Time elapsed);
+
+// Length of the time slice the task should get when running now
+Time getTaskTimeSlice(Task* task);
+
+// Harts that are currently running
+HartMask getOnlineHarts();
+
+// Affinity of new tasks, i.e. all harts that are not isolated
+HartMask getDefaultAffinity();
+
+bool canRunOnHart(Task* task, HartFrame* hart);
+
+// Read the isolated harts from the boot arguments
+Error initHartIsolation();
+
+typedef struct {
+    Task* task; // Only compared until the task is found in a queue, it might have exited meanwhile
+    HartFrame* hart;
+    bool running;
+    HartMask affinity;
+} TaskMigration;
+
+// Change the affinity. Returns true if the task is on a hart it is no longer allowed on, in which
+// case it has to be moved with migrateTask.
+bool setTaskAffinity(Task* task, HartMask mask, TaskMigration* migration);
+
+// Move the task away from the hart. This does not access the task unless it is still queued there,
+// so it can be called after releasing the locks that kept the task alive.
+void migrateTask(TaskMigration* migration);
+
+// Copy the scheduling policy and state of from to the new task
+void inheritSchedParams(Task* task, Task* from);
+
+// The better of the own and the inherited priority
+Priority getEffectivePriority(Task* task);
+
+// Let the task inherit the given priority, moving it forward if it is already in a queue
+void boostTaskPriority(Task* task, Priority priority);
+
 #endif
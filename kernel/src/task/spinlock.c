@@ -4,8 +4,10 @@
 #include "task/spinlock.h"
 
 #include "task/harts.h"
+#include "task/lockstat.h"
 #include "task/syscall.h"
 #include "task/task.h"
+#include "util/util.h"
 
 static bool panic_lock_bypass = false;
 
@@ -15,13 +17,31 @@ void initSpinLock(SpinLock* lock) {
     lock->num_locks = 0;
 }
 
+#ifdef LOCK_STATS
+static void lockUnsafeLockWithStats(SpinLock* lock, uintptr_t caller) {
+    uint64_t start = readCycles();
+    bool contended = !tryLockingUnsafeLock(&lock->unsafelock);
+    if (contended) {
+        lockUnsafeLock(&lock->unsafelock);
+    }
+    uint64_t now = readCycles();
+    lock->stats = getLockStatEntry(LOCK_STAT_SPIN, lock, caller);
+    recordLockAcquired(lock->stats, contended, now - start);
+    lock->locked_cycles = now;
+}
+#endif
+
 void lockSpinLock(SpinLock* lock) {
 #ifndef NO_SPIN_LOCKS
     Task* task = criticalEnter();
     HartFrame* hart = getCurrentHartFrame();
     if (hart == NULL || lock->locked_by != hart) {
         if (!panic_lock_bypass) {
+#ifdef LOCK_STATS
+            lockUnsafeLockWithStats(lock, (uintptr_t)__builtin_return_address(0));
+#else
             lockUnsafeLock(&lock->unsafelock);
+#endif
         }
         lock->locked_by = hart;
         lock->crit_ret_frame = task;
@@ -43,6 +63,13 @@ bool tryLockingSpinLock(SpinLock* lock) {
     Task* task = criticalEnter();
     HartFrame* hart = getCurrentHartFrame();
     if ((hart != NULL && lock->locked_by == hart) || panic_lock_bypass || tryLockingUnsafeLock(&lock->unsafelock)) {
+#ifdef LOCK_STATS
+        if (lock->num_locks == 0 && !panic_lock_bypass) {
+            lock->stats = getLockStatEntry(LOCK_STAT_SPIN, lock, (uintptr_t)__builtin_return_address(0));
+            recordLockAcquired(lock->stats, false, 0);
+            lock->locked_cycles = readCycles();
+        }
+#endif
         lock->num_locks++;
         lock->locked_by = hart;
         lock->crit_ret_frame = task;
@@ -76,6 +103,11 @@ void unlockSpinLock(SpinLock* lock) {
         lock->locked_by = NULL;
 #ifdef DEBUG
         lock->locked_at = 0;
+#endif
+#ifdef LOCK_STATS
+        if (!panic_lock_bypass) {
+            recordLockReleased(lock->stats, readCycles() - lock->locked_cycles);
+        }
 #endif
         Task* crit_return = lock->crit_ret_frame;
         lock->crit_ret_frame = NULL;
@@ -15,6 +15,10 @@ typedef struct {
 #ifdef DEBUG
     uintptr_t locked_at;
 #endif
+#ifdef LOCK_STATS
+    struct LockStatEntry_s* stats; // Statistics entry of the current holder
+    uint64_t locked_cycles;
+#endif
 } SpinLock;
 
 void initSpinLock(SpinLock* lock);
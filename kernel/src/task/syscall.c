@@ -3,8 +3,13 @@
 
 #include "task/syscall.h"
 
+#include "memory/kalloc.h"
+#include "memory/usercopy.h"
+#include "process/process.h"
+#include "process/types.h"
 #include "task/harts.h"
 #include "task/schedule.h"
+#include "util/util.h"
 
 SyscallReturn yieldSyscall(TrapFrame* frame) {
     assert(frame->hart != NULL); // Only a tasks can be yielded
@@ -47,6 +52,7 @@ SyscallReturn sleepSyscall(TrapFrame* frame) {
         lockSpinLock(&task->sched.lock); 
         task->times.entered = end;
         task->sched.wakeup_function = handleSleepWakeup;
+        task->usage.voluntary_switches++;
         unlockSpinLock(&task->sched.lock); 
         setTimeoutTime(end, NULL, NULL); // Make sure we wake up in time
         return WAIT;
@@ -102,3 +108,292 @@ noreturn void leave() {
     callInHart((void*)taskLeave, task);
 }
 
+
+typedef struct {
+    Task* task;
+    SchedPolicy policy;
+    uint8_t rt_priority;
+    Priority priority;
+    HartMask affinity;
+} SchedRequest;
+
+// Only root or processes of the same user are allowed to change the scheduling of a process
+static bool canChangeSchedOf(Task* task, Process* process) {
+    lockSpinLock(&task->process->user.lock);
+    bool allowed = task->process->user.euid == 0
+        || process->user.ruid == task->process->user.euid
+        || process->user.euid == task->process->user.euid;
+    unlockSpinLock(&task->process->user.lock);
+    return allowed;
+}
+
+static bool isPrivileged(Task* task) {
+    lockSpinLock(&task->process->user.lock);
+    bool privileged = task->process->user.euid == 0;
+    unlockSpinLock(&task->process->user.lock);
+    return privileged;
+}
+
+static int setSchedulerCallback(Process* process, void* udata) {
+    SchedRequest* request = (SchedRequest*)udata;
+    if (!canChangeSchedOf(request->task, process)) {
+        return -EPERM;
+    }
+    // The policy is set for all threads of the process. It is used on their next enqueue.
+    lockSpinLock(&process->lock);
+    Task* current = process->tasks;
+    while (current != NULL) {
+        lockSpinLock(&current->sched.lock);
+        current->sched.policy = request->policy;
+        current->sched.rt_priority = request->rt_priority;
+        unlockSpinLock(&current->sched.lock);
+        current = current->proc_next;
+    }
+    unlockSpinLock(&process->lock);
+    return -SUCCESS;
+}
+
+SyscallReturn schedSetschedulerSyscall(TrapFrame* frame) {
+    assert(frame->hart != NULL);
+    Task* task = (Task*)frame;
+    assert(task->process != NULL);
+    Pid pid = SYSCALL_ARG(0);
+    uintptr_t policy = SYSCALL_ARG(1);
+    if (policy == SCHED_OTHER) {
+        if (SYSCALL_ARG(2) != 0) {
+            SYSCALL_RETURN(-EINVAL);
+        }
+    } else if (policy == SCHED_FIFO || policy == SCHED_RR) {
+        if (SYSCALL_ARG(2) < 1 || SYSCALL_ARG(2) > MAX_RT_PRIORITY) {
+            SYSCALL_RETURN(-EINVAL);
+        } else if (!isPrivileged(task)) {
+            // Real-time tasks can starve everything else
+            SYSCALL_RETURN(-EPERM);
+        }
+    } else {
+        SYSCALL_RETURN(-EINVAL);
+    }
+    SchedRequest request = {
+        .task = task,
+        .policy = policy,
+        .rt_priority = SYSCALL_ARG(2),
+    };
+    if (pid == 0) {
+        SYSCALL_RETURN(setSchedulerCallback(task->process, &request));
+    } else {
+        SYSCALL_RETURN(doForProcessWithPid(pid, setSchedulerCallback, &request));
+    }
+}
+
+static int getSchedulerCallback(Process* process, void* udata) {
+    lockSpinLock(&process->lock);
+    int result = -ESRCH;
+    if (process->tasks != NULL) {
+        result = process->tasks->sched.policy;
+    }
+    unlockSpinLock(&process->lock);
+    return result;
+}
+
+SyscallReturn schedGetschedulerSyscall(TrapFrame* frame) {
+    assert(frame->hart != NULL);
+    Task* task = (Task*)frame;
+    assert(task->process != NULL);
+    Pid pid = SYSCALL_ARG(0);
+    if (pid == 0) {
+        SYSCALL_RETURN(task->sched.policy);
+    } else {
+        SYSCALL_RETURN(doForProcessWithPid(pid, getSchedulerCallback, NULL));
+    }
+}
+
+static int setPriorityCallback(Process* process, void* udata) {
+    SchedRequest* request = (SchedRequest*)udata;
+    if (!canChangeSchedOf(request->task, process)) {
+        return -EPERM;
+    }
+    bool privileged = isPrivileged(request->task);
+    lockSpinLock(&process->lock);
+    Task* current = process->tasks;
+    int result = -SUCCESS;
+    if (current != NULL && request->priority < current->sched.priority && !privileged) {
+        // Only root can increase the priority
+        result = -EACCES;
+    }
+    while (result == -SUCCESS && current != NULL) {
+        lockSpinLock(&current->sched.lock);
+        current->sched.priority = request->priority;
+        unlockSpinLock(&current->sched.lock);
+        current = current->proc_next;
+    }
+    unlockSpinLock(&process->lock);
+    return result;
+}
+
+static Priority priorityForNice(int64_t nice) {
+    // Nice values between -20 and 19 map to priorities 0 to 39
+    if (nice < -(MAX_PRIORITY / 2)) {
+        nice = -(MAX_PRIORITY / 2);
+    } else if (nice > MAX_PRIORITY / 2 - 1) {
+        nice = MAX_PRIORITY / 2 - 1;
+    }
+    return nice + MAX_PRIORITY / 2;
+}
+
+SyscallReturn setPrioritySyscall(TrapFrame* frame) {
+    assert(frame->hart != NULL);
+    Task* task = (Task*)frame;
+    assert(task->process != NULL);
+    if (SYSCALL_ARG(0) != 0) {
+        // Only PRIO_PROCESS is supported
+        SYSCALL_RETURN(-EINVAL);
+    }
+    Pid pid = SYSCALL_ARG(1);
+    SchedRequest request = {
+        .task = task,
+        .priority = priorityForNice((int64_t)SYSCALL_ARG(2)),
+    };
+    if (pid == 0) {
+        SYSCALL_RETURN(setPriorityCallback(task->process, &request));
+    } else {
+        SYSCALL_RETURN(doForProcessWithPid(pid, setPriorityCallback, &request));
+    }
+}
+
+static int getPriorityCallback(Process* process, void* udata) {
+    lockSpinLock(&process->lock);
+    int result = -ESRCH;
+    if (process->tasks != NULL) {
+        result = process->tasks->sched.priority;
+    }
+    unlockSpinLock(&process->lock);
+    return result;
+}
+
+// Returns the nice value plus 20, so that the result is never negative. (Linux returns 20 minus the
+// nice value instead, i.e. higher is better there.)
+SyscallReturn getPrioritySyscall(TrapFrame* frame) {
+    assert(frame->hart != NULL);
+    Task* task = (Task*)frame;
+    assert(task->process != NULL);
+    if (SYSCALL_ARG(0) != 0) {
+        SYSCALL_RETURN(-EINVAL);
+    }
+    Pid pid = SYSCALL_ARG(1);
+    if (pid == 0) {
+        SYSCALL_RETURN(task->sched.priority);
+    } else {
+        SYSCALL_RETURN(doForProcessWithPid(pid, getPriorityCallback, NULL));
+    }
+}
+
+// Returns the new nice value plus 20, like getpriority.
+SyscallReturn niceSyscall(TrapFrame* frame) {
+    assert(frame->hart != NULL);
+    Task* task = (Task*)frame;
+    assert(task->process != NULL);
+    int64_t nice = (int64_t)task->sched.priority - MAX_PRIORITY / 2 + (int64_t)SYSCALL_ARG(0);
+    SchedRequest request = {
+        .task = task,
+        .priority = priorityForNice(nice),
+    };
+    int result = setPriorityCallback(task->process, &request);
+    if (result < 0) {
+        SYSCALL_RETURN(result);
+    } else {
+        SYSCALL_RETURN(request.priority);
+    }
+}
+
+static int setAffinityCallback(Process* process, void* udata) {
+    SchedRequest* request = (SchedRequest*)udata;
+    if (!canChangeSchedOf(request->task, process)) {
+        return -EPERM;
+    }
+    lockSpinLock(&process->lock);
+    size_t count = 0;
+    for (Task* current = process->tasks; current != NULL; current = current->proc_next) {
+        count++;
+    }
+    TaskMigration* migrations = kalloc(count * sizeof(TaskMigration));
+    if (migrations == NULL) {
+        unlockSpinLock(&process->lock);
+        return -ENOMEM;
+    }
+    size_t migration_count = 0;
+    for (Task* current = process->tasks; current != NULL; current = current->proc_next) {
+        if (setTaskAffinity(current, request->affinity, &migrations[migration_count])) {
+            migration_count++;
+        }
+    }
+    unlockSpinLock(&process->lock);
+    // Do not hold the process lock while moving tasks between the queues of other harts
+    for (size_t i = 0; i < migration_count; i++) {
+        migrateTask(&migrations[i]);
+    }
+    dealloc(migrations);
+    return -SUCCESS;
+}
+
+SyscallReturn schedSetaffinitySyscall(TrapFrame* frame) {
+    assert(frame->hart != NULL);
+    Task* task = (Task*)frame;
+    assert(task->process != NULL);
+    Pid pid = SYSCALL_ARG(0);
+    HartMask mask = 0;
+    size_t size = umin(SYSCALL_ARG(1), sizeof(HartMask));
+    if (isError(copyFromUser(task->process->memory.mem, &mask, SYSCALL_ARG(2), size))) {
+        SYSCALL_RETURN(-EFAULT);
+    }
+    if ((mask & getOnlineHarts()) == 0) {
+        SYSCALL_RETURN(-EINVAL);
+    }
+    SchedRequest request = {
+        .task = task,
+        .affinity = mask,
+    };
+    if (pid == 0) {
+        SYSCALL_RETURN(setAffinityCallback(task->process, &request));
+    } else {
+        SYSCALL_RETURN(doForProcessWithPid(pid, setAffinityCallback, &request));
+    }
+}
+
+static int getAffinityCallback(Process* process, void* udata) {
+    SchedRequest* request = (SchedRequest*)udata;
+    lockSpinLock(&process->lock);
+    int result = -ESRCH;
+    if (process->tasks != NULL) {
+        request->affinity = process->tasks->sched.affinity;
+        result = -SUCCESS;
+    }
+    unlockSpinLock(&process->lock);
+    return result;
+}
+
+// Returns the number of bytes written to the mask
+SyscallReturn schedGetaffinitySyscall(TrapFrame* frame) {
+    assert(frame->hart != NULL);
+    Task* task = (Task*)frame;
+    assert(task->process != NULL);
+    Pid pid = SYSCALL_ARG(0);
+    if (SYSCALL_ARG(1) < sizeof(HartMask)) {
+        SYSCALL_RETURN(-EINVAL);
+    }
+    SchedRequest request = {
+        .task = task,
+        .affinity = task->sched.affinity,
+    };
+    if (pid != 0) {
+        int result = doForProcessWithPid(pid, getAffinityCallback, &request);
+        if (result < 0) {
+            SYSCALL_RETURN(result);
+        }
+    }
+    // Only report harts that actually exist
+    HartMask mask = request.affinity & getOnlineHarts();
+    if (isError(copyToUser(task->process->memory.mem, SYSCALL_ARG(2), &mask, sizeof(HartMask)))) {
+        SYSCALL_RETURN(-EFAULT);
+    }
+    SYSCALL_RETURN(sizeof(HartMask));
+}
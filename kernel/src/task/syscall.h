@@ -9,6 +9,20 @@ SyscallReturn sleepSyscall(TrapFrame* frame);
 
 SyscallReturn criticalSyscall(TrapFrame* frame);
 
+SyscallReturn schedSetschedulerSyscall(TrapFrame* frame);
+
+SyscallReturn schedGetschedulerSyscall(TrapFrame* frame);
+
+SyscallReturn setPrioritySyscall(TrapFrame* frame);
+
+SyscallReturn getPrioritySyscall(TrapFrame* frame);
+
+SyscallReturn niceSyscall(TrapFrame* frame);
+
+SyscallReturn schedSetaffinitySyscall(TrapFrame* frame);
+
+SyscallReturn schedGetaffinitySyscall(TrapFrame* frame);
+
 Task* criticalEnter();
 
 void criticalReturn(Task* to);
@@ -5,11 +5,14 @@
 
 #include "interrupt/trap.h"
 #include "memory/kalloc.h"
+#include "memory/kstack.h"
 #include "memory/virtmem.h"
 #include "memory/virtptr.h"
+#include "process/futex.h"
 #include "process/process.h"
 #include "process/syscall.h"
 #include "task/harts.h"
+#include "task/schedtrace.h"
 #include "task/schedule.h"
 #include "task/types.h"
 
@@ -27,15 +30,29 @@ void initKernelTrapFrame(TrapFrame* frame, uintptr_t sp, uintptr_t pc) {
 }
 
 Task* createTask() {
-    return zalloc(sizeof(Task));
+    Task* task = zalloc(sizeof(Task));
+    if (task != NULL) {
+        task->sched.inherited_priority = MAX_PRIORITY;
+        task->sched.affinity = getDefaultAffinity();
+    }
+    return task;
 }
 
-Task* createKernelTask(void* enter, size_t stack_size, Priority priority) {
+Task* createKernelTask(void* enter, size_t stack_size, Priority priority, const char* name) {
     Task* task = createTask();
     if (task == NULL) {
         return NULL;
     }
-    task->stack = kalloc(stack_size);
+    if (stack_size == KERNEL_STACK_SIZE) {
+        task->stack = allocKernelStack();
+    } else {
+        task->stack = kalloc(stack_size);
+    }
+    if (task->stack == NULL) {
+        dealloc(task);
+        return NULL;
+    }
+    task->name = name;
     task->stack_top = (uintptr_t)task->stack + stack_size;
     initKernelTrapFrame(&task->frame, task->stack_top, (uintptr_t)enter);
     task->sched.priority = priority;
@@ -44,13 +61,22 @@ Task* createKernelTask(void* enter, size_t stack_size, Priority priority) {
 }
 
 void deallocTask(Task* task) {
+    removeFutexWaiter(task);
     if (task->process != NULL) {
         removeProcessTask(task);
     }
-    dealloc(task->stack);
+    if (hasGuardedKernelStack(task)) {
+        deallocKernelStack(task->stack);
+    } else {
+        dealloc(task->stack);
+    }
     dealloc(task);
 }
 
+bool hasGuardedKernelStack(Task* task) {
+    return task->stack != NULL && task->stack_top - (uintptr_t)task->stack == KERNEL_STACK_SIZE;
+}
+
 noreturn void enterTask(Task* task) {
     assert(getCurrentTask() == NULL);
     moveTaskToState(task, RUNNING);
@@ -58,7 +84,14 @@ noreturn void enterTask(Task* task) {
     assert(hart != NULL);
     hart->frame.regs[REG_STACK_POINTER] = (uintptr_t)hart->stack_top;
     assert(hart->spinlocks_locked == 0);
+    if (task->frame.hart != NULL && task->frame.hart != hart) {
+        traceSchedEvent(SCHED_TRACE_MIGRATE, task, task->frame.hart->hartid);
+    }
+    traceSchedEvent(SCHED_TRACE_SWITCH_IN, task, 0);
     task->frame.hart = hart;
+    hart->running_policy = task->sched.policy;
+    hart->running_rt_priority = task->sched.rt_priority;
+    hart->running = task;
     task->times.entered = setPreemptionTimer(task);
     if (task->process == NULL) {
         enterKernelMode(&task->frame);
@@ -84,3 +117,10 @@ VirtPtr virtPtrForTask(uintptr_t addr, Task* task) {
     }
 }
 
+void addTaskUsage(TaskUsage* to, const TaskUsage* from) {
+    to->voluntary_switches += from->voluntary_switches;
+    to->involuntary_switches += from->involuntary_switches;
+    to->minor_faults += from->minor_faults;
+    to->block_reads += from->block_reads;
+    to->block_writes += from->block_writes;
+}
@@ -16,14 +16,19 @@ void initKernelTrapFrame(TrapFrame* frame, uintptr_t sp, uintptr_t pc);
 
 Task* createTask();
 
-Task* createKernelTask(void* enter, size_t stack_size, Priority priority);
+Task* createKernelTask(void* enter, size_t stack_size, Priority priority, const char* name);
 
 void deallocTask(Task* task);
 
+// Returns true if the task stack is from the kernel stack pool and has a guard page below it
+bool hasGuardedKernelStack(Task* task);
+
 noreturn void enterTask(Task* task);
 
 Task* getCurrentTask();
 
 VirtPtr virtPtrForTask(uintptr_t addr, Task* task);
 
+void addTaskUsage(TaskUsage* to, const TaskUsage* from);
+
 #endif
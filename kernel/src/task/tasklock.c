@@ -3,15 +3,20 @@
 
 #include "task/tasklock.h"
 
+#include "interrupt/clint.h"
+#include "task/lockstat.h"
+#include "task/schedtrace.h"
 #include "task/schedule.h"
 #include "task/syscall.h"
 #include "task/task.h"
+#include "util/util.h"
 
 void initTaskLock(TaskLock* lock) {
     lock->unsafelock.lock = 0;
     lock->locked_by = NULL;
     lock->num_locks = 0;
     lock->wait_queue = NULL;
+    lock->wait_tail = NULL;
 }
 
 #ifndef NO_TASK_LOCKS
@@ -20,18 +25,56 @@ static SpinLock locked_lock;
 static TaskLock* locked_locks;
 #endif
 
+// Protects the wait queues, blocked_on and inherited_priority of all tasks. This is only taken if
+// tasks have to wait, or when unlocking a lock with waiters. It must be locked after unsafelock.
+static SpinLock inheritance_lock;
+
+// Give the owner of lock, and transitively the owners of the locks it is waiting for, priority.
+static void inheritPriority(TaskLock* lock, Priority priority) {
+    while (lock != NULL && lock->locked_by != NULL && getEffectivePriority(lock->locked_by) > priority) {
+        Task* owner = lock->locked_by;
+        boostTaskPriority(owner, priority);
+        lock = owner->sched.blocked_on;
+    }
+}
+
+// The best priority of all tasks waiting for a lock held by task
+static Priority waitersPriority(Task* task) {
+    Priority priority = MAX_PRIORITY;
+    for (TaskLock* lock = task->sched.held_locks; lock != NULL; lock = lock->held_next) {
+        for (Task* waiter = lock->wait_queue; waiter != NULL; waiter = waiter->sched.locks_next) {
+            priority = umin(priority, getEffectivePriority(waiter));
+        }
+    }
+    return priority;
+}
+
 static void waitForTaskLock(void* _, Task* task, TaskLock* lock) {
     task->sched.wakeup_function = NULL;
     moveTaskToState(task, WAITING);
+    traceSchedEvent(SCHED_TRACE_BLOCK, task, SCHED_TRACE_BLOCK_LOCK);
+    task->usage.voluntary_switches++;
     enqueueTask(task);
-    task->sched.locks_next = lock->wait_queue;
-    lock->wait_queue = task;
+    lockSpinLock(&inheritance_lock);
+    task->sched.locks_next = NULL;
+    if (lock->wait_tail != NULL) {
+        lock->wait_tail->sched.locks_next = task;
+    } else {
+        lock->wait_queue = task;
+    }
+    lock->wait_tail = task;
+    task->sched.blocked_on = lock;
+    inheritPriority(lock, getEffectivePriority(task));
+    unlockSpinLock(&inheritance_lock);
     unlockUnsafeLock(&lock->unsafelock);
     runNextTask();
 }
 
 static void basicLockByTask(TaskLock* lock, Task* task) {
     lock->locked_by = task;
+    // Only the owner changes this list, or the unlocking task while the new owner is waiting.
+    lock->held_next = task->sched.held_locks;
+    task->sched.held_locks = lock;
 #ifdef DEBUG
     lockSpinLock(&locked_lock);
     lock->prev_locked = NULL;
@@ -46,6 +89,11 @@ static void basicLockByTask(TaskLock* lock, Task* task) {
 
 static void basicUnlockByTask(TaskLock* lock, Task* task) {
     lock->locked_by = NULL;
+    TaskLock** current = &task->sched.held_locks;
+    while (*current != lock) {
+        current = &(*current)->held_next;
+    }
+    *current = lock->held_next;
 #ifdef DEBUG
     lockSpinLock(&locked_lock);
     if (lock->prev_locked != NULL) {
@@ -60,8 +108,7 @@ static void basicUnlockByTask(TaskLock* lock, Task* task) {
 #endif
 }
 
-static bool lockOrWaitTaskLock(TaskLock* lock) {
-    bool result;
+static bool lockOrWaitTaskLock(TaskLock* lock, bool* waited) {
     Task* task = criticalEnter();
     assert(task != NULL);
     lockUnsafeLock(&lock->unsafelock);
@@ -69,14 +116,39 @@ static bool lockOrWaitTaskLock(TaskLock* lock) {
         basicLockByTask(lock, task);
         unlockUnsafeLock(&lock->unsafelock);
         criticalReturn(task);
-        result = true;
+        return true;
     } else {
+        *waited = true;
         if (saveToFrame(&task->frame)) {
             callInHart((void*)waitForTaskLock, task, lock);
         }
-        result = false;
+        // The unlocking task handed the lock directly to us.
+        return lock->locked_by == task;
     }
-    return result;
+}
+
+// Spin while the owner is running on another hart, since it will probably release the lock soon.
+// Returns true if the lock was held by a running task. The owner might be freed while we look at
+// it, but kernel memory remains accessible, so this only leads to a wrong guess.
+static bool spinOnRunningOwner(TaskLock* lock) {
+    bool spun = false;
+    uint64_t start = readCycles();
+    for (size_t i = 0; i < TASK_LOCK_SPIN_COUNT; i++) {
+        Task* owner = __atomic_load_n(&lock->locked_by, __ATOMIC_ACQUIRE);
+        if (
+            owner == NULL || __atomic_load_n(&lock->wait_queue, __ATOMIC_RELAXED) != NULL
+            || __atomic_load_n(&owner->sched.state, __ATOMIC_RELAXED) != RUNNING
+        ) {
+            // Do not spin if there are sleeping waiters, they would get the lock first anyway.
+            break;
+        }
+        spun = true;
+        if (readCycles() - start >= TASK_LOCK_SPIN_CYCLES) {
+            break;
+        }
+        spinLoopHint();
+    }
+    return spun;
 }
 #endif
 
@@ -85,8 +157,26 @@ void lockTaskLock(TaskLock* lock) {
     Task* task = getCurrentTask();
     assert(task != NULL);
     if (lock->locked_by != task) {
+#ifdef LOCK_STATS
+        Time start = getTime();
+#endif
         // Wait until we are able to lock.
-        while (!lockOrWaitTaskLock(lock));
+        bool spun = spinOnRunningOwner(lock);
+        bool waited = false;
+        while (!lockOrWaitTaskLock(lock, &waited)) {
+            // Retry until we get the lock
+        }
+#ifdef LOCK_STATS
+        Time now = getTime();
+        lock->stats = getLockStatEntry(LOCK_STAT_TASK, lock, (uintptr_t)__builtin_return_address(0));
+        recordLockAcquired(lock->stats, spun || waited, now - start);
+        if (spun && !waited) {
+            recordLockSpun(lock->stats);
+        }
+        lock->locked_time = now;
+#else
+        (void)spun; // Only used for the statistics
+#endif
 #ifdef DEBUG
         lock->locked_at = (uintptr_t)__builtin_return_address(0);
 #endif
@@ -106,6 +196,11 @@ bool tryLockingTaskLock(TaskLock* lock) {
         if (lock->locked_by == NULL) {
             basicLockByTask(lock, task);
             result = true;
+#ifdef LOCK_STATS
+            lock->stats = getLockStatEntry(LOCK_STAT_TASK, lock, (uintptr_t)__builtin_return_address(0));
+            recordLockAcquired(lock->stats, false, 0);
+            lock->locked_time = getTime();
+#endif
 #ifdef DEBUG
             lock->locked_at = (uintptr_t)__builtin_return_address(0);
 #endif
@@ -132,15 +227,34 @@ void unlockTaskLock(TaskLock* lock) {
     if (lock->num_locks == 0) {
 #ifdef DEBUG
         lock->locked_at = 0;
+#endif
+#ifdef LOCK_STATS
+        recordLockReleased(lock->stats, getTime() - lock->locked_time);
 #endif
         Task* task = criticalEnter();
         lockUnsafeLock(&lock->unsafelock);
         basicUnlockByTask(lock, task);
-        while (lock->wait_queue != NULL) {
+        if (lock->wait_queue != NULL || task->sched.inherited_priority != MAX_PRIORITY) {
+            lockSpinLock(&inheritance_lock);
             Task* wakeup = lock->wait_queue;
-            lock->wait_queue = wakeup->sched.locks_next;
-            awakenTask(wakeup);
-            enqueueTask(wakeup);
+            if (wakeup != NULL) {
+                // Hand the lock to the first waiter, instead of waking all of them to race for it.
+                lock->wait_queue = wakeup->sched.locks_next;
+                if (lock->wait_queue == NULL) {
+                    lock->wait_tail = NULL;
+                }
+                wakeup->sched.blocked_on = NULL;
+                basicLockByTask(lock, wakeup);
+                // The new owner inherits from the remaining waiters.
+                wakeup->sched.inherited_priority = umin(wakeup->sched.inherited_priority, waitersPriority(wakeup));
+            }
+            // Drop the priority inherited through this lock.
+            task->sched.inherited_priority = waitersPriority(task);
+            unlockSpinLock(&inheritance_lock);
+            if (wakeup != NULL) {
+                awakenTask(wakeup);
+                enqueueTask(wakeup);
+            }
         }
         unlockUnsafeLock(&lock->unsafelock);
         criticalReturn(task);
@@ -6,11 +6,22 @@
 #include "task/types.h"
 #include "util/unsafelock.h"
 
+// A task polls a lock held by a task running on another hart at most this often, and for at most
+// this many cycles, before sleeping
+#define TASK_LOCK_SPIN_COUNT 256
+#define TASK_LOCK_SPIN_CYCLES 20000
+
 typedef struct TaskLock_s {
     UnsafeLock unsafelock;
     Task* locked_by;
     size_t num_locks;
-    Task* wait_queue;
+    Task* wait_queue; // Waiting tasks in FIFO order, the head gets the lock on unlock
+    Task* wait_tail;
+    struct TaskLock_s* held_next; // Next lock held by the same task
+#ifdef LOCK_STATS
+    struct LockStatEntry_s* stats; // Statistics entry of the current holder
+    Time locked_time;
+#endif
 #ifdef DEBUG
     uintptr_t locked_at;
     struct TaskLock_s* next_locked;
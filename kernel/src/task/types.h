@@ -58,12 +58,29 @@ typedef struct TrapFrame_s {
 #define LOWEST_PRIORITY (MAX_PRIORITY - 1)
 #define DEFAULT_PRIORITY (MAX_PRIORITY / 2)
 
+// Real-time priorities go from 1 to MAX_RT_PRIORITY, higher values are more important
+#define MAX_RT_PRIORITY 99
+
+typedef enum {
+    SCHED_OTHER = 0,
+    SCHED_FIFO = 1,   // Real-time, runs until it blocks or a higher priority task becomes ready
+    SCHED_RR = 2,     // Real-time, like SCHED_FIFO but round-robin between equal priorities
+} SchedPolicy;
+
 struct Task_s;
 
 typedef struct {
     SpinLock lock;
     struct Task_s* head;
-    struct Task_s* tails[MAX_PRIORITY];
+    struct Task_s* tails[MAX_PRIORITY]; // Unused with FAIR_SCHEDULER, where head is sorted by vruntime
+    size_t count;
+    struct Task_s* rt_head; // Real-time tasks, sorted by decreasing real-time priority
+    Time rt_period_start;   // Real-time tasks may only use part of every period
+    Time rt_used;
+#ifdef FAIR_SCHEDULER
+    uint64_t weight; // Sum of the weights of all queued tasks
+    uint64_t min_vruntime;
+#endif
 } ScheduleQueue;
 
 typedef struct HartFrame_s {
@@ -72,7 +89,18 @@ typedef struct HartFrame_s {
     int hartid;
     ScheduleQueue queue;
     struct Task_s* idle_task;
+    struct Task_s* running; // Task currently running on this hart, NULL while in a trap
+    struct Task_s* last_entered; // Last task entered on this hart. Only compared, never accessed.
+    // Scheduling class of the running task, published so that other harts must not access it
+    SchedPolicy running_policy;
+    uint8_t running_rt_priority;
+    bool need_resched; // Set while a reschedule interrupt is pending, see requestReschedule
+    Time timecmp; // Deadline currently armed in the timer of this hart
+    struct DeferredWork_s* deferred; // Work queued by interrupt handlers, see interrupt/deferred.h
+    struct DeferredWork_s* deferred_tail;
     struct HartFrame_s* next; // Next hart. Used for scheduling
+    struct KernelStackFree_s* free_stacks; // Kernel stacks cached by this hart
+    size_t free_stack_count;
 #ifdef DEBUG
     size_t spinlocks_locked;
 #endif
@@ -90,19 +118,31 @@ typedef enum {
 
 typedef uint8_t Priority;
 
+// Set of harts, bit n is the hart with hart id n
+typedef uint64_t HartMask;
+
 typedef bool (*SleepTryToWakeUp)(struct Task_s* task, void* udata);
 
 typedef struct {
     // All data needed for scheduling
     Priority priority;
     Priority queue_priority;    // Is at maximum priority, but will be decreased over time
+    SchedPolicy policy;
+    uint8_t rt_priority;
     Time run_for;
+    uint64_t vruntime;          // Runtime weighted by priority, used with FAIR_SCHEDULER
+    HartMask affinity;          // Harts the task is allowed to run on
     TaskState state;
+    bool interrupted;           // Left RUNNING because of an interrupt and not entered since
     struct Task_s* sched_next;  // Used for ready and waiting lists
-    struct Task_s* locks_next;  // Used for lists in locks
+    struct Task_s* locks_next;  // Used for lists in locks and futex wait queues
     SleepTryToWakeUp wakeup_function;
     void* wakeup_udata;
     SpinLock lock;
+    // Priority inheritance for task locks
+    Priority inherited_priority;        // Best priority of tasks waiting for our locks, or MAX_PRIORITY
+    struct TaskLock_s* blocked_on;      // Task lock this task is waiting for
+    struct TaskLock_s* held_locks;      // Task locks currently held by this task
 } TaskSched;
 
 typedef struct {
@@ -114,6 +154,22 @@ typedef struct {
     Time system_child_time;
 } TaskTimes;
 
+typedef struct {
+    // Counters reported by getrusage
+    size_t voluntary_switches;      // The task blocked
+    size_t involuntary_switches;    // The task was interrupted while running
+    size_t minor_faults;
+    size_t block_reads;             // In sectors
+    size_t block_writes;            // In sectors
+} TaskUsage;
+
+typedef struct {
+    // Signal state of a single thread, handlers and pending signals belong to the process
+    uint64_t mask;
+    int current_signal;
+    uintptr_t restore_frame;
+} TaskSignals;
+
 struct Process_s;
 
 typedef struct Task_s {
@@ -122,9 +178,18 @@ typedef struct Task_s {
     uintptr_t stack_top;
     TaskSched sched;
     TaskTimes times;
+    TaskUsage usage;
+    TaskUsage child_usage;
     struct Process_s* process;
     struct Task_s* proc_next;
     struct Task_s* sys_task;
+    const char* name;
+    int tid; // Thread id, equal to the pid for the first thread of a process
+    uintptr_t clear_tid; // User address cleared when the thread exits
+    uintptr_t futex_key; // Physical address of the futex the task waits on, or zero
+    Time futex_timeout; // Deadline of the futex wait, or zero
+    uint64_t futex_timeout_id;
+    TaskSignals signals;
 } Task;
 
 #endif
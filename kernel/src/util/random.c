@@ -3,7 +3,9 @@
 #include <string.h>
 
 #include "error/panic.h"
+#include "interrupt/deferred.h"
 #include "interrupt/timer.h"
+#include "task/harts.h"
 #include "task/spinlock.h"
 #include "util/util.h"
 
@@ -251,27 +253,111 @@ static Time last_reseed;
 
 static SpinLock lock;
 
-void addRandomEvent(uint8_t* data, size_t size) {
-    assert(size < sizeof(Bits256) - 2 * sizeof(uint32_t));
-    lockSpinLock(&lock);
+// Samples are collected per hart without locking and folded into the pools in batches. Every
+// sample still counts as one event for the entropy estimation.
+#define SAMPLE_BUFFER_SIZE 64
+
+typedef struct {
+    uint32_t samples[SAMPLE_BUFFER_SIZE];
+    size_t count;
+    DeferredWork fold;
+} SampleBuffer;
+
+static SampleBuffer sample_buffers[MAX_HART_COUNT];
+
+// Must be called with the lock held
+static void initPoolsIfEmpty() {
     if (acc_count == 0) {
         for (size_t i = 0; i < ENTROPY_POOLS; i++) {
             sha256Init(pools[i]);
         }
         pools_size = 0;
     }
+}
+
+// Must be called with the lock held
+static void accountEvents(size_t count) {
+    pools_size += (acc_count + count) / ENTROPY_POOLS - acc_count / ENTROPY_POOLS;
+    acc_count += count;
+}
+
+void addRandomEvent(uint8_t* data, size_t size) {
+    assert(size < sizeof(Bits256) - 2 * sizeof(uint32_t));
+    lockSpinLock(&lock);
+    initPoolsIfEmpty();
     Bits256 block;
     block[0] = getTime();
     block[1] = size;
     memcpy(block + 2, data, size);
     sha256Block(pools[acc_count % ENTROPY_POOLS], block);
-    acc_count++;
-    if (acc_count % ENTROPY_POOLS == 0) {
-        pools_size++;
+    accountEvents(1);
+    unlockSpinLock(&lock);
+}
+
+// Must be called with the lock held and interrupts disabled. Sample i goes into the same pool it
+// would have gone to if it was added as a separate event, but all samples for one pool are
+// compressed together.
+static void foldSampleBuffer(SampleBuffer* buffer) {
+    size_t count = buffer->count;
+    if (count != 0) {
+        initPoolsIfEmpty();
+        for (size_t i = 0; i < umin(count, ENTROPY_POOLS); i++) {
+            Bits256 block;
+            size_t size = 0;
+            for (size_t j = i; j < count && size < 6; j += ENTROPY_POOLS) {
+                block[2 + size] = buffer->samples[j];
+                size++;
+            }
+            block[0] = getTime();
+            block[1] = size;
+            memset(block + 2 + size, 0, (6 - size) * sizeof(uint32_t));
+            sha256Block(pools[(acc_count + i) % ENTROPY_POOLS], block);
+        }
+        accountEvents(count);
+        buffer->count = 0;
     }
+}
+
+static void foldSampleBufferWork(SampleBuffer* buffer) {
+    lockSpinLock(&lock);
+    foldSampleBuffer(buffer);
     unlockSpinLock(&lock);
 }
 
+static uint32_t mixSample(uint64_t cycles, uint64_t value) {
+    uint64_t x = cycles ^ ((value << 32) | (value >> 32));
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdUL;
+    x ^= x >> 33;
+    return x ^ (x >> 32);
+}
+
+static SampleBuffer* sampleBufferForCurrentHart() {
+    int index = hartIdToIndex(getCurrentHartId());
+    return index < MAX_HART_COUNT ? &sample_buffers[index] : NULL;
+}
+
+void addRandomSample(uint64_t value) {
+    SampleBuffer* buffer = sampleBufferForCurrentHart();
+    if (buffer == NULL) {
+        return;
+    }
+    uint32_t sample = mixSample(readCycles(), value);
+    if (buffer->count < SAMPLE_BUFFER_SIZE) {
+        buffer->samples[buffer->count] = sample;
+        buffer->count++;
+        if (buffer->count == SAMPLE_BUFFER_SIZE) {
+            if (buffer->fold.function == NULL) {
+                initDeferredWork(&buffer->fold, (DeferredFunction)foldSampleBufferWork, buffer);
+            }
+            queueDeferredWork(&buffer->fold);
+        }
+    } else {
+        // Still mix it in, but don't count it until the buffer was folded
+        buffer->samples[sample % SAMPLE_BUFFER_SIZE] ^= sample;
+    }
+}
+
 static void reseedRandom() {
     if (last_reseed == 0) {
         sha256Init(key);
@@ -301,6 +387,11 @@ static void randomBlock(Bits128 block) {
 
 void getRandom(VirtPtr bytes, size_t size) {
     lockSpinLock(&lock);
+    // Interrupts are disabled while holding the lock
+    SampleBuffer* buffer = sampleBufferForCurrentHart();
+    if (buffer != NULL) {
+        foldSampleBuffer(buffer);
+    }
     Time now = getTime();
     if (last_reseed == 0 || (last_reseed + CLOCKS_PER_SEC / 10 < now && pools_size >= MIN_RESEED_SIZE)) {
         reseedRandom();
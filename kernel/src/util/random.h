@@ -8,6 +8,11 @@
 
 void addRandomEvent(uint8_t* data, size_t size);
 
+// Cheap alternative to addRandomEvent for interrupt handlers. The cycle counter is mixed with the
+// given value into a buffer of the executing hart, which is later folded into the entropy pools.
+// Must be called with interrupts disabled, i.e. in a trap or hart context.
+void addRandomSample(uint64_t value);
+
 void getRandom(VirtPtr buffer, size_t size);
 
 #endif
@@ -0,0 +1,26 @@
+#include <stdarg.h>
+
+#include "util/text.h"
+
+#include "memory/kalloc.h"
+#include "util/util.h"
+
+void appendText(TextBuffer* buffer, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    size_t length = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+    if (buffer->length + length + 1 > buffer->capacity) {
+        size_t capacity = umax(buffer->capacity * 2, buffer->length + length + 1);
+        char* text = krealloc(buffer->text, capacity);
+        if (text == NULL) {
+            return;
+        }
+        buffer->text = text;
+        buffer->capacity = capacity;
+    }
+    va_start(args, fmt);
+    vsnprintf(buffer->text + buffer->length, length + 1, fmt, args);
+    va_end(args);
+    buffer->length += length;
+}
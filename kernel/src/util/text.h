@@ -25,4 +25,13 @@
     char NAME[_ ## NAME ## _size + 1]; \
     snprintf(NAME, _ ## NAME ## _size + 1, FMT __VA_OPT__(,) __VA_ARGS__); \
 
+typedef struct {
+    char* text;
+    size_t length;
+    size_t capacity;
+} TextBuffer;
+
+// Append formatted text to the buffer, growing it as needed. Text is dropped if out of memory.
+void appendText(TextBuffer* buffer, const char* fmt, ...);
+
 #endif
@@ -17,4 +17,7 @@ bool tryLockingUnsafeLock(UnsafeLock* lock);
 // Unlock simple spinlock with fences
 void unlockUnsafeLock(UnsafeLock* lock);
 
+// Tell the hart that we are busy waiting. This is the Zihintpause pause hint, a nop without it.
+void spinLoopHint();
+
 #endif
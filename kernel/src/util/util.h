@@ -16,6 +16,9 @@ int64_t smax(int64_t a, int64_t b);
 // Does nothing
 void noop();
 
+// Read the cycle counter of the current hart
+uint64_t readCycles();
+
 uint64_t hashInt64(uint64_t x);
 
 uint32_t hashInt32(uint32_t x);
@@ -11,8 +11,12 @@
 
 #include "args.h"
 #include "list.h"
+#include "ring.h"
 #include "util.h"
 
+#define COPY_CHUNK 4096
+#define COPY_BATCH 8
+
 typedef struct {
     const char* prog;
     bool no_clobber;
@@ -24,6 +28,8 @@ typedef struct {
     bool error;
     char* target;
     List files;
+    bool use_ring;
+    Ring ring;
 } Arguments;
 
 ARG_SPEC_FUNCTION(argumentSpec, Arguments*,
@@ -89,6 +95,98 @@ ARG_SPEC_FUNCTION(argumentSpec, Arguments*,
 
 static void copyPath(const char* src, const char* dst, Arguments* args);
 
+// Read and then write a batch of chunks with a single syscall each
+static bool copyContentsWithRing(int fsrc, int fdst, Ring* ring) {
+    static char buffers[COPY_BATCH][COPY_CHUNK];
+    uint64_t offset = 0;
+    bool end = false;
+    while (!end) {
+        for (size_t i = 0; i < COPY_BATCH; i++) {
+            RingSubmission* sub = ringGetSubmission(ring);
+            sub->opcode = RING_OP_READ;
+            sub->fd = fsrc;
+            sub->addr = (uintptr_t)buffers[i];
+            sub->length = COPY_CHUNK;
+            sub->offset = offset + i * COPY_CHUNK;
+            sub->user_data = i;
+        }
+        if (ringSubmit(ring) < 0) {
+            return false;
+        }
+        int64_t sizes[COPY_BATCH];
+        for (size_t i = 0; i < COPY_BATCH; i++) {
+            RingCompletion completion;
+            ringWaitCompletion(ring, &completion);
+            sizes[completion.user_data] = completion.result;
+        }
+        size_t writes = 0;
+        bool short_read = false;
+        // Only a read of nothing is the end. After a short read, the later chunks of the batch do
+        // not continue the data, so they are read again in the next batch.
+        for (size_t i = 0; i < COPY_BATCH && !end && !short_read; i++) {
+            if (sizes[i] < 0) {
+                errno = -sizes[i];
+                return false;
+            } else if (sizes[i] == 0) {
+                end = true;
+            } else {
+                RingSubmission* sub = ringGetSubmission(ring);
+                sub->opcode = RING_OP_WRITE;
+                sub->fd = fdst;
+                sub->addr = (uintptr_t)buffers[i];
+                sub->length = sizes[i];
+                sub->offset = offset;
+                sub->user_data = sizes[i];
+                offset += sizes[i];
+                writes++;
+                short_read = sizes[i] < COPY_CHUNK;
+            }
+        }
+        if (writes != 0 && ringSubmit(ring) < 0) {
+            return false;
+        }
+        bool failed = false;
+        for (size_t i = 0; i < writes; i++) {
+            RingCompletion completion;
+            ringWaitCompletion(ring, &completion);
+            if (completion.result < 0) {
+                errno = -completion.result;
+                failed = true;
+            } else if ((uint64_t)completion.result != completion.user_data) {
+                errno = EIO;
+                failed = true;
+            }
+        }
+        if (failed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool copyContents(int fsrc, int fdst, Arguments* args) {
+    if (args->use_ring) {
+        return copyContentsWithRing(fsrc, fdst, &args->ring);
+    }
+    char buffer[COPY_CHUNK];
+    ssize_t size;
+    do {
+        size = read(fsrc, buffer, COPY_CHUNK);
+        if (size < 0) {
+            return false;
+        }
+        ssize_t written = 0;
+        while (written < size) {
+            ssize_t part = write(fdst, buffer + written, size - written);
+            if (part < 0) {
+                return false;
+            }
+            written += part;
+        }
+    } while (size != 0);
+    return true;
+}
+
 static void copyFile(const char* src, const char* dst, Arguments* args) {
     struct stat src_stat;
     if (stat(src, &src_stat) != 0) {
@@ -119,8 +217,6 @@ static void copyFile(const char* src, const char* dst, Arguments* args) {
                 printf("linked '%s' to '%s'\n", src, dst);
             }
         } else {
-            size_t tmp_size;
-            char buffer[1024];
             int fsrc = open(src, O_RDONLY);
             if (fsrc < 0) {
                 args->error = true;
@@ -140,13 +236,13 @@ static void copyFile(const char* src, const char* dst, Arguments* args) {
                 fprintf(stderr, "%s: cannot open '%s': %s\n", args->prog, dst, strerror(errno));
                 return;
             }
-            do {
-                tmp_size = read(fsrc, buffer, 1024);
-                size_t left = tmp_size;
-                while (left > 0) {
-                    left -= write(fdst, buffer, tmp_size);
-                }
-            } while (tmp_size != 0);
+            if (!copyContents(fsrc, fdst, args)) {
+                args->error = true;
+                fprintf(stderr, "%s: cannot copy '%s' to '%s': %s\n", args->prog, src, dst, strerror(errno));
+                close(fsrc);
+                close(fdst);
+                return;
+            }
             close(fsrc);
             close(fdst);
             if (args->verbose) {
@@ -244,6 +340,7 @@ int main(int argc, const char* const* argv) {
     args.target = NULL;
     initList(&args.files);
     ARG_PARSE_ARGS(argumentSpec, argc, argv, &args);
+    args.use_ring = ringSetup(&args.ring, COPY_BATCH, 0) == 0;
     bool is_dir = false;
     struct stat dst;
     if (stat(args.target, &dst) != 0) {
@@ -269,6 +366,9 @@ int main(int argc, const char* const* argv) {
         char* path = LIST_GET(char*, args.files, 0);
         copyPath(path, args.target, &args);
     }
+    if (args.use_ring) {
+        ringDestroy(&args.ring);
+    }
     deinitListAndContents(&args.files);
     free(args.target);
     return args.error ? 1 : 0;
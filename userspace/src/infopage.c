@@ -0,0 +1,90 @@
+
+#include <stdbool.h>
+
+#include "infopage.h"
+
+#define NANOS_PER_SEC 1000000000UL
+
+static uint32_t beginInfoRead(volatile uint32_t* seq) {
+    uint32_t value;
+    do {
+        value = *seq;
+    } while ((value & 1) != 0);
+    __asm__ volatile ("fence r, r" ::: "memory");
+    return value;
+}
+
+static bool retryInfoRead(volatile uint32_t* seq, uint32_t value) {
+    __asm__ volatile ("fence r, r" ::: "memory");
+    return *seq != value;
+}
+
+static uint64_t readTimeCsr() {
+    uint64_t time;
+    __asm__ volatile ("rdtime %0" : "=r" (time));
+    return time;
+}
+
+static uint64_t clocksToNanos(uint64_t clocks, uint64_t frequency) {
+    return (clocks / frequency) * NANOS_PER_SEC + (clocks % frequency) * NANOS_PER_SEC / frequency;
+}
+
+uint64_t infoMonotonicNanos() {
+    volatile SystemInfo* info = (volatile SystemInfo*)SYSTEM_INFO_ADDR;
+    return clocksToNanos(readTimeCsr(), info->time_frequency);
+}
+
+uint64_t infoRealtimeNanos() {
+    volatile SystemInfo* info = (volatile SystemInfo*)SYSTEM_INFO_ADDR;
+    uint32_t seq;
+    uint64_t nanos;
+    do {
+        seq = beginInfoRead(&info->seq);
+        nanos = clocksToNanos(readTimeCsr(), info->time_frequency) + info->wall_offset;
+    } while (retryInfoRead(&info->seq, seq));
+    return nanos;
+}
+
+void infoGettime(struct timespec* time) {
+    uint64_t nanos = infoRealtimeNanos();
+    time->tv_sec = nanos / NANOS_PER_SEC;
+    time->tv_nsec = nanos % NANOS_PER_SEC;
+}
+
+void infoProcess(ProcessInfo* copy) {
+    volatile ProcessInfo* info = (volatile ProcessInfo*)PROCESS_INFO_ADDR;
+    uint32_t seq;
+    do {
+        seq = beginInfoRead(&info->seq);
+        copy->seq = seq;
+        copy->pid = info->pid;
+        copy->ppid = info->ppid;
+        copy->uid = info->uid;
+        copy->gid = info->gid;
+        copy->euid = info->euid;
+        copy->egid = info->egid;
+    } while (retryInfoRead(&info->seq, seq));
+}
+
+pid_t infoGetpid() {
+    // The pid of a process never changes, no need to check the sequence number
+    return ((volatile ProcessInfo*)PROCESS_INFO_ADDR)->pid;
+}
+
+pid_t infoGetppid() {
+    ProcessInfo info;
+    infoProcess(&info);
+    return info.ppid;
+}
+
+uid_t infoGetuid() {
+    ProcessInfo info;
+    infoProcess(&info);
+    return info.uid;
+}
+
+gid_t infoGetgid() {
+    ProcessInfo info;
+    infoProcess(&info);
+    return info.gid;
+}
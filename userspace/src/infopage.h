@@ -0,0 +1,51 @@
+#ifndef _INFOPAGE_H_
+#define _INFOPAGE_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+// Read the time and the process ids from the pages the kernel maps into every process, without
+// making a syscall. The layout must match kernel/src/process/infopage.h.
+
+#define USER_INFO_ADDR ((1UL << 38) - (1UL << 19) - 3 * 4096)
+#define SYSTEM_INFO_ADDR USER_INFO_ADDR
+#define PROCESS_INFO_ADDR (USER_INFO_ADDR + 4096)
+
+typedef struct {
+    uint32_t seq;
+    uint32_t reserved;
+    uint64_t time_frequency;
+    int64_t wall_offset;
+} SystemInfo;
+
+typedef struct {
+    uint32_t seq;
+    int pid;
+    int ppid;
+    int uid;
+    int gid;
+    int euid;
+    int egid;
+} ProcessInfo;
+
+// Nanoseconds since the system was started
+uint64_t infoMonotonicNanos();
+
+// Nanoseconds since the epoch, like the SYSCALL_GET_NANOSECONDS syscall
+uint64_t infoRealtimeNanos();
+
+void infoGettime(struct timespec* time);
+
+// Returns a consistent copy of the process page
+void infoProcess(ProcessInfo* info);
+
+pid_t infoGetpid();
+
+pid_t infoGetppid();
+
+uid_t infoGetuid();
+
+gid_t infoGetgid();
+
+#endif
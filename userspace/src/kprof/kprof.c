@@ -0,0 +1,294 @@
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "args.h"
+
+// Samples the kernel for a while, then prints a flat profile of the sampled functions, or the
+// sampled stacks in the folded format used by flame graph tools.
+
+#define PROFILE_DEVICE "/dev/profile"
+#define SYMBOLS_DEVICE "/dev/ksyms"
+#define MAX_NAME_LENGTH 128
+
+// Must match the kernel (task/profile.h)
+#define PROFILE_MAX_DEPTH 8
+
+typedef struct {
+    uint64_t time;
+    int32_t tid;
+    uint8_t hart;
+    uint8_t flags;
+    uint8_t depth;
+    uint8_t reserved;
+    uint64_t pc;
+    uint64_t stack[PROFILE_MAX_DEPTH];
+} ProfileSample;
+
+#define FLAG_USER (1 << 0)
+#define FLAG_KERNEL (1 << 1)
+#define FLAG_IDLE (1 << 2)
+
+typedef struct {
+    uint64_t addr;
+    char* name;
+} Symbol;
+
+typedef struct {
+    char* name;
+    size_t count;
+} Entry;
+
+typedef struct {
+    const char* prog;
+    size_t duration;
+    size_t top;
+    bool backtrace;
+    bool folded;
+    bool idle;
+} Arguments;
+
+static bool parseNumber(const char* value, size_t* out) {
+    size_t number = 0;
+    if (*value == 0) {
+        return false;
+    }
+    while (*value >= '0' && *value <= '9') {
+        number = 10 * number + *value - '0';
+        value++;
+    }
+    *out = number;
+    return *value == 0;
+}
+
+ARG_SPEC_FUNCTION(argumentSpec, Arguments*, "kprof [options]", {
+    // Options
+    ARG_VALUED('t', "time", {
+        if (!parseNumber(value, &context->duration) || context->duration == 0) {
+            ARG_WARN("invalid duration");
+        }
+    }, false, "=<ms>", "time to sample for (default 1000)");
+    ARG_VALUED('n', "top", {
+        if (!parseNumber(value, &context->top)) {
+            ARG_WARN("invalid number");
+        }
+    }, false, "=<count>", "number of functions in the flat profile (default 20, 0 for all)");
+    ARG_FLAG('b', "backtrace", {
+        context->backtrace = true;
+    }, "record backtraces (needs a kernel built with frame pointers)");
+    ARG_FLAG('f', "folded", {
+        context->folded = true;
+        context->backtrace = true;
+    }, "print folded stacks for flame graphs instead of the flat profile");
+    ARG_FLAG('i', "idle", {
+        context->idle = true;
+    }, "include samples taken in the idle task");
+    ARG_FLAG(0, "help", {
+        ARG_PRINT_HELP(argumentSpec, NULL);
+        exit(0);
+    }, "display this help and exit");
+}, {
+    // Default
+    const char* option = value;
+    ARG_WARN("extra operand");
+}, {
+    // Warning
+    if (option != NULL) {
+        fprintf(stderr, "%s: '%s': %s\n", argv[0], option, warning);
+    } else {
+        fprintf(stderr, "%s: %s\n", argv[0], warning);
+    }
+    exit(2);
+})
+
+static Symbol* symbols = NULL;
+static size_t symbol_count = 0;
+
+static void loadSymbols() {
+    FILE* file = fopen(SYMBOLS_DEVICE, "r");
+    if (file == NULL) {
+        return;
+    }
+    size_t capacity = 0;
+    char line[MAX_NAME_LENGTH + 32];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char* end;
+        uint64_t addr = strtoull(line, &end, 16);
+        if (*end != ' ') {
+            continue;
+        }
+        char* name = end + 1;
+        name[strcspn(name, "\n")] = 0;
+        if (symbol_count == capacity) {
+            capacity = capacity == 0 ? 1024 : 2 * capacity;
+            symbols = realloc(symbols, capacity * sizeof(Symbol));
+        }
+        symbols[symbol_count].addr = addr;
+        symbols[symbol_count].name = strdup(name);
+        symbol_count++;
+    }
+    fclose(file);
+}
+
+// Without symbols, the address is printed so that it can be resolved on the host
+static void symbolize(uint64_t addr, char* name) {
+    size_t start = 0;
+    size_t end = symbol_count;
+    while (start < end) {
+        size_t mid = (start + end) / 2;
+        if (symbols[mid].addr <= addr) {
+            start = mid + 1;
+        } else {
+            end = mid;
+        }
+    }
+    if (start == 0) {
+        snprintf(name, MAX_NAME_LENGTH, "%#lx", addr);
+    } else {
+        snprintf(name, MAX_NAME_LENGTH, "%s", symbols[start - 1].name);
+    }
+}
+
+static void sampleName(ProfileSample* sample, char* name) {
+    if ((sample->flags & FLAG_USER) != 0) {
+        snprintf(name, MAX_NAME_LENGTH, "[user]");
+    } else {
+        symbolize(sample->pc, name);
+    }
+}
+
+static Entry* entries = NULL;
+static size_t entry_count = 0;
+
+static void countEntry(const char* name) {
+    for (size_t i = 0; i < entry_count; i++) {
+        if (strcmp(entries[i].name, name) == 0) {
+            entries[i].count++;
+            return;
+        }
+    }
+    entries = realloc(entries, (entry_count + 1) * sizeof(Entry));
+    entries[entry_count].name = strdup(name);
+    entries[entry_count].count = 1;
+    entry_count++;
+}
+
+static int compareEntries(const void* a, const void* b) {
+    const Entry* ea = a;
+    const Entry* eb = b;
+    return ea->count > eb->count ? -1 : (ea->count < eb->count ? 1 : strcmp(ea->name, eb->name));
+}
+
+static void printFlatProfile(ProfileSample* samples, size_t count, size_t top) {
+    for (size_t i = 0; i < count; i++) {
+        char name[MAX_NAME_LENGTH];
+        sampleName(&samples[i], name);
+        countEntry(name);
+    }
+    qsort(entries, entry_count, sizeof(Entry), compareEntries);
+    printf("%8s %8s  %s\n", "self", "samples", "function");
+    for (size_t i = 0; i < entry_count && (top == 0 || i < top); i++) {
+        size_t percent = 10000 * entries[i].count / count;
+        printf("%5zu.%02zu%% %8zu  %s\n", percent / 100, percent % 100, entries[i].count, entries[i].name);
+    }
+}
+
+static void printFoldedStacks(ProfileSample* samples, size_t count) {
+    // Stacks are written from the outermost frame, with the task as the root
+    for (size_t i = 0; i < count; i++) {
+        ProfileSample* sample = &samples[i];
+        char stack[(PROFILE_MAX_DEPTH + 2) * (MAX_NAME_LENGTH + 1)];
+        char name[MAX_NAME_LENGTH];
+        size_t length;
+        if ((sample->flags & FLAG_IDLE) != 0) {
+            length = snprintf(stack, sizeof(stack), "idle");
+        } else if ((sample->flags & FLAG_USER) != 0) {
+            length = snprintf(stack, sizeof(stack), "tid %d", sample->tid);
+        } else {
+            length = snprintf(stack, sizeof(stack), "tid %d (kernel)", sample->tid);
+        }
+        for (size_t j = sample->depth; j > 0; j--) {
+            // The return address points after the call
+            symbolize(sample->stack[j - 1] - 1, name);
+            length += snprintf(stack + length, sizeof(stack) - length, ";%s", name);
+        }
+        sampleName(sample, name);
+        snprintf(stack + length, sizeof(stack) - length, ";%s", name);
+        countEntry(stack);
+    }
+    for (size_t i = 0; i < entry_count; i++) {
+        printf("%s %zu\n", entries[i].name, entries[i].count);
+    }
+}
+
+int main(int argc, const char* const* argv) {
+    Arguments args = {
+        .prog = argv[0],
+        .duration = 1000,
+        .top = 20,
+        .backtrace = false,
+        .folded = false,
+        .idle = false,
+    };
+    ARG_PARSE_ARGS(argumentSpec, argc, argv, &args);
+    int fd = open(PROFILE_DEVICE, O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s: %s\n", args.prog, PROFILE_DEVICE, strerror(errno));
+        return 1;
+    }
+    // Throw away samples of an earlier run
+    ProfileSample discard[16];
+    while (read(fd, discard, sizeof(discard)) > 0) {
+        // Nothing to do
+    }
+    write(fd, args.backtrace ? "2" : "1", 1);
+    size_t count = 0;
+    size_t capacity = 4096;
+    ProfileSample* samples = malloc(capacity * sizeof(ProfileSample));
+    // Drain every 10ms so that the kernel buffers do not overflow
+    struct timespec step = { .tv_sec = 0, .tv_nsec = 10000000 };
+    for (size_t elapsed = 0; elapsed < args.duration; elapsed += 10) {
+        nanosleep(&step, NULL);
+        ssize_t len;
+        do {
+            if (count == capacity) {
+                capacity *= 2;
+                samples = realloc(samples, capacity * sizeof(ProfileSample));
+            }
+            len = read(fd, samples + count, (capacity - count) * sizeof(ProfileSample));
+            if (len > 0) {
+                count += len / sizeof(ProfileSample);
+            }
+        } while (len > 0);
+    }
+    write(fd, "0", 1);
+    close(fd);
+    size_t idle = 0;
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        if ((samples[i].flags & FLAG_IDLE) != 0) {
+            idle++;
+        }
+        if (args.idle || (samples[i].flags & FLAG_IDLE) == 0) {
+            samples[kept] = samples[i];
+            kept++;
+        }
+    }
+    loadSymbols();
+    if (args.folded) {
+        printFoldedStacks(samples, kept);
+    } else {
+        printf("%zu samples in %zu ms, %zu idle\n", count, args.duration, idle);
+        if (kept != 0) {
+            printFlatProfile(samples, kept, args.top);
+        }
+    }
+    free(samples);
+    return 0;
+}
@@ -0,0 +1,109 @@
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include "ring.h"
+
+#define SYSCALL_YIELD 2
+#define SYSCALL_RING_SETUP 77
+#define SYSCALL_RING_ENTER 78
+
+static intptr_t ringSyscall(uintptr_t _kind, uintptr_t _arg0, uintptr_t _arg1, uintptr_t _arg2) {
+    register uintptr_t kind asm("a0") = _kind;
+    register uintptr_t arg0 asm("a1") = _arg0;
+    register uintptr_t arg1 asm("a2") = _arg1;
+    register uintptr_t arg2 asm("a3") = _arg2;
+    register uintptr_t result asm("a0");
+    asm volatile(
+        "ecall;"
+        : "=r" (result)
+        : "0" (kind), "r" (arg0), "r" (arg1), "r" (arg2)
+        : "memory"
+    );
+    return result;
+}
+
+int ringSetup(Ring* ring, uint32_t entries, int flags) {
+    size_t size = sizeof(RingHeader) + entries * (sizeof(RingSubmission) + sizeof(RingCompletion));
+    ring->header = malloc(size);
+    if (ring->header == NULL) {
+        return -1;
+    }
+    intptr_t result = ringSyscall(SYSCALL_RING_SETUP, (uintptr_t)ring->header, entries, flags);
+    if (result < 0) {
+        free(ring->header);
+        ring->header = NULL;
+        errno = -result;
+        return -1;
+    }
+    ring->submissions = (RingSubmission*)(ring->header + 1);
+    ring->completions = (RingCompletion*)(ring->submissions + entries);
+    ring->entries = entries;
+    ring->sq_tail = 0;
+    ring->flags = flags;
+    return 0;
+}
+
+void ringDestroy(Ring* ring) {
+    ringSyscall(SYSCALL_RING_SETUP, 0, 0, 0);
+    free(ring->header);
+    ring->header = NULL;
+}
+
+RingSubmission* ringGetSubmission(Ring* ring) {
+    uint32_t head = __atomic_load_n(&ring->header->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_tail - head >= ring->entries) {
+        return NULL;
+    }
+    RingSubmission* submission = &ring->submissions[ring->sq_tail % ring->entries];
+    ring->sq_tail++;
+    submission->reserved[0] = 0;
+    submission->reserved[1] = 0;
+    submission->reserved[2] = 0;
+    submission->offset = RING_NO_OFFSET;
+    return submission;
+}
+
+int ringSubmit(Ring* ring) {
+    uint32_t pending = ring->sq_tail - __atomic_load_n(&ring->header->sq_tail, __ATOMIC_RELAXED);
+    // The submissions must be visible before the tail
+    __atomic_store_n(&ring->header->sq_tail, ring->sq_tail, __ATOMIC_RELEASE);
+    if ((ring->flags & RING_SETUP_POLL) != 0) {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if ((__atomic_load_n(&ring->header->flags, __ATOMIC_ACQUIRE) & RING_NEED_WAKEUP) != 0) {
+            ringSyscall(SYSCALL_RING_ENTER, 0, 0, 0);
+        }
+        return pending;
+    }
+    // This includes submissions that did not fit into the completion ring before
+    uint32_t unsubmitted = ring->sq_tail - __atomic_load_n(&ring->header->sq_head, __ATOMIC_ACQUIRE);
+    intptr_t result = ringSyscall(SYSCALL_RING_ENTER, unsubmitted, 0, 0);
+    if (result < 0) {
+        errno = -result;
+        return -1;
+    }
+    return result;
+}
+
+bool ringPeekCompletion(Ring* ring, RingCompletion* completion) {
+    uint32_t head = ring->header->cq_head;
+    if (head == __atomic_load_n(&ring->header->cq_tail, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    *completion = ring->completions[head % ring->entries];
+    __atomic_store_n(&ring->header->cq_head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+void ringWaitCompletion(Ring* ring, RingCompletion* completion) {
+    while (!ringPeekCompletion(ring, completion)) {
+        if ((__atomic_load_n(&ring->header->flags, __ATOMIC_ACQUIRE) & RING_NEED_WAKEUP) != 0) {
+            ringSyscall(SYSCALL_RING_ENTER, 0, 0, 0);
+        } else if ((ring->flags & RING_SETUP_POLL) != 0) {
+            ringSyscall(SYSCALL_YIELD, 0, 0, 0);
+        } else {
+            // Submissions that did not fit into the completion queue before
+            ringSyscall(SYSCALL_RING_ENTER, ring->sq_tail - ring->header->sq_head, 0, 0);
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef _RING_H_
+#define _RING_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Submit many file operations with a single syscall. The layout must match
+// kernel/src/files/ring.h.
+
+#define RING_OP_NOP 0
+#define RING_OP_READ 1
+#define RING_OP_WRITE 2
+#define RING_OP_OPENAT 3
+#define RING_OP_CLOSE 4
+#define RING_OP_FSTAT 5
+#define RING_OP_FSYNC 6
+
+#define RING_AT_FDCWD -100
+#define RING_NO_OFFSET UINT64_MAX
+
+#define RING_SETUP_POLL (1 << 0)
+#define RING_NEED_WAKEUP (1 << 0)
+
+typedef struct {
+    uint8_t opcode;
+    uint8_t reserved[3];
+    int32_t fd;
+    uint32_t flags;
+    uint32_t mode;
+    uint64_t addr;
+    uint64_t length;
+    uint64_t offset;
+    uint64_t user_data;
+} RingSubmission;
+
+typedef struct {
+    uint64_t user_data;
+    int64_t result;
+} RingCompletion;
+
+typedef struct {
+    uint32_t sq_head;
+    uint32_t sq_tail;
+    uint32_t cq_head;
+    uint32_t cq_tail;
+    uint32_t entries;
+    uint32_t flags;
+} RingHeader;
+
+typedef struct {
+    RingHeader* header;
+    RingSubmission* submissions;
+    RingCompletion* completions;
+    uint32_t entries;
+    uint32_t sq_tail; // Submissions before this are written, but maybe not yet submitted
+    int flags;
+} Ring;
+
+// Allocate a ring with the given power of two number of entries and register it with the kernel.
+// Returns 0 on success and sets errno otherwise.
+int ringSetup(Ring* ring, uint32_t entries, int flags);
+
+// Unregister and free the ring
+void ringDestroy(Ring* ring);
+
+// Returns the next free submission, or NULL if the ring is full
+RingSubmission* ringGetSubmission(Ring* ring);
+
+// Submit all submissions returned by ringGetSubmission. Returns the number of submitted
+// operations, or -1 and sets errno.
+int ringSubmit(Ring* ring);
+
+// Take the next completion, returns false if there is none
+bool ringPeekCompletion(Ring* ring, RingCompletion* completion);
+
+// Take the next completion, waiting for it if necessary
+void ringWaitCompletion(Ring* ring, RingCompletion* completion);
+
+#endif
@@ -0,0 +1,203 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "args.h"
+#include "infopage.h"
+
+// Runs a number of CPU hogs next to an interactive task that echoes bytes through a pair of pipes.
+// Reports the round trip latency of the interactive task and how evenly the hogs shared the harts.
+
+typedef struct {
+    const char* prog;
+    size_t hogs;
+    size_t rounds;
+    size_t delay;
+} Arguments;
+
+static bool parseNumber(const char* value, size_t* out) {
+    size_t number = 0;
+    if (*value == 0) {
+        return false;
+    }
+    while (*value >= '0' && *value <= '9') {
+        number = 10 * number + *value - '0';
+        value++;
+    }
+    *out = number;
+    return *value == 0;
+}
+
+ARG_SPEC_FUNCTION(argumentSpec, Arguments*, "schedbench [options]", {
+    // Options
+    ARG_VALUED('c', "hogs", {
+        if (!parseNumber(value, &context->hogs)) {
+            ARG_WARN("invalid number of hogs");
+        }
+    }, false, "=<number>", "number of cpu bound processes to start (default 4)");
+    ARG_VALUED('r', "rounds", {
+        if (!parseNumber(value, &context->rounds) || context->rounds == 0) {
+            ARG_WARN("invalid number of rounds");
+        }
+    }, false, "=<number>", "number of echo round trips to measure (default 200)");
+    ARG_VALUED('d', "delay", {
+        if (!parseNumber(value, &context->delay)) {
+            ARG_WARN("invalid delay");
+        }
+    }, false, "=<ms>", "time the interactive task sleeps between round trips (default 5)");
+    ARG_FLAG(0, "help", {
+        ARG_PRINT_HELP(argumentSpec, NULL);
+        exit(0);
+    }, "display this help and exit");
+}, {
+    // Default
+    const char* option = value;
+    ARG_WARN("extra operand");
+}, {
+    // Warning
+    if (option != NULL) {
+        fprintf(stderr, "%s: '%s': %s\n", argv[0], option, warning);
+    } else {
+        fprintf(stderr, "%s: %s\n", argv[0], warning);
+    }
+    exit(2);
+})
+
+static volatile sig_atomic_t hog_stop = 0;
+
+static void hogStopHandler(int signal) {
+    hog_stop = 1;
+}
+
+static void runHog(int result_fd) {
+    signal(SIGTERM, hogStopHandler);
+    unsigned long count = 0;
+    while (!hog_stop) {
+        count++;
+    }
+    write(result_fd, &count, sizeof(count));
+    exit(0);
+}
+
+static void runEcho(int in_fd, int out_fd) {
+    char byte;
+    while (read(in_fd, &byte, 1) == 1) {
+        write(out_fd, &byte, 1);
+    }
+    exit(0);
+}
+
+static uint64_t getMicroseconds() {
+    // Read from the info page, a syscall would add to the measured latency
+    return infoMonotonicNanos() / 1000;
+}
+
+static void sleepMilliseconds(size_t ms) {
+    struct timespec time = {
+        .tv_sec = ms / 1000,
+        .tv_nsec = (ms % 1000) * 1000000UL,
+    };
+    while (nanosleep(&time, &time) != 0 && errno == EINTR);
+}
+
+static int compareLatencies(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+int main(int argc, const char* const* argv) {
+    Arguments args = {
+        .prog = argv[0],
+        .hogs = 4,
+        .rounds = 200,
+        .delay = 5,
+    };
+    ARG_PARSE_ARGS(argumentSpec, argc, argv, &args);
+    int result_pipe[2];
+    int to_echo[2];
+    int from_echo[2];
+    if (pipe(result_pipe) != 0 || pipe(to_echo) != 0 || pipe(from_echo) != 0) {
+        fprintf(stderr, "%s: failed to create pipes: %s\n", args.prog, strerror(errno));
+        return 1;
+    }
+    pid_t* hogs = malloc(sizeof(pid_t) * args.hogs);
+    for (size_t i = 0; i < args.hogs; i++) {
+        hogs[i] = fork();
+        if (hogs[i] == 0) {
+            runHog(result_pipe[1]);
+        } else if (hogs[i] < 0) {
+            fprintf(stderr, "%s: failed to fork: %s\n", args.prog, strerror(errno));
+            return 1;
+        }
+    }
+    pid_t echo = fork();
+    if (echo == 0) {
+        close(to_echo[1]);
+        close(from_echo[0]);
+        runEcho(to_echo[0], from_echo[1]);
+    }
+    close(to_echo[0]);
+    close(from_echo[1]);
+    uint64_t* latencies = malloc(sizeof(uint64_t) * args.rounds);
+    uint64_t start = getMicroseconds();
+    for (size_t i = 0; i < args.rounds; i++) {
+        char byte = 'x';
+        uint64_t before = getMicroseconds();
+        if (write(to_echo[1], &byte, 1) != 1 || read(from_echo[0], &byte, 1) != 1) {
+            fprintf(stderr, "%s: echo failed: %s\n", args.prog, strerror(errno));
+            return 1;
+        }
+        latencies[i] = getMicroseconds() - before;
+        sleepMilliseconds(args.delay);
+    }
+    uint64_t elapsed = getMicroseconds() - start;
+    close(to_echo[1]);
+    close(from_echo[0]);
+    waitpid(echo, NULL, 0);
+    unsigned long min_count = (unsigned long)-1;
+    unsigned long max_count = 0;
+    unsigned long total_count = 0;
+    for (size_t i = 0; i < args.hogs; i++) {
+        kill(hogs[i], SIGTERM);
+    }
+    for (size_t i = 0; i < args.hogs; i++) {
+        unsigned long count;
+        if (read(result_pipe[0], &count, sizeof(count)) == sizeof(count)) {
+            min_count = count < min_count ? count : min_count;
+            max_count = count > max_count ? count : max_count;
+            total_count += count;
+        }
+    }
+    for (size_t i = 0; i < args.hogs; i++) {
+        waitpid(hogs[i], NULL, 0);
+    }
+    qsort(latencies, args.rounds, sizeof(uint64_t), compareLatencies);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < args.rounds; i++) {
+        sum += latencies[i];
+    }
+    printf("%zu hogs, %zu rounds in %lu ms\n", args.hogs, args.rounds, elapsed / 1000);
+    printf(
+        "echo latency (us): min %lu avg %lu p50 %lu p99 %lu max %lu\n",
+        latencies[0], sum / args.rounds, latencies[args.rounds / 2],
+        latencies[args.rounds * 99 / 100], latencies[args.rounds - 1]
+    );
+    if (args.hogs > 0) {
+        printf(
+            "hog iterations: min %lu avg %lu max %lu (min/max %lu%%)\n",
+            min_count, total_count / args.hogs, max_count,
+            max_count == 0 ? 100 : min_count * 100 / max_count
+        );
+    }
+    free(latencies);
+    free(hogs);
+    return 0;
+}
@@ -0,0 +1,263 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "args.h"
+
+// Enables scheduler tracing for a while, then prints a histogram of the run and wait times of
+// every task that was seen. Wait time is the time between becoming runnable and running.
+
+#define TRACE_DEVICE "/dev/schedtrace"
+#define BUCKETS 24 // Power of two buckets in microseconds, the last one takes everything above
+
+// Must match the kernel (task/schedtrace.h)
+typedef struct {
+    uint64_t time;
+    int32_t tid;
+    uint8_t hart;
+    uint8_t kind;
+    uint8_t data;
+    uint8_t flags;
+} SchedTraceEvent;
+
+#define EVENT_SWITCH_IN 1
+#define EVENT_SWITCH_OUT 2
+#define EVENT_WAKEUP 3
+#define EVENT_BLOCK 4
+#define EVENT_MIGRATE 5
+#define EVENT_DROPPED 6 // tid is the number of events lost since the last one
+
+#define FLAG_KERNEL (1 << 0)
+
+static const char* block_reasons[] = { "syscall", "lock", "futex", "io" };
+
+typedef struct {
+    int32_t tid;
+    bool kernel;
+    uint64_t running_since;  // 0 if not running
+    uint64_t runnable_since; // 0 if not runnable
+    uint64_t run_total;
+    size_t switches;
+    size_t migrations;
+    size_t blocks[4];
+    size_t run[BUCKETS];
+    size_t wait[BUCKETS];
+} TaskStats;
+
+typedef struct {
+    const char* prog;
+    size_t duration;
+    bool kernel;
+} Arguments;
+
+static bool parseNumber(const char* value, size_t* out) {
+    size_t number = 0;
+    if (*value == 0) {
+        return false;
+    }
+    while (*value >= '0' && *value <= '9') {
+        number = 10 * number + *value - '0';
+        value++;
+    }
+    *out = number;
+    return *value == 0;
+}
+
+ARG_SPEC_FUNCTION(argumentSpec, Arguments*, "schedtrace [options]", {
+    // Options
+    ARG_VALUED('t', "time", {
+        if (!parseNumber(value, &context->duration) || context->duration == 0) {
+            ARG_WARN("invalid duration");
+        }
+    }, false, "=<ms>", "time to trace for (default 1000)");
+    ARG_FLAG('k', "kernel", {
+        context->kernel = true;
+    }, "also show kernel tasks, e.g. syscall tasks working for a thread");
+    ARG_FLAG(0, "help", {
+        ARG_PRINT_HELP(argumentSpec, NULL);
+        exit(0);
+    }, "display this help and exit");
+}, {
+    // Default
+    const char* option = value;
+    ARG_WARN("extra operand");
+}, {
+    // Warning
+    if (option != NULL) {
+        fprintf(stderr, "%s: '%s': %s\n", argv[0], option, warning);
+    } else {
+        fprintf(stderr, "%s: %s\n", argv[0], warning);
+    }
+    exit(2);
+})
+
+static int compareEvents(const void* a, const void* b) {
+    const SchedTraceEvent* ea = a;
+    const SchedTraceEvent* eb = b;
+    return ea->time < eb->time ? -1 : (ea->time > eb->time ? 1 : 0);
+}
+
+static size_t bucketFor(uint64_t ns) {
+    uint64_t us = ns / 1000;
+    size_t bucket = 0;
+    while (us > 1 && bucket < BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static TaskStats* tasks = NULL;
+static size_t task_count = 0;
+static size_t dropped = 0;
+
+static TaskStats* findTask(int32_t tid, bool kernel) {
+    for (size_t i = 0; i < task_count; i++) {
+        if (tasks[i].tid == tid && tasks[i].kernel == kernel) {
+            return &tasks[i];
+        }
+    }
+    tasks = realloc(tasks, (task_count + 1) * sizeof(TaskStats));
+    TaskStats* task = &tasks[task_count];
+    task_count++;
+    memset(task, 0, sizeof(TaskStats));
+    task->tid = tid;
+    task->kernel = kernel;
+    return task;
+}
+
+static void processEvent(SchedTraceEvent* event) {
+    if (event->kind == EVENT_DROPPED) {
+        dropped += event->tid;
+        return;
+    }
+    TaskStats* task = findTask(event->tid, (event->flags & FLAG_KERNEL) != 0);
+    switch (event->kind) {
+        case EVENT_SWITCH_IN:
+            if (task->runnable_since != 0) {
+                task->wait[bucketFor(event->time - task->runnable_since)]++;
+            }
+            task->runnable_since = 0;
+            task->running_since = event->time;
+            task->switches++;
+            break;
+        case EVENT_SWITCH_OUT:
+            if (task->running_since != 0) {
+                uint64_t time = event->time - task->running_since;
+                task->run[bucketFor(time)]++;
+                task->run_total += time;
+            }
+            // Unless it blocks, the task is enqueued again right away
+            task->running_since = 0;
+            task->runnable_since = event->time;
+            break;
+        case EVENT_WAKEUP:
+            task->runnable_since = event->time;
+            break;
+        case EVENT_BLOCK:
+            task->runnable_since = 0;
+            if (event->data < 4) {
+                task->blocks[event->data]++;
+            }
+            break;
+        case EVENT_MIGRATE:
+            task->migrations++;
+            break;
+    }
+}
+
+static void printHistogram(const char* name, size_t* buckets) {
+    size_t max = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+        max = buckets[i] > max ? buckets[i] : max;
+    }
+    if (max == 0) {
+        return;
+    }
+    printf("  %s (us):\n", name);
+    for (size_t i = 0; i < BUCKETS; i++) {
+        if (buckets[i] != 0) {
+            char bar[41];
+            size_t len = buckets[i] * 40 / max;
+            memset(bar, '#', len);
+            bar[len] = 0;
+            printf("    %8lu - %-8lu %8zu %s\n", i == 0 ? 0 : 1UL << i, (2UL << i) - 1, buckets[i], bar);
+        }
+    }
+}
+
+static void printTask(TaskStats* task) {
+    printf(
+        "tid %d%s: %zu switches, %lu us running, %zu migrations\n", task->tid,
+        task->kernel ? " (kernel)" : "", task->switches, task->run_total / 1000, task->migrations
+    );
+    printf("  blocked:");
+    for (size_t i = 0; i < 4; i++) {
+        printf(" %s %zu", block_reasons[i], task->blocks[i]);
+    }
+    printf("\n");
+    printHistogram("run", task->run);
+    printHistogram("wait", task->wait);
+}
+
+int main(int argc, const char* const* argv) {
+    Arguments args = {
+        .prog = argv[0],
+        .duration = 1000,
+        .kernel = false,
+    };
+    ARG_PARSE_ARGS(argumentSpec, argc, argv, &args);
+    int fd = open(TRACE_DEVICE, O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s: %s\n", args.prog, TRACE_DEVICE, strerror(errno));
+        return 1;
+    }
+    // Throw away events of an earlier trace
+    SchedTraceEvent discard[64];
+    while (read(fd, discard, sizeof(discard)) > 0) {
+        // Nothing to do
+    }
+    write(fd, "1", 1);
+    size_t count = 0;
+    size_t capacity = 4096;
+    SchedTraceEvent* events = malloc(capacity * sizeof(SchedTraceEvent));
+    // Drain every 10ms so that the kernel buffers do not overflow
+    struct timespec step = { .tv_sec = 0, .tv_nsec = 10000000 };
+    for (size_t elapsed = 0; elapsed < args.duration; elapsed += 10) {
+        nanosleep(&step, NULL);
+        ssize_t len;
+        do {
+            if (count == capacity) {
+                capacity *= 2;
+                events = realloc(events, capacity * sizeof(SchedTraceEvent));
+            }
+            len = read(fd, events + count, (capacity - count) * sizeof(SchedTraceEvent));
+            if (len > 0) {
+                count += len / sizeof(SchedTraceEvent);
+            }
+        } while (len > 0);
+    }
+    write(fd, "0", 1);
+    close(fd);
+    qsort(events, count, sizeof(SchedTraceEvent), compareEvents);
+    for (size_t i = 0; i < count; i++) {
+        processEvent(&events[i]);
+    }
+    printf("%zu events in %zu ms\n", count, args.duration);
+    if (dropped != 0) {
+        printf("%zu events dropped, the statistics are incomplete\n", dropped);
+    }
+    for (size_t i = 0; i < task_count; i++) {
+        if (!tasks[i].kernel || args.kernel) {
+            printTask(&tasks[i]);
+        }
+    }
+    free(events);
+    free(tasks);
+    return 0;
+}
@@ -6,6 +6,7 @@
 #include <stdint.h>
 #include <signal.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/mprotect.h>
 #include <sys/mount.h>
 #include <sys/stat.h>
@@ -17,7 +18,9 @@
 #include <unistd.h>
 
 #define PROGRAM_NAME "test"
+#include "infopage.h"
 #include "log.h"
+#include "ring.h"
 
 #define ASSERT(COND)                                \
     if (!(COND)) {                                  \
@@ -44,6 +47,80 @@ static inline intptr_t syscall0(uintptr_t _kind) {
     return result;
 }
 
+static inline intptr_t syscall2(uintptr_t _kind, uintptr_t _arg0, uintptr_t _arg1) {
+    register uintptr_t kind asm("a0") = _kind;
+    register uintptr_t arg0 asm("a1") = _arg0;
+    register uintptr_t arg1 asm("a2") = _arg1;
+    register uintptr_t result asm("a0");
+    asm volatile(
+        "ecall;"
+        : "=r" (result)
+        : "0" (kind), "r" (arg0), "r" (arg1)
+        : "memory"
+    );
+    return result;
+}
+
+static inline intptr_t syscall4(uintptr_t _kind, uintptr_t _arg0, uintptr_t _arg1, uintptr_t _arg2, uintptr_t _arg3) {
+    register uintptr_t kind asm("a0") = _kind;
+    register uintptr_t arg0 asm("a1") = _arg0;
+    register uintptr_t arg1 asm("a2") = _arg1;
+    register uintptr_t arg2 asm("a3") = _arg2;
+    register uintptr_t arg3 asm("a4") = _arg3;
+    register uintptr_t result asm("a0");
+    asm volatile(
+        "ecall;"
+        : "=r" (result)
+        : "0" (kind), "r" (arg0), "r" (arg1), "r" (arg2), "r" (arg3)
+        : "memory"
+    );
+    return result;
+}
+
+static inline intptr_t syscall6(
+    uintptr_t _kind, uintptr_t _arg0, uintptr_t _arg1, uintptr_t _arg2, uintptr_t _arg3, uintptr_t _arg4, uintptr_t _arg5
+) {
+    register uintptr_t kind asm("a0") = _kind;
+    register uintptr_t arg0 asm("a1") = _arg0;
+    register uintptr_t arg1 asm("a2") = _arg1;
+    register uintptr_t arg2 asm("a3") = _arg2;
+    register uintptr_t arg3 asm("a4") = _arg3;
+    register uintptr_t arg4 asm("a5") = _arg4;
+    register uintptr_t arg5 asm("a6") = _arg5;
+    register uintptr_t result asm("a0");
+    asm volatile(
+        "ecall;"
+        : "=r" (result)
+        : "0" (kind), "r" (arg0), "r" (arg1), "r" (arg2), "r" (arg3), "r" (arg4), "r" (arg5)
+        : "memory"
+    );
+    return result;
+}
+
+// Start a thread running func(arg) on the given stack. The thread exits with the return value.
+static inline intptr_t startThread(void* stack_top, uintptr_t (*_func)(void*), void* _arg) {
+    register uintptr_t kind asm("a0") = 64; // clone
+    register uintptr_t flags asm("a1") = 0x10f00; // CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SIGHAND | CLONE_THREAD
+    register uintptr_t stack asm("a2") = (uintptr_t)stack_top;
+    register uintptr_t func asm("s1") = (uintptr_t)_func;
+    register uintptr_t arg asm("s2") = (uintptr_t)_arg;
+    register uintptr_t result asm("a0");
+    asm volatile(
+        "ecall;"
+        "bnez a0, 1f;"
+        "mv a0, s2;"
+        "jalr s1;"
+        "mv a1, a0;"
+        "li a0, 66;" // thread exit
+        "ecall;"
+        "1:"
+        : "=r" (result)
+        : "0" (kind), "r" (flags), "r" (stack), "r" (func), "r" (arg)
+        : "memory"
+    );
+    return result;
+}
+
 static bool testSyscallYield() {
     // Test that it does not crash.
     syscall0(2);
@@ -313,6 +390,149 @@ static bool testMallocReallocFree() {
     return true;
 }
 
+static volatile int thread_counter = 0;
+
+static uintptr_t threadCounterFunction(void* arg) {
+    __atomic_fetch_add(&thread_counter, 1, __ATOMIC_SEQ_CST);
+    return (uintptr_t)arg * 2;
+}
+
+static bool testThreadJoin() {
+    static uint64_t stacks[4][512] __attribute__((aligned(16)));
+    intptr_t tids[4];
+    thread_counter = 0;
+    for (int i = 0; i < 4; i++) {
+        tids[i] = startThread(stacks[i + 1], threadCounterFunction, (void*)(uintptr_t)i);
+        ASSERT(tids[i] > 0);
+        ASSERT(tids[i] != getpid());
+    }
+    for (int i = 0; i < 4; i++) {
+        uintptr_t value = 0;
+        ASSERT(syscall2(67, tids[i], (uintptr_t)&value) == 0); // thread join
+        ASSERT(value == (uintptr_t)i * 2);
+    }
+    ASSERT(thread_counter == 4);
+    ASSERT(syscall2(67, tids[0], 0) == -ESRCH);
+    ASSERT(syscall0(65) == getpid()); // gettid
+    return true;
+}
+
+static volatile int32_t futex_word = 0;
+
+static uintptr_t futexWakeFunction(void* arg) {
+    __atomic_store_n(&futex_word, 1, __ATOMIC_SEQ_CST);
+    syscall4(68, (uintptr_t)&futex_word, 1, 1, 0); // futex wake
+    return 0;
+}
+
+static bool testFutexWaitWake() {
+    static uint64_t stack[512] __attribute__((aligned(16)));
+    futex_word = 0;
+    ASSERT(syscall4(68, (uintptr_t)&futex_word, 0, 1, 0) == -EAGAIN);
+    ASSERT(syscall4(68, (uintptr_t)&futex_word, 0, 0, 1000000) == -ETIMEDOUT);
+    intptr_t tid = startThread(stack + 512, futexWakeFunction, NULL);
+    ASSERT(tid > 0);
+    while (futex_word == 0) {
+        syscall4(68, (uintptr_t)&futex_word, 0, 0, 0); // futex wait
+    }
+    ASSERT(syscall2(67, tid, 0) == 0);
+    return true;
+}
+
+static bool testSchedPolicy() {
+    int pid = fork();
+    ASSERT(pid != -1);
+    if (pid == 0) {
+        ASSERT_CHILD(syscall4(70, 0, 0, 0, 0) == 0); // sched_getscheduler: SCHED_OTHER
+        ASSERT_CHILD(syscall4(69, 0, 1, 0, 0) == -EINVAL); // SCHED_FIFO needs a priority
+        ASSERT_CHILD(syscall4(69, 0, 1, 50, 0) == 0);
+        ASSERT_CHILD(syscall4(70, 0, 0, 0, 0) == 1);
+        ASSERT_CHILD(syscall4(69, 0, 0, 0, 0) == 0);
+        ASSERT_CHILD(syscall4(72, 0, 0, 0, 0) == 20); // getpriority: nice 0
+        ASSERT_CHILD(syscall4(73, 5, 0, 0, 0) == 25); // nice(5)
+        ASSERT_CHILD(syscall4(71, 0, 0, -100, 0) == 0); // setpriority clamps to -20
+        ASSERT_CHILD(syscall4(72, 0, 0, 0, 0) == 0);
+        exit(0);
+    } else {
+        int status;
+        int wait_pid = wait(&status);
+        ASSERT(wait_pid == pid);
+        ASSERT(WIFEXITED(status));
+        ASSERT(WEXITSTATUS(status) == 0);
+    }
+    return true;
+}
+
+static bool testSchedAffinity() {
+    int pid = fork();
+    ASSERT(pid != -1);
+    if (pid == 0) {
+        uint64_t mask = 0;
+        ASSERT_CHILD(syscall4(75, 0, sizeof(mask), (uintptr_t)&mask, 0) == sizeof(mask)); // sched_getaffinity
+        ASSERT_CHILD((mask & 1) != 0);
+        uint64_t none = 0;
+        ASSERT_CHILD(syscall4(74, 0, sizeof(none), (uintptr_t)&none, 0) == -EINVAL); // sched_setaffinity
+        uint64_t first = 1;
+        ASSERT_CHILD(syscall4(74, 0, sizeof(first), (uintptr_t)&first, 0) == 0);
+        syscall0(2); // yield, so that we are moved to the hart
+        ASSERT_CHILD(syscall4(75, 0, sizeof(mask), (uintptr_t)&mask, 0) == sizeof(mask));
+        ASSERT_CHILD(mask == 1);
+        exit(0);
+    } else {
+        int status;
+        int wait_pid = wait(&status);
+        ASSERT(wait_pid == pid);
+        ASSERT(WIFEXITED(status));
+        ASSERT(WEXITSTATUS(status) == 0);
+    }
+    return true;
+}
+
+static bool testGetrusage() {
+    long usage[18]; // struct rusage, the times take up the first four
+    ASSERT(syscall2(76, 0, (uintptr_t)usage) == 0); // getrusage(RUSAGE_SELF)
+    ASSERT(usage[4] > 0); // maxrss
+    ASSERT(syscall2(76, 2, (uintptr_t)usage) == -EINVAL);
+    int pid = fork();
+    ASSERT(pid != -1);
+    if (pid == 0) {
+        sleep(0);
+        exit(0);
+    } else {
+        int status;
+        ASSERT(wait(&status) == pid);
+        ASSERT(syscall2(76, -1, (uintptr_t)usage) == 0); // getrusage(RUSAGE_CHILDREN)
+        ASSERT(usage[4] > 0);
+    }
+    return true;
+}
+
+static bool testInfoPage() {
+    ASSERT(infoGetpid() == getpid());
+    ASSERT(infoGetppid() == getppid());
+    uint64_t before = syscall0(53); // SYSCALL_GET_NANOSECONDS
+    uint64_t nanos = infoRealtimeNanos();
+    ASSERT(nanos + 10000000 >= before && nanos <= syscall0(53) + 10000000);
+    ASSERT(infoMonotonicNanos() <= infoMonotonicNanos());
+    int pid = fork();
+    ASSERT(pid != -1);
+    if (pid == 0) {
+        ASSERT_CHILD(infoGetpid() == getpid());
+        ASSERT_CHILD(infoGetppid() == getppid());
+        ASSERT_CHILD(setuid(1000) == 0);
+        ASSERT_CHILD(infoGetuid() == 1000);
+        ASSERT_CHILD(mprotect((void*)USER_INFO_ADDR, 4096, PROT_READ | PROT_WRITE) == -1);
+        exit(0);
+    } else {
+        int status;
+        ASSERT(wait(&status) == pid);
+        ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        ASSERT(infoGetpid() == getpid());
+        ASSERT(infoGetuid() == getuid());
+    }
+    return true;
+}
+
 static bool testGetSetUid() {
     int pid = fork();
     ASSERT(pid != -1);
@@ -463,6 +683,103 @@ static bool testPipeSelect() {
     return true;
 }
 
+typedef struct {
+    uint32_t events;
+    uint64_t data;
+} EpollEvent;
+
+static bool testPipeEpoll() {
+    int fds[2];
+    ASSERT(pipe(fds) == 0);
+    int epfd = syscall2(79, 0, 0); // epoll create
+    ASSERT(epfd >= 0);
+    EpollEvent event = { .events = 0x001, .data = 42 }; // EPOLLIN
+    ASSERT(syscall4(80, epfd, 1, fds[0], (uintptr_t)&event) == 0); // epoll ctl add
+    ASSERT(syscall4(80, epfd, 1, fds[0], (uintptr_t)&event) == -EEXIST);
+    EpollEvent events[2];
+    ASSERT(syscall4(81, epfd, (uintptr_t)events, 2, 0) == 0); // epoll wait
+    ASSERT(syscall4(81, epfd, (uintptr_t)events, 2, 10) == 0);
+    ASSERT(write(fds[1], "hello", 5) == 5);
+    ASSERT(syscall4(81, epfd, (uintptr_t)events, 2, -1) == 1);
+    ASSERT(events[0].events == 0x001 && events[0].data == 42);
+    // Level triggered, so it is reported again
+    ASSERT(syscall4(81, epfd, (uintptr_t)events, 2, 0) == 1);
+    event.events = 0x004 | (1U << 31); // EPOLLOUT | EPOLLET
+    event.data = 43;
+    ASSERT(syscall4(80, epfd, 1, fds[1], (uintptr_t)&event) == 0);
+    ASSERT(syscall4(81, epfd, (uintptr_t)events, 2, 0) == 2);
+    ASSERT(syscall4(81, epfd, (uintptr_t)events, 2, 0) == 1);
+    ASSERT(events[0].data == 42);
+    char buffer[5];
+    ASSERT(read(fds[0], buffer, 5) == 5);
+    // The read notifies the pipe, so the write end is reported once more
+    ASSERT(syscall4(81, epfd, (uintptr_t)events, 2, 0) == 1);
+    ASSERT(events[0].events == 0x004 && events[0].data == 43);
+    ASSERT(syscall4(81, epfd, (uintptr_t)events, 2, 0) == 0);
+    ASSERT(syscall4(80, epfd, 2, fds[1], 0) == 0); // epoll ctl del
+    ASSERT(syscall4(80, epfd, 2, fds[1], 0) == -ENOENT);
+    close(epfd);
+    close(fds[0]);
+    close(fds[1]);
+    return true;
+}
+
+static bool testEpollClose() {
+    int fds[2];
+    ASSERT(pipe(fds) == 0);
+    int epfd = syscall2(79, 0, 0);
+    ASSERT(epfd >= 0);
+    EpollEvent event = { .events = 0x004, .data = 42 }; // EPOLLOUT
+    ASSERT(syscall4(80, epfd, 1, fds[1], (uintptr_t)&event) == 0);
+    int dup_fd = dup(fds[1]);
+    ASSERT(dup_fd >= 0);
+    EpollEvent events[2];
+    ASSERT(syscall4(81, epfd, (uintptr_t)events, 2, 0) == 1);
+    // The item stays while another descriptor refers to the file
+    ASSERT(close(fds[1]) == 0);
+    ASSERT(syscall4(81, epfd, (uintptr_t)events, 2, 0) == 1);
+    ASSERT(dup2(dup_fd, fds[1]) == fds[1]);
+    ASSERT(close(dup_fd) == 0);
+    ASSERT(close(fds[1]) == 0);
+    // Closing the last descriptor removes the item
+    ASSERT(syscall4(81, epfd, (uintptr_t)events, 2, 0) == 0);
+    ASSERT(syscall4(80, epfd, 2, fds[1], 0) == -EBADF);
+    close(epfd);
+    close(fds[0]);
+    return true;
+}
+
+typedef struct {
+    int fd;
+    short events;
+    short revents;
+} PollFd;
+
+static bool testPipePoll() {
+    int fds[2];
+    ASSERT(pipe(fds) == 0);
+    ASSERT(dup2(fds[0], 100) == 100); // Does not fit into the old 64 bit select sets
+    PollFd polls[4] = {
+        { .fd = fds[0], .events = 0x001 }, // POLLIN
+        { .fd = 100, .events = 0x001 },
+        { .fd = fds[1], .events = 0x004 }, // POLLOUT
+        { .fd = -1, .events = 0x001 },
+    };
+    ASSERT(syscall4(82, (uintptr_t)polls, 4, 0, 0) == 1); // poll
+    ASSERT(polls[0].revents == 0 && polls[1].revents == 0);
+    ASSERT(polls[2].revents == 0x004 && polls[3].revents == 0);
+    ASSERT(write(fds[1], "hello", 5) == 5);
+    ASSERT(syscall4(82, (uintptr_t)polls, 4, -1, 0) == 3);
+    ASSERT(polls[0].revents == 0x001 && polls[1].revents == 0x001);
+    close(100);
+    ASSERT(syscall4(82, (uintptr_t)polls, 2, -1, 0) == 2);
+    ASSERT(polls[0].revents == 0x001 && polls[1].revents == 0x020); // POLLNVAL
+    ASSERT(syscall4(82, 16, 1, 0, 0) == -EFAULT); // Bad pointers must not fault in the kernel
+    close(fds[0]);
+    close(fds[1]);
+    return true;
+}
+
 static bool testTtyNonblock() {
     int pid = fork();
     ASSERT(pid != -1);
@@ -588,6 +905,88 @@ static bool testForkSegvWait() {
     return true;
 }
 
+#define MMAP_SHARED 0x01
+#define MMAP_PRIVATE 0x02
+#define MMAP_FIXED 0x10
+#define MMAP_ANONYMOUS 0x20
+
+static bool testShmOpen() {
+    int fd = syscall4(62, (uintptr_t)"/systest", O_CREAT | O_EXCL | O_RDWR, 0600, 0); // shm_open
+    ASSERT(fd >= 0);
+    ASSERT(syscall4(62, (uintptr_t)"/systest", O_CREAT | O_EXCL | O_RDWR, 0600, 0) == -EEXIST);
+    ASSERT(write(fd, "Hello shm", 9) == 9);
+    int fd2 = syscall4(62, (uintptr_t)"/systest", O_RDONLY, 0, 0);
+    ASSERT(fd2 >= 0);
+    char buffer[10] = { 0 };
+    ASSERT(read(fd2, buffer, 9) == 9);
+    ASSERT(strcmp(buffer, "Hello shm") == 0);
+    ASSERT(syscall4(63, (uintptr_t)"/systest", 0, 0, 0) == 0); // shm_unlink
+    ASSERT(syscall4(62, (uintptr_t)"/systest", O_RDONLY, 0, 0) == -ENOENT);
+    ASSERT(close(fd) == 0);
+    ASSERT(close(fd2) == 0);
+    return true;
+}
+
+static bool testMmapSharedFork() {
+    int fd = syscall4(62, (uintptr_t)"/systest", O_CREAT | O_EXCL | O_RDWR, 0600, 0);
+    ASSERT(fd >= 0);
+    ASSERT(syscall4(63, (uintptr_t)"/systest", 0, 0, 0) == 0);
+    char zero[1 << 12] = { 0 };
+    ASSERT(write(fd, zero, sizeof(zero)) == sizeof(zero));
+    volatile int* shm = (int*)syscall6(60, 0, 1 << 12, PROT_READ | PROT_WRITE, MMAP_SHARED, fd, 0); // mmap
+    ASSERT((intptr_t)shm > 0);
+    volatile int* anon = (int*)syscall6(60, 0, 1 << 12, PROT_READ | PROT_WRITE, MMAP_SHARED | MMAP_ANONYMOUS, -1, 0);
+    ASSERT((intptr_t)anon > 0);
+    ASSERT(close(fd) == 0);
+    ASSERT(shm[0] == 0 && anon[0] == 0);
+    int pid = fork();
+    ASSERT(pid != -1);
+    if (pid == 0) {
+        shm[0] = 42;
+        anon[0] = 43;
+        exit(0);
+    } else {
+        int status;
+        ASSERT(wait(&status) == pid);
+        ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        ASSERT(shm[0] == 42);
+        ASSERT(anon[0] == 43);
+    }
+    ASSERT(syscall2(61, (uintptr_t)shm, 1 << 12) == 0); // munmap
+    ASSERT(syscall2(61, (uintptr_t)anon, 1 << 12) == 0);
+    return true;
+}
+
+static bool testMmapFixedMunmap() {
+    uintptr_t addr = 1UL << 36;
+    volatile int* map = (int*)syscall6(
+        60, addr, 2 << 12, PROT_READ | PROT_WRITE, MMAP_PRIVATE | MMAP_FIXED | MMAP_ANONYMOUS, -1, 0
+    );
+    ASSERT((uintptr_t)map == addr);
+    ASSERT(map[0] == 0);
+    map[1024] = 42;
+    ASSERT(syscall2(61, addr, 1 << 12) == 0);
+    ASSERT(map[1024] == 42);
+    ASSERT(syscall2(61, addr + (1 << 12), 1 << 12) == 0);
+    // Ranges outside of the user address space and lengths that overflow are rejected
+    ASSERT(syscall6(60, 1UL << 38, 1 << 12, PROT_READ, MMAP_PRIVATE | MMAP_FIXED | MMAP_ANONYMOUS, -1, 0) == -EINVAL);
+    ASSERT(syscall6(60, addr, -(1UL << 12), PROT_READ, MMAP_PRIVATE | MMAP_FIXED | MMAP_ANONYMOUS, -1, 0) == -EINVAL);
+    ASSERT(syscall6(60, 0, 1UL << 40, PROT_READ, MMAP_PRIVATE | MMAP_ANONYMOUS, -1, 0) == -EINVAL);
+    ASSERT(syscall2(61, addr, -(1UL << 12)) == -EINVAL);
+    ASSERT(syscall2(61, -(1UL << 12), 1 << 12) == -EINVAL);
+    int pid = fork();
+    ASSERT(pid != -1);
+    if (pid == 0) {
+        map[0] = 42;
+        exit(0);
+    } else {
+        int status;
+        ASSERT(wait(&status) == pid);
+        ASSERT(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV);
+    }
+    return true;
+}
+
 static bool testMkdir() {
     ASSERT(mkdir("tmp", 0777) == 0);
     ASSERT(access("tmp", F_OK) == 0);
@@ -850,6 +1249,91 @@ static bool testStatBlk() {
     return true;
 }
 
+static bool testReadMemstat() {
+    int fd = open("/dev/memstat", O_RDONLY);
+    ASSERT(fd >= 0);
+    char buffer[8];
+    ASSERT(read(fd, buffer, 7) == 7);
+    buffer[7] = 0;
+    ASSERT(strcmp(buffer, "kalloc:") == 0);
+    ASSERT(close(fd) == 0);
+    return true;
+}
+
+static bool testReadInterrupts() {
+    int fd = open("/dev/interrupts", O_RDWR);
+    ASSERT(fd >= 0);
+    char buffer[5];
+    ASSERT(read(fd, buffer, 4) == 4);
+    buffer[4] = 0;
+    ASSERT(strcmp(buffer, " irq") == 0);
+    ASSERT(write(fd, "0 1", 3) == -1 && errno == EINVAL);
+    ASSERT(close(fd) == 0);
+    return true;
+}
+
+static bool testReadProfile() {
+    int fd = open("/dev/profile", O_RDWR);
+    ASSERT(fd >= 0);
+    ASSERT(write(fd, "x", 1) == -1 && errno == EINVAL);
+    ASSERT(write(fd, "1", 1) == 1);
+    usleep(20000);
+    ASSERT(write(fd, "0", 1) == 1);
+    char buffer[4 * 88]; // Whole samples of 88 bytes
+    ssize_t len = read(fd, buffer, sizeof(buffer));
+    ASSERT(len > 0 && len % 88 == 0);
+    ASSERT(close(fd) == 0);
+    return true;
+}
+
+static bool testRing() {
+    Ring ring;
+    ASSERT(ringSetup(&ring, 8, 0) == 0);
+    ASSERT(syscall4(77, (uintptr_t)ring.header, 8, 0, 0) == -EBUSY); // ring setup
+    RingSubmission* sub = ringGetSubmission(&ring);
+    sub->opcode = RING_OP_OPENAT;
+    sub->fd = RING_AT_FDCWD;
+    sub->addr = (uintptr_t)"/tmp/ring.txt";
+    sub->flags = O_CREAT | O_RDWR;
+    sub->mode = 0644;
+    sub->user_data = 1;
+    ASSERT(ringSubmit(&ring) == 1);
+    RingCompletion completion;
+    ASSERT(ringPeekCompletion(&ring, &completion));
+    ASSERT(completion.user_data == 1 && completion.result >= 0);
+    int fd = completion.result;
+    char buffer[5] = { 0 };
+    struct stat stats;
+    int64_t expected[] = { 10, 4, 0, 0, 0, -EBADF };
+    uint8_t ops[] = { RING_OP_WRITE, RING_OP_READ, RING_OP_FSTAT, RING_OP_FSYNC, RING_OP_CLOSE, RING_OP_CLOSE };
+    for (size_t i = 0; i < 6; i++) {
+        sub = ringGetSubmission(&ring);
+        ASSERT(sub != NULL);
+        sub->opcode = ops[i];
+        sub->fd = fd;
+        sub->user_data = i;
+    }
+    ring.submissions[1].addr = (uintptr_t)"Hello ring";
+    ring.submissions[1].length = 10;
+    ring.submissions[2].addr = (uintptr_t)buffer;
+    ring.submissions[2].length = 4;
+    ring.submissions[2].offset = 6;
+    ring.submissions[3].addr = (uintptr_t)&stats;
+    ASSERT(ringSubmit(&ring) == 6); // All of them with a single syscall
+    for (size_t i = 0; i < 6; i++) {
+        ASSERT(ringPeekCompletion(&ring, &completion));
+        ASSERT(completion.user_data == i);
+        ASSERT(completion.result == expected[i]);
+    }
+    ASSERT(!ringPeekCompletion(&ring, &completion));
+    ASSERT(strcmp(buffer, "ring") == 0);
+    ASSERT(stats.st_size == 10);
+    ringDestroy(&ring);
+    ASSERT(syscall4(78, 1, 0, 0, 0) == -ENXIO); // ring enter
+    ASSERT(unlink("/tmp/ring.txt") == 0);
+    return true;
+}
+
 static bool testChmodStat() {
     ASSERT(chmod("/tmp/test2.txt", 0777) == 0);
     struct stat stats;
@@ -1094,18 +1578,30 @@ static bool runBasicSyscallTests() {
         TEST(testGetpid),
         TEST(testGetppid),
         TEST(testMallocReallocFree),
+        TEST(testThreadJoin),
+        TEST(testFutexWaitWake),
+        TEST(testSchedPolicy),
+        TEST(testSchedAffinity),
+        TEST(testGetrusage),
+        TEST(testInfoPage),
         TEST(testGetSetUid),
         TEST(testGetSetGid),
         TEST(testPipe),
         TEST(testPipeNonblock),
         TEST(testPipeEOF),
         TEST(testPipeSelect),
+        TEST(testPipeEpoll),
+        TEST(testEpollClose),
+        TEST(testPipePoll),
         TEST(testTtyNonblock),
         TEST(testPause),
         TEST(testPipeDup),
         TEST(testAccess),
         TEST(testProtect),
         TEST(testForkSegvWait),
+        TEST(testShmOpen),
+        TEST(testMmapSharedFork),
+        TEST(testMmapFixedMunmap),
         TEST(testMkdir),
         TEST(testOpenWriteClose),
         TEST(testOpenReadClose),
@@ -1129,6 +1625,10 @@ static bool runBasicSyscallTests() {
         TEST(testStatDir),
         TEST(testStatChr),
         TEST(testStatBlk),
+        TEST(testReadMemstat),
+        TEST(testReadInterrupts),
+        TEST(testReadProfile),
+        TEST(testRing),
         TEST(testChmodStat),
         TEST(testChownStat),
         TEST(testDup),